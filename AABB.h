@@ -0,0 +1,432 @@
+#pragma once
+
+#include <cmath>
+#include <limits>
+#include <vector>
+#include <algorithm>
+#include "Vector3.h"
+#include "Vector3SoA.h"
+#include "Matrix4.h"
+
+//! axis-aligned bounding box
+/*!
+  A default constructed box is empty ( min > max ), so that extending it
+  by any point or box gives that point or box. NaN coordinates are
+  ignored by extend and fromPoints.
+*/
+template< typename T = double >
+struct AABB
+{
+  AABB< T >();
+  AABB< T >( const AABB< T > & );
+  AABB< T >( const Vector3< T > &min, const Vector3< T > &max );
+
+  AABB< T > &operator = ( const AABB< T > & );
+
+  bool operator == ( const AABB< T > & ) const;
+  bool operator != ( const AABB< T > & ) const;
+
+  bool empty() const;
+  Vector3< T > center() const;
+  /*!
+    @brief half of size
+  */
+  Vector3< T > extent() const;
+  Vector3< T > size() const;
+  T area() const;
+  T volume() const;
+
+  bool contains( const Vector3< T > &p ) const;
+  bool contains( const AABB< T > &b ) const;
+  bool intersects( const AABB< T > &b ) const;
+
+  AABB< T > &extend( const Vector3< T > &p );
+  AABB< T > &extend( const AABB< T > &b );
+
+  // static function
+  /*!
+    @brief calculate union of boxes
+  */
+  static AABB< T > &merge( AABB< T > &o, const AABB< T > &a, const AABB< T > &b );
+  /*!
+    @brief calculate intersection of boxes ( empty if disjoint )
+  */
+  static AABB< T > &intersection( AABB< T > &o, const AABB< T > &a, const AABB< T > &b );
+  /*!
+    @brief calculate bounding box of transformed box ( Arvo )
+  */
+  static AABB< T > &transform( AABB< T > &o, const AABB< T > &a, const Matrix4< T > &m );
+  /*!
+    @brief calculate bounding box of points
+  */
+  static AABB< T > &fromPoints( AABB< T > &o, const Vector3< T > *v, unsigned int n );
+  /*!
+    @brief calculate bounding box of points
+  */
+  static AABB< T > &fromPoints( AABB< T > &o, const Vector3SoA< T > &v, unsigned int n );
+  /*!
+    @brief calculate intersection between ray and box ( slab test )
+    @param tnear distance to entry ( negative when org is inside )
+    @param tfar distance to exit
+  */
+  static bool intersectRay( const AABB< T > &a, const Vector3< T > &org, const Vector3< T > &dir, T *tnear = 0, T *tfar = 0 );
+  /*!
+    @brief widen [ lo, hi ] to cover values ( vectorized, NaN ignored )
+  */
+  static void reduce( T &lo, T &hi, const T *x, unsigned int n );
+
+  // number of points that a thread reduces before merging
+  static const unsigned int REDUCE_CHUNK = 65536;
+  // independent min / max accumulators, a multiple of the widest vector
+  static const unsigned int REDUCE_LANES = 16;
+
+  Vector3< T > min, max;
+};
+
+//
+template< typename T >
+inline AABB< T >::AABB() : min( std::numeric_limits< T >::max(), std::numeric_limits< T >::max(), std::numeric_limits< T >::max() ), max( -std::numeric_limits< T >::max(), -std::numeric_limits< T >::max(), -std::numeric_limits< T >::max() )
+{
+}
+
+//
+template< typename T >
+inline AABB< T >::AABB( const AABB< T > &b ) : min( b.min ), max( b.max )
+{
+}
+
+//
+template< typename T >
+inline AABB< T >::AABB( const Vector3< T > &min_, const Vector3< T > &max_ ) : min( min_ ), max( max_ )
+{
+}
+
+//
+template< typename T >
+inline AABB< T > &AABB< T >::operator = ( const AABB< T > &b )
+{
+  min = b.min;
+  max = b.max;
+  return *this;
+}
+
+//
+template< typename T >
+inline bool AABB< T >::operator == ( const AABB< T > &b ) const
+{
+  return min == b.min && max == b.max;
+}
+
+//
+template< typename T >
+inline bool AABB< T >::operator != ( const AABB< T > &b ) const
+{
+  return !( *this == b );
+}
+
+//
+template< typename T >
+inline bool AABB< T >::empty() const
+{
+  return !( min.x <= max.x && min.y <= max.y && min.z <= max.z );
+}
+
+//
+template< typename T >
+inline Vector3< T > AABB< T >::center() const
+{
+  return Vector3< T >( ( min.x + max.x ) / 2, ( min.y + max.y ) / 2, ( min.z + max.z ) / 2 );
+}
+
+//
+template< typename T >
+inline Vector3< T > AABB< T >::extent() const
+{
+  return Vector3< T >( ( max.x - min.x ) / 2, ( max.y - min.y ) / 2, ( max.z - min.z ) / 2 );
+}
+
+//
+template< typename T >
+inline Vector3< T > AABB< T >::size() const
+{
+  return Vector3< T >( max.x - min.x, max.y - min.y, max.z - min.z );
+}
+
+//
+template< typename T >
+inline T AABB< T >::area() const
+{
+  if( empty() )
+    {
+      return 0;
+    }
+  T x = max.x - min.x, y = max.y - min.y, z = max.z - min.z;
+  return 2 * ( x * y + y * z + z * x );
+}
+
+//
+template< typename T >
+inline T AABB< T >::volume() const
+{
+  if( empty() )
+    {
+      return 0;
+    }
+  return ( max.x - min.x ) * ( max.y - min.y ) * ( max.z - min.z );
+}
+
+//
+template< typename T >
+inline bool AABB< T >::contains( const Vector3< T > &p ) const
+{
+  return min.x <= p.x && p.x <= max.x && min.y <= p.y && p.y <= max.y && min.z <= p.z && p.z <= max.z;
+}
+
+//
+template< typename T >
+inline bool AABB< T >::contains( const AABB< T > &b ) const
+{
+  return b.empty() || ( min.x <= b.min.x && b.max.x <= max.x && min.y <= b.min.y && b.max.y <= max.y && min.z <= b.min.z && b.max.z <= max.z );
+}
+
+//
+template< typename T >
+inline bool AABB< T >::intersects( const AABB< T > &b ) const
+{
+  return min.x <= b.max.x && b.min.x <= max.x && min.y <= b.max.y && b.min.y <= max.y && min.z <= b.max.z && b.min.z <= max.z;
+}
+
+//
+template< typename T >
+inline AABB< T > &AABB< T >::extend( const Vector3< T > &p )
+{
+  // written so that NaN leaves the box unchanged
+  min.x = p.x < min.x ? p.x : min.x;
+  min.y = p.y < min.y ? p.y : min.y;
+  min.z = p.z < min.z ? p.z : min.z;
+  max.x = p.x > max.x ? p.x : max.x;
+  max.y = p.y > max.y ? p.y : max.y;
+  max.z = p.z > max.z ? p.z : max.z;
+  return *this;
+}
+
+//
+template< typename T >
+inline AABB< T > &AABB< T >::extend( const AABB< T > &b )
+{
+  min.x = b.min.x < min.x ? b.min.x : min.x;
+  min.y = b.min.y < min.y ? b.min.y : min.y;
+  min.z = b.min.z < min.z ? b.min.z : min.z;
+  max.x = b.max.x > max.x ? b.max.x : max.x;
+  max.y = b.max.y > max.y ? b.max.y : max.y;
+  max.z = b.max.z > max.z ? b.max.z : max.z;
+  return *this;
+}
+
+//
+template< typename T >
+inline AABB< T > &AABB< T >::merge( AABB< T > &o, const AABB< T > &a, const AABB< T > &b )
+{
+  o = a;
+  return o.extend( b );
+}
+
+//
+template< typename T >
+inline AABB< T > &AABB< T >::intersection( AABB< T > &o, const AABB< T > &a, const AABB< T > &b )
+{
+  o.min.x = std::max( a.min.x, b.min.x );
+  o.min.y = std::max( a.min.y, b.min.y );
+  o.min.z = std::max( a.min.z, b.min.z );
+  o.max.x = std::min( a.max.x, b.max.x );
+  o.max.y = std::min( a.max.y, b.max.y );
+  o.max.z = std::min( a.max.z, b.max.z );
+  if( o.empty() )
+    {
+      o = AABB< T >();
+    }
+  return o;
+}
+
+//
+template< typename T >
+AABB< T > &AABB< T >::transform( AABB< T > &o, const AABB< T > &a, const Matrix4< T > &m )
+{
+  if( a.empty() )
+    {
+      o = a;
+      return o;
+    }
+  // each output axis starts at the translation and takes the smaller and
+  // the larger of every row contribution ( row vectors : p' = p * m )
+  const T lo[ 3 ] = { a.min.x, a.min.y, a.min.z };
+  const T hi[ 3 ] = { a.max.x, a.max.y, a.max.z };
+  T rmin[ 3 ] = { m._41, m._42, m._43 };
+  T rmax[ 3 ] = { m._41, m._42, m._43 };
+  for( int i = 0; i < 3; ++i )
+    {
+      for( int j = 0; j < 3; ++j )
+	{
+	  T e = lo[ i ] * m.m[ i * 4 + j ];
+	  T f = hi[ i ] * m.m[ i * 4 + j ];
+	  rmin[ j ] += e < f ? e : f;
+	  rmax[ j ] += e < f ? f : e;
+	}
+    }
+  o.min = Vector3< T >( rmin[ 0 ], rmin[ 1 ], rmin[ 2 ] );
+  o.max = Vector3< T >( rmax[ 0 ], rmax[ 1 ], rmax[ 2 ] );
+  return o;
+}
+
+//
+template< typename T >
+void AABB< T >::reduce( T &lo, T &hi, const T *x, unsigned int n )
+{
+  // one accumulator per lane keeps the loop free of cross-iteration
+  // dependencies, so it vectorizes without relaxed floating point
+  T l[ REDUCE_LANES ], h[ REDUCE_LANES ];
+  for( unsigned int k = 0; k < REDUCE_LANES; ++k )
+    {
+      l[ k ] = lo;
+      h[ k ] = hi;
+    }
+  unsigned int m = n - n % REDUCE_LANES;
+  for( unsigned int i = 0; i < m; i += REDUCE_LANES )
+    {
+      for( unsigned int k = 0; k < REDUCE_LANES; ++k )
+	{
+	  T a = x[ i + k ];
+	  l[ k ] = a < l[ k ] ? a : l[ k ];
+	  h[ k ] = a > h[ k ] ? a : h[ k ];
+	}
+    }
+  for( unsigned int i = m; i < n; ++i )
+    {
+      l[ 0 ] = x[ i ] < l[ 0 ] ? x[ i ] : l[ 0 ];
+      h[ 0 ] = x[ i ] > h[ 0 ] ? x[ i ] : h[ 0 ];
+    }
+  for( unsigned int k = 0; k < REDUCE_LANES; ++k )
+    {
+      lo = l[ k ] < lo ? l[ k ] : lo;
+      hi = h[ k ] > hi ? h[ k ] : hi;
+    }
+}
+
+//
+template< typename T >
+AABB< T > &AABB< T >::fromPoints( AABB< T > &o, const Vector3SoA< T > &v, unsigned int n )
+{
+  int chunks = static_cast< int >( ( n + REDUCE_CHUNK - 1 ) / REDUCE_CHUNK );
+  std::vector< AABB< T > > part( chunks );
+
+#ifdef _OPENMP
+#pragma omp parallel for if( chunks > 1 )
+#endif
+  for( int c = 0; c < chunks; ++c )
+    {
+      unsigned int begin = c * REDUCE_CHUNK;
+      unsigned int end = std::min( begin + REDUCE_CHUNK, n );
+      AABB< T > &b = part[ c ];
+      reduce( b.min.x, b.max.x, v.x + begin, end - begin );
+      reduce( b.min.y, b.max.y, v.y + begin, end - begin );
+      reduce( b.min.z, b.max.z, v.z + begin, end - begin );
+    }
+
+  // merged in chunk order, so the result does not depend on thread count
+  o = AABB< T >();
+  for( int c = 0; c < chunks; ++c )
+    {
+      o.extend( part[ c ] );
+    }
+  return o;
+}
+
+//
+template< typename T >
+AABB< T > &AABB< T >::fromPoints( AABB< T > &o, const Vector3< T > *v, unsigned int n )
+{
+  const unsigned int BLOCK = 256;
+  int chunks = static_cast< int >( ( n + REDUCE_CHUNK - 1 ) / REDUCE_CHUNK );
+  std::vector< AABB< T > > part( chunks );
+
+#ifdef _OPENMP
+#pragma omp parallel for if( chunks > 1 )
+#endif
+  for( int c = 0; c < chunks; ++c )
+    {
+      unsigned int begin = c * REDUCE_CHUNK;
+      unsigned int end = std::min( begin + REDUCE_CHUNK, n );
+      AABB< T > &b = part[ c ];
+      // vectors carry a vtable pointer : gather blocks into soa first
+      T x[ BLOCK ], y[ BLOCK ], z[ BLOCK ];
+      for( unsigned int i = begin; i < end; i += BLOCK )
+	{
+	  unsigned int k = std::min( BLOCK, end - i );
+	  for( unsigned int j = 0; j < k; ++j )
+	    {
+	      x[ j ] = v[ i + j ].x;
+	      y[ j ] = v[ i + j ].y;
+	      z[ j ] = v[ i + j ].z;
+	    }
+	  reduce( b.min.x, b.max.x, x, k );
+	  reduce( b.min.y, b.max.y, y, k );
+	  reduce( b.min.z, b.max.z, z, k );
+	}
+    }
+
+  o = AABB< T >();
+  for( int c = 0; c < chunks; ++c )
+    {
+      o.extend( part[ c ] );
+    }
+  return o;
+}
+
+//
+template< typename T >
+bool AABB< T >::intersectRay( const AABB< T > &a, const Vector3< T > &org, const Vector3< T > &dir, T *tnear, T *tfar )
+{
+  const T o[ 3 ] = { org.x, org.y, org.z };
+  const T d[ 3 ] = { dir.x, dir.y, dir.z };
+  const T lo[ 3 ] = { a.min.x, a.min.y, a.min.z };
+  const T hi[ 3 ] = { a.max.x, a.max.y, a.max.z };
+  T t0 = -std::numeric_limits< T >::max(), t1 = std::numeric_limits< T >::max();
+  for( int i = 0; i < 3; ++i )
+    {
+      // 1 / 0 is infinite ; 0 * infinity ( origin on a slab plane ) is NaN and
+      // the comparisons below skip it, which counts the plane as inside.
+      // the sign of the direction picks the near and far plane as in
+      // Ray::intersectBoxes, so an empty box ( min > max ) is missed
+      T inv = 1 / d[ i ];
+      T s0 = ( ( inv >= 0 ? lo[ i ] : hi[ i ] ) - o[ i ] ) * inv;
+      T s1 = ( ( inv >= 0 ? hi[ i ] : lo[ i ] ) - o[ i ] ) * inv;
+      t0 = s0 > t0 ? s0 : t0;
+      t1 = s1 < t1 ? s1 : t1;
+    }
+  if( !( t0 <= t1 ) || t1 < 0 )
+    {
+      return false;
+    }
+  if( tnear )
+    {
+      *tnear = t0;
+    }
+  if( tfar )
+    {
+      *tfar = t1;
+    }
+  return true;
+}
+
+/*!
+  output stream
+*/
+template< typename T >
+std::ostream &operator<<( std::ostream &os, const AABB< T > &a )
+{
+  os << a.min << ", " << a.max;
+  return os;
+}
+
+typedef AABB< float > AABBF;
+typedef AABB< double > AABBD;
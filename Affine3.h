@@ -0,0 +1,457 @@
+#pragma once
+
+#include <cmath>
+#include "Vector3.h"
+#include "Matrix4.h"
+#include "Quaternion.h"
+
+//! affine transform stored as 4 rows x 3 columns
+/*!
+  Same row vector convention and element names as Matrix4 with the
+  constant last column ( 0, 0, 0, 1 ) dropped : 12 scalars instead of 16.
+*/
+template< typename T = double >
+struct Affine3
+{
+  Affine3< T >();
+  Affine3< T >( T _11, T _12, T _13, T _21, T _22, T _23, T _31, T _32, T _33, T _41, T _42, T _43 );
+  Affine3< T >( const Affine3< T > &a );
+
+  Affine3< T > &operator =( const Affine3< T > &a );
+
+  Affine3< T > operator *( const Affine3< T > &a ) const;
+  Affine3< T > &operator *=( const Affine3< T > &a );
+
+  bool operator ==( const Affine3< T > &a ) const;
+  bool operator !=( const Affine3< T > &a ) const;
+
+  // static function
+  /*!
+    @brief create identity transform
+  */
+  static Affine3< T > &identity( Affine3< T > &a );
+  /*!
+    @brief create from matrix ( last column is ignored )
+  */
+  static Affine3< T > &fromMatrix( Affine3< T > &a, const Matrix4< T > &m );
+  /*!
+    @brief convert to matrix
+  */
+  static Matrix4< T > &toMatrix( Matrix4< T > &m, const Affine3< T > &a );
+  /*!
+    @brief create from scaling, rotation and translation
+  */
+  static Affine3< T > &transformation( Affine3< T > &a, const Vector3< T > &scale, const Quaternion< T > &rot, const Vector3< T > &trans );
+  /*!
+    @brief create from rotation and translation
+  */
+  static Affine3< T > &rotationTranslation( Affine3< T > &a, const Quaternion< T > &rot, const Vector3< T > &trans );
+  /*!
+    @brief get rotation and translation ( transform must not be scaled )
+  */
+  static void toRotationTranslation( Quaternion< T > &rot, Vector3< T > &trans, const Affine3< T > &a );
+  /*!
+    @brief calculate determinant of linear part
+  */
+  static T determinant( const Affine3< T > &a );
+  /*!
+    @brief calculate inverse transform
+  */
+  static Affine3< T > &inverse( Affine3< T > &a, const Affine3< T > &a0, T *det = 0 );
+  /*!
+    @brief inverse transpose of linear part, for transforming normals under non-uniform scaling
+  */
+  static Affine3< T > &normalMatrix( Affine3< T > &a, const Affine3< T > &a0 );
+  /*!
+    @brief transform point
+  */
+  static Vector3< T > &transform( Vector3< T > &v, const Vector3< T > &v0, const Affine3< T > &a );
+  /*!
+    @brief transform direction ( linear part only )
+  */
+  static Vector3< T > &transformNormal( Vector3< T > &v, const Vector3< T > &v0, const Affine3< T > &a );
+  /*!
+    @brief transform points
+  */
+  static void transform( Vector3< T > *v, const Vector3< T > *v0, unsigned int n, const Affine3< T > &a );
+  /*!
+    @brief transform directions ( linear part only )
+  */
+  static void transformNormal( Vector3< T > *v, const Vector3< T > *v0, unsigned int n, const Affine3< T > &a );
+  /*!
+    @brief multiply pairwise : a[ i ] = a1[ i ] * a2[ i ]
+  */
+  static void multiply( Affine3< T > *a, const Affine3< T > *a1, const Affine3< T > *a2, unsigned int n );
+  /*!
+    @brief multiply by one transform : a[ i ] = a1[ i ] * a2
+  */
+  static void multiply( Affine3< T > *a, const Affine3< T > *a1, const Affine3< T > &a2, unsigned int n );
+  /*!
+    @brief convert matrices
+  */
+  static void fromMatrix( Affine3< T > *a, const Matrix4< T > *m, unsigned int n );
+  /*!
+    @brief convert to matrices
+  */
+  static void toMatrix( Matrix4< T > *m, const Affine3< T > *a, unsigned int n );
+
+  union
+  {
+    struct
+    {
+      T _11, _12, _13;
+      T _21, _22, _23;
+      T _31, _32, _33;
+      T _41, _42, _43;
+    };
+    T m[ 12 ];
+  };
+};
+
+//
+template< typename T >
+inline Affine3< T >::Affine3()
+{
+  this->_11 = this->_12 = this->_13 = 0;
+  this->_21 = this->_22 = this->_23 = 0;
+  this->_31 = this->_32 = this->_33 = 0;
+  this->_41 = this->_42 = this->_43 = 0;
+}
+
+//
+template< typename T >
+inline Affine3< T >::Affine3( T _11_, T _12_, T _13_,
+			      T _21_, T _22_, T _23_,
+			      T _31_, T _32_, T _33_,
+			      T _41_, T _42_, T _43_ )
+{
+  this->_11 = _11_;
+  this->_12 = _12_;
+  this->_13 = _13_;
+  this->_21 = _21_;
+  this->_22 = _22_;
+  this->_23 = _23_;
+  this->_31 = _31_;
+  this->_32 = _32_;
+  this->_33 = _33_;
+  this->_41 = _41_;
+  this->_42 = _42_;
+  this->_43 = _43_;
+}
+
+//
+template< typename T >
+inline Affine3< T >::Affine3( const Affine3< T > &a )
+{
+  for( int i = 0; i < 12; ++i )
+    {
+      this->m[ i ] = a.m[ i ];
+    }
+}
+
+//
+template< typename T >
+inline Affine3< T > &Affine3< T >::operator =( const Affine3< T > &a )
+{
+  for( int i = 0; i < 12; ++i )
+    {
+      this->m[ i ] = a.m[ i ];
+    }
+  return *this;
+}
+
+//
+template< typename T >
+inline Affine3< T > Affine3< T >::operator *( const Affine3< T > &a ) const
+{
+  return Affine3< T >(
+		      _11*a._11 + _12*a._21 + _13*a._31,
+		      _11*a._12 + _12*a._22 + _13*a._32,
+		      _11*a._13 + _12*a._23 + _13*a._33,
+
+		      _21*a._11 + _22*a._21 + _23*a._31,
+		      _21*a._12 + _22*a._22 + _23*a._32,
+		      _21*a._13 + _22*a._23 + _23*a._33,
+
+		      _31*a._11 + _32*a._21 + _33*a._31,
+		      _31*a._12 + _32*a._22 + _33*a._32,
+		      _31*a._13 + _32*a._23 + _33*a._33,
+
+		      _41*a._11 + _42*a._21 + _43*a._31 + a._41,
+		      _41*a._12 + _42*a._22 + _43*a._32 + a._42,
+		      _41*a._13 + _42*a._23 + _43*a._33 + a._43
+		      );
+}
+
+//
+template< typename T >
+inline Affine3< T > &Affine3< T >::operator *=( const Affine3< T > &a )
+{
+  *this = *this * a;
+  return *this;
+}
+
+//
+template< typename T >
+inline bool Affine3< T >::operator ==( const Affine3< T > &a ) const
+{
+  for( int i = 0; i < 12; ++i )
+    {
+      if( this->m[ i ] != a.m[ i ] )
+	{
+	  return false;
+	}
+    }
+  return true;
+}
+
+//
+template< typename T >
+inline bool Affine3< T >::operator !=( const Affine3< T > &a ) const
+{
+  return !( operator ==( a ) );
+}
+
+//
+template< typename T >
+inline Affine3< T > &Affine3< T >::identity( Affine3< T > &a )
+{
+  a = Affine3< T >( 1, 0, 0,
+		    0, 1, 0,
+		    0, 0, 1,
+		    0, 0, 0 );
+  return a;
+}
+
+//
+template< typename T >
+inline Affine3< T > &Affine3< T >::fromMatrix( Affine3< T > &a, const Matrix4< T > &m )
+{
+  a = Affine3< T >( m._11, m._12, m._13,
+		    m._21, m._22, m._23,
+		    m._31, m._32, m._33,
+		    m._41, m._42, m._43 );
+  return a;
+}
+
+//
+template< typename T >
+inline Matrix4< T > &Affine3< T >::toMatrix( Matrix4< T > &m, const Affine3< T > &a )
+{
+  m = Matrix4< T >( a._11, a._12, a._13, 0,
+		    a._21, a._22, a._23, 0,
+		    a._31, a._32, a._33, 0,
+		    a._41, a._42, a._43, 1 );
+  return m;
+}
+
+//
+template< typename T >
+Affine3< T > &Affine3< T >::transformation( Affine3< T > &a, const Vector3< T > &scale, const Quaternion< T > &rot, const Vector3< T > &trans )
+{
+  Matrix4< T > m;
+  Matrix4< T >::transformation( m, scale, rot, trans );
+  return fromMatrix( a, m );
+}
+
+//
+template< typename T >
+Affine3< T > &Affine3< T >::rotationTranslation( Affine3< T > &a, const Quaternion< T > &rot, const Vector3< T > &trans )
+{
+  Matrix4< T > m;
+  Quaternion< T >::toMatrix( m, rot );
+  fromMatrix( a, m );
+  a._41 = trans.x;
+  a._42 = trans.y;
+  a._43 = trans.z;
+  return a;
+}
+
+//
+template< typename T >
+void Affine3< T >::toRotationTranslation( Quaternion< T > &rot, Vector3< T > &trans, const Affine3< T > &a )
+{
+  Matrix4< T > m;
+  toMatrix( m, a );
+  Quaternion< T >::fromMatrix( rot, m );
+  trans = Vector3< T >( a._41, a._42, a._43 );
+}
+
+//
+template< typename T >
+inline T Affine3< T >::determinant( const Affine3< T > &a )
+{
+  return a._11 * ( a._22 * a._33 - a._23 * a._32 ) - a._12 * ( a._21 * a._33 - a._23 * a._31 ) + a._13 * ( a._21 * a._32 - a._22 * a._31 );
+}
+
+//
+template< typename T >
+Affine3< T > &Affine3< T >::inverse( Affine3< T > &a, const Affine3< T > &a0, T *det )
+{
+  T c11 = a0._22 * a0._33 - a0._23 * a0._32;
+  T c12 = a0._13 * a0._32 - a0._12 * a0._33;
+  T c13 = a0._12 * a0._23 - a0._13 * a0._22;
+  T c21 = a0._23 * a0._31 - a0._21 * a0._33;
+  T c22 = a0._11 * a0._33 - a0._13 * a0._31;
+  T c23 = a0._13 * a0._21 - a0._11 * a0._23;
+  T c31 = a0._21 * a0._32 - a0._22 * a0._31;
+  T c32 = a0._12 * a0._31 - a0._11 * a0._32;
+  T c33 = a0._11 * a0._22 - a0._12 * a0._21;
+  T d = a0._11 * c11 + a0._12 * c21 + a0._13 * c31;
+
+  if( det ) *det = d;
+  if( d == 0 ) return a;
+
+  T f = 1 / d;
+  c11 *= f; c12 *= f; c13 *= f;
+  c21 *= f; c22 *= f; c23 *= f;
+  c31 *= f; c32 *= f; c33 *= f;
+  T x = a0._41, y = a0._42, z = a0._43;
+  a = Affine3< T >( c11, c12, c13,
+		    c21, c22, c23,
+		    c31, c32, c33,
+		    -( x * c11 + y * c21 + z * c31 ),
+		    -( x * c12 + y * c22 + z * c32 ),
+		    -( x * c13 + y * c23 + z * c33 ) );
+  return a;
+}
+
+//
+template< typename T >
+Affine3< T > &Affine3< T >::normalMatrix( Affine3< T > &a, const Affine3< T > &a0 )
+{
+  // cofactor matrix : inverse transpose up to the determinant, which only scales normals
+  T c11 = a0._22 * a0._33 - a0._23 * a0._32;
+  T c12 = a0._23 * a0._31 - a0._21 * a0._33;
+  T c13 = a0._21 * a0._32 - a0._22 * a0._31;
+  T c21 = a0._13 * a0._32 - a0._12 * a0._33;
+  T c22 = a0._11 * a0._33 - a0._13 * a0._31;
+  T c23 = a0._12 * a0._31 - a0._11 * a0._32;
+  T c31 = a0._12 * a0._23 - a0._13 * a0._22;
+  T c32 = a0._13 * a0._21 - a0._11 * a0._23;
+  T c33 = a0._11 * a0._22 - a0._12 * a0._21;
+  T d = a0._11 * c11 + a0._12 * c12 + a0._13 * c13;
+  T f = d < 0 ? -1 : 1;
+  a = Affine3< T >( c11 * f, c12 * f, c13 * f,
+		    c21 * f, c22 * f, c23 * f,
+		    c31 * f, c32 * f, c33 * f,
+		    0, 0, 0 );
+  return a;
+}
+
+//
+template< typename T >
+inline Vector3< T > &Affine3< T >::transform( Vector3< T > &v, const Vector3< T > &v0, const Affine3< T > &a )
+{
+  T x = v0.x, y = v0.y, z = v0.z;
+  v.x = x * a._11 + y * a._21 + z * a._31 + a._41;
+  v.y = x * a._12 + y * a._22 + z * a._32 + a._42;
+  v.z = x * a._13 + y * a._23 + z * a._33 + a._43;
+  return v;
+}
+
+//
+template< typename T >
+inline Vector3< T > &Affine3< T >::transformNormal( Vector3< T > &v, const Vector3< T > &v0, const Affine3< T > &a )
+{
+  T x = v0.x, y = v0.y, z = v0.z;
+  v.x = x * a._11 + y * a._21 + z * a._31;
+  v.y = x * a._12 + y * a._22 + z * a._32;
+  v.z = x * a._13 + y * a._23 + z * a._33;
+  return v;
+}
+
+//
+template< typename T >
+void Affine3< T >::transform( Vector3< T > *v, const Vector3< T > *v0, unsigned int n, const Affine3< T > &a )
+{
+#ifdef _OPENMP
+#pragma omp parallel for if( n > 65536 )
+#endif
+  for( int i = 0; i < static_cast< int >( n ); ++i )
+    {
+      transform( v[ i ], v0[ i ], a );
+    }
+}
+
+//
+template< typename T >
+void Affine3< T >::transformNormal( Vector3< T > *v, const Vector3< T > *v0, unsigned int n, const Affine3< T > &a )
+{
+#ifdef _OPENMP
+#pragma omp parallel for if( n > 65536 )
+#endif
+  for( int i = 0; i < static_cast< int >( n ); ++i )
+    {
+      transformNormal( v[ i ], v0[ i ], a );
+    }
+}
+
+//
+template< typename T >
+void Affine3< T >::multiply( Affine3< T > *a, const Affine3< T > *a1, const Affine3< T > *a2, unsigned int n )
+{
+#ifdef _OPENMP
+#pragma omp parallel for if( n > 16384 )
+#endif
+  for( int i = 0; i < static_cast< int >( n ); ++i )
+    {
+      a[ i ] = a1[ i ] * a2[ i ];
+    }
+}
+
+//
+template< typename T >
+void Affine3< T >::multiply( Affine3< T > *a, const Affine3< T > *a1, const Affine3< T > &a2, unsigned int n )
+{
+  const Affine3< T > b = a2;
+#ifdef _OPENMP
+#pragma omp parallel for if( n > 16384 )
+#endif
+  for( int i = 0; i < static_cast< int >( n ); ++i )
+    {
+      a[ i ] = a1[ i ] * b;
+    }
+}
+
+//
+template< typename T >
+void Affine3< T >::fromMatrix( Affine3< T > *a, const Matrix4< T > *m, unsigned int n )
+{
+#ifdef _OPENMP
+#pragma omp parallel for if( n > 65536 )
+#endif
+  for( int i = 0; i < static_cast< int >( n ); ++i )
+    {
+      fromMatrix( a[ i ], m[ i ] );
+    }
+}
+
+//
+template< typename T >
+void Affine3< T >::toMatrix( Matrix4< T > *m, const Affine3< T > *a, unsigned int n )
+{
+#ifdef _OPENMP
+#pragma omp parallel for if( n > 65536 )
+#endif
+  for( int i = 0; i < static_cast< int >( n ); ++i )
+    {
+      toMatrix( m[ i ], a[ i ] );
+    }
+}
+
+/*!
+  output stream
+*/
+template< typename T >
+std::ostream &operator<<( std::ostream &os, const Affine3< T > &a )
+{
+  os << a._11 << ", " << a._12 << ", " << a._13 << std::endl;
+  os << a._21 << ", " << a._22 << ", " << a._23 << std::endl;
+  os << a._31 << ", " << a._32 << ", " << a._33 << std::endl;
+  os << a._41 << ", " << a._42 << ", " << a._43;
+  return os;
+}
+
+typedef Affine3< float > Affine3F;
+typedef Affine3< double > Affine3D;
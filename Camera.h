@@ -0,0 +1,490 @@
+#pragma once
+
+#include <cmath>
+#include <algorithm>
+#include "Vector3.h"
+#include "Vector3SoA.h"
+#include "Matrix4.h"
+#include "Plane.h"
+
+//! camera with cached view / projection matrices
+/*!
+  Matrices, their inverses and the frustum planes are recomputed lazily
+  on first access after eye, target, up or lens parameters change.
+  Inverses use the closed form of each matrix kind ( rigid view,
+  perspective, orthographic ) instead of the general 4x4 inverse.
+  Frustum planes face inward ( dot >= 0 inside ), as Clip expects.
+*/
+template< typename T = double >
+struct Camera
+{
+  enum Projection
+    {
+      PERSPECTIVE,
+      ORTHOGRAPHIC
+    };
+
+  enum FrustumPlane
+    {
+      PLANE_LEFT,
+      PLANE_RIGHT,
+      PLANE_BOTTOM,
+      PLANE_TOP,
+      PLANE_NEAR,
+      PLANE_FAR
+    };
+
+  Camera< T >();
+
+  void setView( const Vector3< T > &eyePos, const Vector3< T > &lookAt, const Vector3< T > &up );
+  void setEye( const Vector3< T > &eyePos );
+  void setTarget( const Vector3< T > &lookAt );
+  void setUp( const Vector3< T > &up );
+  void setPerspective( T fovy, T aspect, T zn, T zf );
+  void setOrtho( T w, T h, T zn, T zf );
+  void setAspect( T aspect );
+  void setRightHanded( bool rightHanded );
+
+  const Vector3< T > &eye() const;
+  const Vector3< T > &target() const;
+  const Vector3< T > &up() const;
+  Projection projectionType() const;
+
+  const Matrix4< T > &view() const;
+  const Matrix4< T > &projection() const;
+  const Matrix4< T > &viewProjection() const;
+  const Matrix4< T > &inverseView() const;
+  const Matrix4< T > &inverseProjection() const;
+  const Matrix4< T > &inverseViewProjection() const;
+  const Plane< T > *frustum() const;
+
+  // static function
+  /*!
+    @brief refresh cached matrices of cameras
+  */
+  static void update( const Camera< T > *cameras, unsigned int n );
+  /*!
+    @brief inverse of view matrix ( rotation and translation only )
+  */
+  static Matrix4< T > &inverseRigid( Matrix4< T > &m, const Matrix4< T > &m0 );
+  /*!
+    @brief inverse of perspectiveLH / perspectiveRH matrix
+  */
+  static Matrix4< T > &inversePerspective( Matrix4< T > &m, const Matrix4< T > &m0 );
+  /*!
+    @brief inverse of orthoLH / orthoRH matrix
+  */
+  static Matrix4< T > &inverseOrtho( Matrix4< T > &m, const Matrix4< T > &m0 );
+  /*!
+    @brief extract normalized frustum planes from view projection matrix
+    @param planes 6 planes in FrustumPlane order
+  */
+  static void frustumPlanes( Plane< T > *planes, const Matrix4< T > &viewProj );
+  /*!
+    @brief project points to screen in one pass ( transform, clip test, divide, viewport )
+    @param visible 1 if the point is inside the frustum, otherwise 0
+    @param screen pixel x, y ( y down, as Matrix4::screen ) and depth in [ 0, 1 ]
+  */
+  static void project( unsigned char *visible, Vector3SoA< T > &screen, const Vector3SoA< T > &v, unsigned int n, const Matrix4< T > &viewProj, T width, T height );
+  /*!
+    @brief project points to screen in one pass ( transform, clip test, divide, viewport )
+  */
+  static void project( unsigned char *visible, Vector3< T > *screen, const Vector3< T > *v, unsigned int n, const Matrix4< T > &viewProj, T width, T height );
+
+private:
+  enum Dirty
+    {
+      DIRTY_VIEW = 1,
+      DIRTY_PROJECTION = 2
+    };
+
+  void refresh() const;
+  static void projectBlock( unsigned char *visible, T *sx, T *sy, T *sz, const T *x, const T *y, const T *z, int m, const Matrix4< T > &viewProj, T width, T height );
+
+  Vector3< T > eyePos, lookAt, upDir;
+  Projection type;
+  bool rightHanded;
+  T fovy, aspect, width, height, zn, zf;
+
+  mutable unsigned int dirty;
+  mutable Matrix4< T > viewMatrix, projMatrix, viewProjMatrix;
+  mutable Matrix4< T > invViewMatrix, invProjMatrix, invViewProjMatrix;
+  mutable Plane< T > planes[ 6 ];
+};
+
+//
+template< typename T >
+inline Camera< T >::Camera() : eyePos( 0, 0, 0 ), lookAt( 0, 0, 1 ), upDir( 0, 1, 0 ), type( PERSPECTIVE ), rightHanded( false ),
+			      fovy( static_cast< T >( 3.1415926535897932384626433832795 / 4 ) ), aspect( 1 ), width( 1 ), height( 1 ), zn( static_cast< T >( 0.1 ) ), zf( 1000 ),
+			      dirty( DIRTY_VIEW | DIRTY_PROJECTION )
+{
+}
+
+//
+template< typename T >
+inline void Camera< T >::setView( const Vector3< T > &eyePos, const Vector3< T > &lookAt, const Vector3< T > &up )
+{
+  this->eyePos = eyePos;
+  this->lookAt = lookAt;
+  this->upDir = up;
+  dirty |= DIRTY_VIEW;
+}
+
+//
+template< typename T >
+inline void Camera< T >::setEye( const Vector3< T > &eyePos )
+{
+  this->eyePos = eyePos;
+  dirty |= DIRTY_VIEW;
+}
+
+//
+template< typename T >
+inline void Camera< T >::setTarget( const Vector3< T > &lookAt )
+{
+  this->lookAt = lookAt;
+  dirty |= DIRTY_VIEW;
+}
+
+//
+template< typename T >
+inline void Camera< T >::setUp( const Vector3< T > &up )
+{
+  this->upDir = up;
+  dirty |= DIRTY_VIEW;
+}
+
+//
+template< typename T >
+inline void Camera< T >::setPerspective( T fovy, T aspect, T zn, T zf )
+{
+  this->type = PERSPECTIVE;
+  this->fovy = fovy;
+  this->aspect = aspect;
+  this->zn = zn;
+  this->zf = zf;
+  dirty |= DIRTY_PROJECTION;
+}
+
+//
+template< typename T >
+inline void Camera< T >::setOrtho( T w, T h, T zn, T zf )
+{
+  this->type = ORTHOGRAPHIC;
+  this->width = w;
+  this->height = h;
+  this->zn = zn;
+  this->zf = zf;
+  dirty |= DIRTY_PROJECTION;
+}
+
+//
+template< typename T >
+inline void Camera< T >::setAspect( T aspect )
+{
+  this->aspect = aspect;
+  dirty |= DIRTY_PROJECTION;
+}
+
+//
+template< typename T >
+inline void Camera< T >::setRightHanded( bool rightHanded )
+{
+  this->rightHanded = rightHanded;
+  dirty |= DIRTY_VIEW | DIRTY_PROJECTION;
+}
+
+//
+template< typename T >
+inline const Vector3< T > &Camera< T >::eye() const
+{
+  return eyePos;
+}
+
+//
+template< typename T >
+inline const Vector3< T > &Camera< T >::target() const
+{
+  return lookAt;
+}
+
+//
+template< typename T >
+inline const Vector3< T > &Camera< T >::up() const
+{
+  return upDir;
+}
+
+//
+template< typename T >
+inline typename Camera< T >::Projection Camera< T >::projectionType() const
+{
+  return type;
+}
+
+//
+template< typename T >
+inline const Matrix4< T > &Camera< T >::view() const
+{
+  refresh();
+  return viewMatrix;
+}
+
+//
+template< typename T >
+inline const Matrix4< T > &Camera< T >::projection() const
+{
+  refresh();
+  return projMatrix;
+}
+
+//
+template< typename T >
+inline const Matrix4< T > &Camera< T >::viewProjection() const
+{
+  refresh();
+  return viewProjMatrix;
+}
+
+//
+template< typename T >
+inline const Matrix4< T > &Camera< T >::inverseView() const
+{
+  refresh();
+  return invViewMatrix;
+}
+
+//
+template< typename T >
+inline const Matrix4< T > &Camera< T >::inverseProjection() const
+{
+  refresh();
+  return invProjMatrix;
+}
+
+//
+template< typename T >
+inline const Matrix4< T > &Camera< T >::inverseViewProjection() const
+{
+  refresh();
+  return invViewProjMatrix;
+}
+
+//
+template< typename T >
+inline const Plane< T > *Camera< T >::frustum() const
+{
+  refresh();
+  return planes;
+}
+
+//
+template< typename T >
+void Camera< T >::refresh() const
+{
+  if( dirty == 0 )
+    {
+      return;
+    }
+
+  if( dirty & DIRTY_VIEW )
+    {
+      if( rightHanded )
+	Matrix4< T >::viewRH( viewMatrix, eyePos, lookAt, upDir );
+      else
+	Matrix4< T >::viewLH( viewMatrix, eyePos, lookAt, upDir );
+      inverseRigid( invViewMatrix, viewMatrix );
+    }
+
+  if( dirty & DIRTY_PROJECTION )
+    {
+      if( type == PERSPECTIVE )
+	{
+	  if( rightHanded )
+	    Matrix4< T >::perspectiveRH( projMatrix, fovy, aspect, zn, zf );
+	  else
+	    Matrix4< T >::perspectiveLH( projMatrix, fovy, aspect, zn, zf );
+	  inversePerspective( invProjMatrix, projMatrix );
+	}
+      else
+	{
+	  if( rightHanded )
+	    Matrix4< T >::orthoRH( projMatrix, width, height, zn, zf );
+	  else
+	    Matrix4< T >::orthoLH( projMatrix, width, height, zn, zf );
+	  inverseOrtho( invProjMatrix, projMatrix );
+	}
+    }
+
+  viewProjMatrix = viewMatrix * projMatrix;
+  invViewProjMatrix = invProjMatrix * invViewMatrix;
+  frustumPlanes( planes, viewProjMatrix );
+  dirty = 0;
+}
+
+//
+template< typename T >
+void Camera< T >::update( const Camera< T > *cameras, unsigned int n )
+{
+#ifdef _OPENMP
+#pragma omp parallel for if( n > 64 )
+#endif
+  for( int i = 0; i < static_cast< int >( n ); ++i )
+    {
+      cameras[ i ].refresh();
+    }
+}
+
+//
+template< typename T >
+Matrix4< T > &Camera< T >::inverseRigid( Matrix4< T > &m, const Matrix4< T > &m0 )
+{
+  // transpose rotation, rotate negated translation
+  T x = m0._41, y = m0._42, z = m0._43;
+  m = Matrix4< T >(
+		   m0._11, m0._21, m0._31, 0,
+		   m0._12, m0._22, m0._32, 0,
+		   m0._13, m0._23, m0._33, 0,
+		   -( x * m0._11 + y * m0._12 + z * m0._13 ),
+		   -( x * m0._21 + y * m0._22 + z * m0._23 ),
+		   -( x * m0._31 + y * m0._32 + z * m0._33 ), 1 );
+  return m;
+}
+
+//
+template< typename T >
+Matrix4< T > &Camera< T >::inversePerspective( Matrix4< T > &m, const Matrix4< T > &m0 )
+{
+  // m0 = | x 0 0 0 | 0 y 0 0 | 0 0 a s | 0 0 b 0 | with s = 1 ( LH ) or -1 ( RH )
+  T a = m0._33, s = m0._34, b = m0._43;
+  m = Matrix4< T >(
+		   1 / m0._11, 0, 0, 0,
+		   0, 1 / m0._22, 0, 0,
+		   0, 0, 0, 1 / b,
+		   0, 0, 1 / s, -a / ( s * b ) );
+  return m;
+}
+
+//
+template< typename T >
+Matrix4< T > &Camera< T >::inverseOrtho( Matrix4< T > &m, const Matrix4< T > &m0 )
+{
+  m = Matrix4< T >(
+		   1 / m0._11, 0, 0, 0,
+		   0, 1 / m0._22, 0, 0,
+		   0, 0, 1 / m0._33, 0,
+		   -m0._41 / m0._11, -m0._42 / m0._22, -m0._43 / m0._33, 1 );
+  return m;
+}
+
+//
+template< typename T >
+void Camera< T >::frustumPlanes( Plane< T > *planes, const Matrix4< T > &m )
+{
+  // clip = v * m, inside : -w <= x <= w, -w <= y <= w, 0 <= z <= w
+  planes[ PLANE_LEFT ] = Plane< T >( m._14 + m._11, m._24 + m._21, m._34 + m._31, m._44 + m._41 );
+  planes[ PLANE_RIGHT ] = Plane< T >( m._14 - m._11, m._24 - m._21, m._34 - m._31, m._44 - m._41 );
+  planes[ PLANE_BOTTOM ] = Plane< T >( m._14 + m._12, m._24 + m._22, m._34 + m._32, m._44 + m._42 );
+  planes[ PLANE_TOP ] = Plane< T >( m._14 - m._12, m._24 - m._22, m._34 - m._32, m._44 - m._42 );
+  planes[ PLANE_NEAR ] = Plane< T >( m._13, m._23, m._33, m._43 );
+  planes[ PLANE_FAR ] = Plane< T >( m._14 - m._13, m._24 - m._23, m._34 - m._33, m._44 - m._43 );
+
+  for( int i = 0; i < 6; ++i )
+    {
+      Plane< T > &p = planes[ i ];
+      T l = static_cast< T >( sqrt( static_cast< double >( p.a * p.a + p.b * p.b + p.c * p.c ) ) );
+      if( l > 0 )
+	{
+	  p /= l;
+	}
+    }
+}
+
+//
+template< typename T >
+inline void Camera< T >::projectBlock( unsigned char *visible, T *sx, T *sy, T *sz, const T *x, const T *y, const T *z, int m, const Matrix4< T > &vp, T width, T height )
+{
+  const T hw = width / 2, hh = height / 2;
+  for( int k = 0; k < m; ++k )
+    {
+      T cx = x[ k ] * vp._11 + y[ k ] * vp._21 + z[ k ] * vp._31 + vp._41;
+      T cy = x[ k ] * vp._12 + y[ k ] * vp._22 + z[ k ] * vp._32 + vp._42;
+      T cz = x[ k ] * vp._13 + y[ k ] * vp._23 + z[ k ] * vp._33 + vp._43;
+      T cw = x[ k ] * vp._14 + y[ k ] * vp._24 + z[ k ] * vp._34 + vp._44;
+
+      // rejected points are masked, not skipped, so the loop stays branch free
+      unsigned char in = ( cw > 0 ) & ( cx >= -cw ) & ( cx <= cw ) & ( cy >= -cw ) & ( cy <= cw ) & ( cz >= 0 ) & ( cz <= cw );
+      T iw = 1 / ( cw != 0 ? cw : 1 );
+      sx[ k ] = ( cx * iw + 1 ) * hw;
+      sy[ k ] = ( 1 - cy * iw ) * hh;
+      sz[ k ] = cz * iw;
+      visible[ k ] = in;
+    }
+}
+
+//
+template< typename T >
+void Camera< T >::project( unsigned char *visible, Vector3SoA< T > &screen, const Vector3SoA< T > &v, unsigned int n, const Matrix4< T > &viewProj, T width, T height )
+{
+  const int B = 256;
+  int blocks = static_cast< int >( ( n + B - 1 ) / B );
+
+#ifdef _OPENMP
+#pragma omp parallel for if( n > 65536 )
+#endif
+  for( int blk = 0; blk < blocks; ++blk )
+    {
+      int begin = blk * B;
+      int m = std::min( B, static_cast< int >( n ) - begin );
+
+      // local outputs keep the kernel free of runtime alias checks
+      T sx[ B ], sy[ B ], sz[ B ];
+      unsigned char h[ B ];
+      projectBlock( h, sx, sy, sz, v.x + begin, v.y + begin, v.z + begin, m, viewProj, width, height );
+
+      std::copy( sx, sx + m, screen.x + begin );
+      std::copy( sy, sy + m, screen.y + begin );
+      std::copy( sz, sz + m, screen.z + begin );
+      std::copy( h, h + m, visible + begin );
+    }
+}
+
+//
+template< typename T >
+void Camera< T >::project( unsigned char *visible, Vector3< T > *screen, const Vector3< T > *v, unsigned int n, const Matrix4< T > &viewProj, T width, T height )
+{
+  const int B = 256;
+  int blocks = static_cast< int >( ( n + B - 1 ) / B );
+
+#ifdef _OPENMP
+#pragma omp parallel for if( n > 65536 )
+#endif
+  for( int blk = 0; blk < blocks; ++blk )
+    {
+      int begin = blk * B;
+      int m = std::min( B, static_cast< int >( n ) - begin );
+
+      T x[ B ], y[ B ], z[ B ];
+      for( int k = 0; k < m; ++k )
+	{
+	  x[ k ] = v[ begin + k ].x;
+	  y[ k ] = v[ begin + k ].y;
+	  z[ k ] = v[ begin + k ].z;
+	}
+
+      T sx[ B ], sy[ B ], sz[ B ];
+      unsigned char h[ B ];
+      projectBlock( h, sx, sy, sz, x, y, z, m, viewProj, width, height );
+
+      for( int k = 0; k < m; ++k )
+	{
+	  screen[ begin + k ].x = sx[ k ];
+	  screen[ begin + k ].y = sy[ k ];
+	  screen[ begin + k ].z = sz[ k ];
+	  visible[ begin + k ] = h[ k ];
+	}
+    }
+}
+
+typedef Camera< float > CameraF;
+typedef Camera< double > CameraD;
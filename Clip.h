@@ -0,0 +1,206 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include "Vector3.h"
+#include "Plane.h"
+#include "Instrument.h"
+
+//! Polygon and triangle clipping against planes (Sutherland-Hodgman)
+/*!
+  The part in front of the planes ( Plane::dot >= 0 ) is kept.
+*/
+template< typename T = double >
+struct Clip
+{
+  // static function
+  /*!
+    @brief clip convex polygon against plane
+    @param out output polygon, capacity n + 1
+    @return number of output vertices
+  */
+  static unsigned int polygon( Vector3< T > *out, const Vector3< T > *in, unsigned int n, const Plane< T > &plane );
+  /*!
+    @brief clip convex polygon against planes
+    @param out output polygon, capacity n + planeCount
+    @param work work buffer, capacity n + planeCount
+    @return number of output vertices
+  */
+  static unsigned int polygon( Vector3< T > *out, Vector3< T > *work, const Vector3< T > *in, unsigned int n, const Plane< T > *planes, unsigned int planeCount );
+  /*!
+    @brief clip triangle list against planes
+    @param out output triangle list ( 3 vertices per triangle )
+    @param capacity number of triangles out can hold, triCount * ( planeCount + 1 ) is always enough
+    @return number of clipped triangles ; only the first capacity are written, so a result above capacity means out was too small
+  */
+  static unsigned int triangles( Vector3< T > *out, unsigned int capacity, const Vector3< T > *tri, unsigned int triCount, const Plane< T > *planes, unsigned int planeCount );
+
+  // number of triangles that a thread clips at once
+  static const unsigned int BLOCK = 4096;
+
+private:
+  static unsigned int triangle( Vector3< T > *poly, Vector3< T > *work, const Vector3< T > *v, const Plane< T > *planes, unsigned int planeCount );
+};
+
+//
+template< typename T >
+unsigned int Clip< T >::polygon( Vector3< T > *out, const Vector3< T > *in, unsigned int n, const Plane< T > &plane )
+{
+  if( n == 0 )
+    {
+      return 0;
+    }
+
+  unsigned int k = 0;
+  const Vector3< T > *a = &in[ n - 1 ];
+  T da = Plane< T >::dot( plane, *a );
+  for( unsigned int i = 0; i < n; ++i )
+    {
+      const Vector3< T > *b = &in[ i ];
+      T db = Plane< T >::dot( plane, *b );
+      if( ( da >= 0 ) != ( db >= 0 ) )
+	{
+	  T t = da / ( da - db );
+	  out[ k++ ] = *a + ( *b - *a ) * t;
+	}
+      if( db >= 0 )
+	{
+	  out[ k++ ] = *b;
+	}
+      a = b;
+      da = db;
+    }
+  return k;
+}
+
+//
+template< typename T >
+unsigned int Clip< T >::polygon( Vector3< T > *out, Vector3< T > *work, const Vector3< T > *in, unsigned int n, const Plane< T > *planes, unsigned int planeCount )
+{
+  if( planeCount == 0 )
+    {
+      for( unsigned int i = 0; i < n; ++i )
+	{
+	  out[ i ] = in[ i ];
+	}
+      return n;
+    }
+
+  // ping-pong between out and work so that the last pass writes to out
+  Vector3< T > *dst = ( planeCount % 2 ) ? out : work;
+  Vector3< T > *src = ( planeCount % 2 ) ? work : out;
+  n = polygon( dst, in, n, planes[ 0 ] );
+  for( unsigned int p = 1; p < planeCount && n > 0; ++p )
+    {
+      std::swap( src, dst );
+      n = polygon( dst, src, n, planes[ p ] );
+    }
+
+  if( dst != out )
+    {
+      for( unsigned int i = 0; i < n; ++i )
+	{
+	  out[ i ] = dst[ i ];
+	}
+    }
+  return n;
+}
+
+//
+template< typename T >
+unsigned int Clip< T >::triangle( Vector3< T > *poly, Vector3< T > *work, const Vector3< T > *v, const Plane< T > *planes, unsigned int planeCount )
+{
+  // trivial accept / reject before clipping
+  bool inside = true, outside = false;
+  for( unsigned int p = 0; p < planeCount && !outside; ++p )
+    {
+      T d0 = Plane< T >::dot( planes[ p ], v[ 0 ] );
+      T d1 = Plane< T >::dot( planes[ p ], v[ 1 ] );
+      T d2 = Plane< T >::dot( planes[ p ], v[ 2 ] );
+      inside = inside && d0 >= 0 && d1 >= 0 && d2 >= 0;
+      outside = ( d0 < 0 && d1 < 0 && d2 < 0 );
+    }
+  if( outside )
+    {
+      return 0;
+    }
+  if( inside )
+    {
+      poly[ 0 ] = v[ 0 ];
+      poly[ 1 ] = v[ 1 ];
+      poly[ 2 ] = v[ 2 ];
+      return 3;
+    }
+  return polygon( poly, work, v, 3, planes, planeCount );
+}
+
+//
+template< typename T >
+unsigned int Clip< T >::triangles( Vector3< T > *out, unsigned int capacity, const Vector3< T > *tri, unsigned int triCount, const Plane< T > *planes, unsigned int planeCount )
+{
+  MATH_INSTRUMENT_SCOPE( Instrument::CLIP_TRIANGLES, triCount );
+  int blocks = static_cast< int >( ( triCount + BLOCK - 1 ) / BLOCK );
+  // triangle counts of the blocks, then the first output triangle of each
+  std::vector< unsigned int > first( blocks + 1, 0 );
+
+  // blocks are counted, then clipped again and written straight to out, which
+  // costs a second clip of the triangles crossing a plane but no copy of the output
+#ifdef _OPENMP
+#pragma omp parallel
+#endif
+  {
+    // a convex polygon clipped by planeCount planes has at most 3 + planeCount vertices
+    std::vector< Vector3< T > > poly( 3 + planeCount ), work( 3 + planeCount );
+
+#ifdef _OPENMP
+#pragma omp for schedule( dynamic )
+#endif
+    for( int b = 0; b < blocks; ++b )
+      {
+	unsigned int begin = b * BLOCK;
+	unsigned int end = std::min( begin + BLOCK, triCount );
+	unsigned int k = 0;
+	for( unsigned int i = begin; i < end; ++i )
+	  {
+	    unsigned int n = triangle( &poly[ 0 ], &work[ 0 ], &tri[ i * 3 ], planes, planeCount );
+	    k += n > 2 ? n - 2 : 0;
+	  }
+	first[ b + 1 ] = k;
+      }
+
+#ifdef _OPENMP
+#pragma omp single
+#endif
+    for( int b = 0; b < blocks; ++b )
+      {
+	first[ b + 1 ] += first[ b ];
+      }
+
+#ifdef _OPENMP
+#pragma omp for schedule( dynamic )
+#endif
+    for( int b = 0; b < blocks; ++b )
+      {
+	unsigned int begin = b * BLOCK;
+	unsigned int end = std::min( begin + BLOCK, triCount );
+	// only the first capacity triangles are written
+	unsigned int k = first[ b ];
+	for( unsigned int i = begin; i < end && k < capacity; ++i )
+	  {
+	    unsigned int n = triangle( &poly[ 0 ], &work[ 0 ], &tri[ i * 3 ], planes, planeCount );
+	    for( unsigned int j = 2; j < n && k < capacity; ++j, ++k )
+	      {
+		out[ k * 3 ] = poly[ 0 ];
+		out[ k * 3 + 1 ] = poly[ j - 1 ];
+		out[ k * 3 + 2 ] = poly[ j ];
+	      }
+	  }
+      }
+  }
+
+  // the count keeps growing past capacity so that the caller can see the required size
+  return first[ blocks ];
+}
+
+typedef Clip< float > ClipF;
+typedef Clip< double > ClipD;
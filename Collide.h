@@ -0,0 +1,841 @@
+#pragma once
+
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include "Vector3.h"
+#include "Vector3SoA.h"
+#include "Plane.h"
+#include "Quaternion.h"
+#include "Dispatch.h"
+
+//! batched narrow-phase collision tests
+/*!
+  Each test takes n pairs of shapes in soa arrays and runs across pairs in
+  blocks of PAIR_BLOCK. A test is one or two branch-free passes over a
+  block ; with GCC 12 at -O3 -fno-math-errno every pass vectorizes across
+  pairs for float and double, only the loop storing hit bytes stays
+  scalar. Divisions are offset rather than guarded and choices between
+  cases are 0 / 1 weights, since a select around a division or an
+  expression used in one arm alone is turned back into a branch. Square
+  roots are taken in T between the passes by DispatchRoot at the
+  instruction set the caller is compiled for. Results go to a
+  Contacts view : depth is the penetration along normal ( negative for
+  separated pairs, the separation along normal ), hit is depth >= 0, normal
+  points from the first shape of a pair to the second and point lies halfway
+  through the overlap.
+  Box and triangle pairs use the separating axis test ; their normal is the
+  axis of least penetration and point a single representative contact.
+*/
+template< typename T = double >
+struct Collide
+{
+  //! contact outputs of a batch, n entries each ( not owned )
+  struct Contacts
+  {
+    Contacts();
+    Contacts( unsigned char *hit, const Vector3SoA< T > &point, const Vector3SoA< T > &normal, T *depth );
+
+    unsigned char *hit;
+    Vector3SoA< T > point, normal;
+    T *depth;
+  };
+
+  // static function
+  /*!
+    @brief test spheres c0, r0 against spheres c1, r1
+  */
+  static void sphereSphere( Contacts &o, const Vector3SoA< T > &c0, const T *r0, const Vector3SoA< T > &c1, const T *r1, unsigned int n );
+  /*!
+    @brief test spheres against one plane ( unit normal, solid on the negative side )
+  */
+  static void spherePlane( Contacts &o, const Vector3SoA< T > &c, const T *r, const Plane< T > &plane, unsigned int n );
+  /*!
+    @brief test spheres against planes ( unit normals pn, offsets pd as Plane::d )
+  */
+  static void spherePlane( Contacts &o, const Vector3SoA< T > &c, const T *r, const Vector3SoA< T > &pn, const T *pd, unsigned int n );
+  /*!
+    @brief test spheres against triangles v0, v1, v2
+  */
+  static void sphereTriangle( Contacts &o, const Vector3SoA< T > &c, const T *r, const Vector3SoA< T > &v0, const Vector3SoA< T > &v1, const Vector3SoA< T > &v2, unsigned int n );
+  /*!
+    @brief test capsules ( segment a0 - a1, radius ra ) against capsules ( b0 - b1, rb )
+  */
+  static void capsuleCapsule( Contacts &o, const Vector3SoA< T > &a0, const Vector3SoA< T > &a1, const T *ra, const Vector3SoA< T > &b0, const Vector3SoA< T > &b1, const T *rb, unsigned int n );
+  /*!
+    @brief test oriented boxes ( center, half extent, unit orientation as OBB )
+  */
+  static void boxBox( Contacts &o, const Vector3SoA< T > &ca, const Vector3SoA< T > &ea, const Quaternion< T > *qa, const Vector3SoA< T > &cb, const Vector3SoA< T > &eb, const Quaternion< T > *qb, unsigned int n );
+  /*!
+    @brief test triangles a0, a1, a2 against triangles b0, b1, b2
+  */
+  static void triangleTriangle( Contacts &o, const Vector3SoA< T > &a0, const Vector3SoA< T > &a1, const Vector3SoA< T > &a2, const Vector3SoA< T > &b0, const Vector3SoA< T > &b1, const Vector3SoA< T > &b2, unsigned int n );
+
+  // pairs tested per block in the batch loops
+  static const unsigned int PAIR_BLOCK = 256;
+
+private:
+  struct Block
+  {
+    void store( Contacts &o, unsigned int begin, unsigned int k ) const;
+
+    T px[ PAIR_BLOCK ], py[ PAIR_BLOCK ], pz[ PAIR_BLOCK ];
+    T nx[ PAIR_BLOCK ], ny[ PAIR_BLOCK ], nz[ PAIR_BLOCK ];
+    T d[ PAIR_BLOCK ];
+    // squared lengths from the first pass, their roots in the second
+    T l[ PAIR_BLOCK ], f[ PAIR_BLOCK ];
+  };
+
+  //! best separating axis of a triangle pair so far
+  struct Axis
+  {
+    T key, best, l2, x, y, z;
+    T kind, a, b;
+  };
+
+#if defined( __AVX512F__ ) && defined( __AVX512VL__ ) && defined( __AVX512DQ__ )
+  typedef DispatchRoot< T, Cpu::AVX512 > Root;
+#elif defined( __AVX2__ ) && defined( __FMA__ )
+  typedef DispatchRoot< T, Cpu::AVX2 > Root;
+#elif defined( __SSE4_2__ )
+  typedef DispatchRoot< T, Cpu::SSE42 > Root;
+#else
+  typedef DispatchRoot< T, Cpu::SCALAR > Root;
+#endif
+
+  static MATH_DISPATCH_INLINE void centers( Block &o, unsigned int i, T px, T py, T pz, T qx, T qy, T qz );
+  static MATH_DISPATCH_INLINE void spheres( Block &o, unsigned int i, T ra, T rb, T fx, T fy, T fz );
+  static MATH_DISPATCH_INLINE void segments( T &s, T &t, T d1x, T d1y, T d1z, T d2x, T d2y, T d2z, T rx, T ry, T rz );
+  static MATH_DISPATCH_INLINE void boxes( T u[ 2 ][ 3 ][ 3 ], T e[ 2 ][ 3 ], T c[ 2 ][ 3 ], const Vector3SoA< T > &ca, const Vector3SoA< T > &ea, const Quaternion< T > &qa, const Vector3SoA< T > &cb, const Vector3SoA< T > &eb, const Quaternion< T > &qb, unsigned int j );
+  static MATH_DISPATCH_INLINE void triangles( T v[ 2 ][ 3 ][ 3 ], T e[ 2 ][ 4 ][ 3 ], const Vector3SoA< T > &a0, const Vector3SoA< T > &a1, const Vector3SoA< T > &a2, const Vector3SoA< T > &b0, const Vector3SoA< T > &b1, const Vector3SoA< T > &b2, unsigned int j );
+  static MATH_DISPATCH_INLINE void separate( Axis &s, const T v[ 2 ][ 3 ][ 3 ], const T *p, const T *q, T kind, T a, T b );
+  static MATH_DISPATCH_INLINE T clamp( T v );
+  static MATH_DISPATCH_INLINE T inverse( T v );
+  static MATH_DISPATCH_INLINE void weights( T w[ 3 ], T i );
+};
+
+//
+template< typename T >
+inline Collide< T >::Contacts::Contacts() : hit( 0 ), depth( 0 )
+{
+}
+
+//
+template< typename T >
+inline Collide< T >::Contacts::Contacts( unsigned char *h, const Vector3SoA< T > &p, const Vector3SoA< T > &nrm, T *d ) : hit( h ), point( p ), normal( nrm ), depth( d )
+{
+}
+
+//
+template< typename T >
+inline void Collide< T >::Block::store( Contacts &o, unsigned int begin, unsigned int k ) const
+{
+  std::copy( px, px + k, o.point.x + begin );
+  std::copy( py, py + k, o.point.y + begin );
+  std::copy( pz, pz + k, o.point.z + begin );
+  std::copy( nx, nx + k, o.normal.x + begin );
+  std::copy( ny, ny + k, o.normal.y + begin );
+  std::copy( nz, nz + k, o.normal.z + begin );
+  std::copy( d, d + k, o.depth + begin );
+  for( unsigned int i = 0; i < k; ++i )
+    {
+      // NaN depths do not hit
+      o.hit[ begin + i ] = d[ i ] >= 0;
+    }
+}
+
+//
+template< typename T >
+inline T Collide< T >::clamp( T v )
+{
+  // both tests on v, a test on the first result is known on one path and GCC threads it
+  T u = v < 1 ? v : 1;
+  return v > 0 ? u : 0;
+}
+
+//
+template< typename T >
+inline T Collide< T >::inverse( T v )
+{
+  // 1 / v for v >= 0, finite at 0 where callers scale values that vanish with v ;
+  // offset rather than selected, GCC turns a select into a branch around the division
+  return 1 / ( v + std::numeric_limits< T >::min() );
+}
+
+//
+template< typename T >
+inline void Collide< T >::weights( T w[ 3 ], T i )
+{
+  // w[ h ] is 1 for h == i and 0 otherwise, i in 0, 1, 2 ; the sum of finite values
+  // so weighted is exact, and unlike a select GCC can neither sink nor thread it
+  w[ 0 ] = ( 1 - i ) * ( 2 - i ) / 2;
+  w[ 1 ] = i * ( 2 - i );
+  w[ 2 ] = i * ( i - 1 ) / 2;
+}
+
+//
+template< typename T >
+inline void Collide< T >::centers( Block &o, unsigned int i, T px, T py, T pz, T qx, T qy, T qz )
+{
+  // first pass of a sphere contact : p, q - p and its squared length
+  T dx = qx - px, dy = qy - py, dz = qz - pz;
+  o.px[ i ] = px;
+  o.py[ i ] = py;
+  o.pz[ i ] = pz;
+  o.nx[ i ] = dx;
+  o.ny[ i ] = dy;
+  o.nz[ i ] = dz;
+  o.l[ i ] = dx * dx + dy * dy + dz * dz;
+}
+
+//
+template< typename T >
+inline void Collide< T >::spheres( Block &o, unsigned int i, T ra, T rb, T fx, T fy, T fz )
+{
+  // contact of spheres p, ra and q, rb from centers, with l now the distance ;
+  // coincident centers take normal f
+  // q - p scaled by inverse( 0 ) is still zero, so f is added rather than selected :
+  // GCC sinks a value used by one arm of a select into a branch it will not if-convert
+  T l = o.l[ i ];
+  T s = inverse( l ), m = l > 0 ? 0 : 1;
+  T dx = o.nx[ i ] * s + fx * m;
+  T dy = o.ny[ i ] * s + fy * m;
+  T dz = o.nz[ i ] * s + fz * m;
+  T d = ra + rb - l;
+  T h = ra - d / 2;
+  o.px[ i ] += dx * h;
+  o.py[ i ] += dy * h;
+  o.pz[ i ] += dz * h;
+  o.nx[ i ] = dx;
+  o.ny[ i ] = dy;
+  o.nz[ i ] = dz;
+  o.d[ i ] = d;
+}
+
+//
+template< typename T >
+inline void Collide< T >::segments( T &s, T &t, T d1x, T d1y, T d1z, T d2x, T d2y, T d2z, T rx, T ry, T rz )
+{
+  // closest points p1 + d1 s, p2 + d2 t of segments, r = p1 - p2 ( Ericson 5.1.9 )
+  T a = d1x * d1x + d1y * d1y + d1z * d1z;
+  T e = d2x * d2x + d2y * d2y + d2z * d2z;
+  T b = d1x * d2x + d1y * d2y + d1z * d2z;
+  T c = d1x * rx + d1y * ry + d1z * rz;
+  T f = d2x * rx + d2y * ry + d2z * rz;
+  // divisions stay unconditional so that the selects below vectorize
+  T ia = inverse( a ), ie = inverse( e );
+  T denom = a * e - b * b;
+  bool skew = denom > std::numeric_limits< T >::epsilon() * a * e;
+  T s0 = clamp( -c * ia ), s1 = clamp( ( b - c ) * ia );
+  T sk = clamp( ( b * f - c * e ) / ( std::abs( denom ) + std::numeric_limits< T >::min() ) );
+  // parallel or degenerate segments start from the point nearest p2
+  s = skew ? sk : s0;
+  t = ( b * s + f ) * ie;
+  s = t < 0 ? s0 : ( t > 1 ? s1 : s );
+  t = clamp( t );
+}
+
+//
+template< typename T >
+inline void Collide< T >::boxes( T u[ 2 ][ 3 ][ 3 ], T e[ 2 ][ 3 ], T c[ 2 ][ 3 ], const Vector3SoA< T > &ca, const Vector3SoA< T > &ea, const Quaternion< T > &qa, const Vector3SoA< T > &cb, const Vector3SoA< T > &eb, const Quaternion< T > &qb, unsigned int j )
+{
+  // rows of the rotation matrices as Quaternion::toMatrix
+  const Quaternion< T > *q[ 2 ] = { &qa, &qb };
+  for( int m = 0; m < 2; ++m )
+    {
+      T x = q[ m ]->x, y = q[ m ]->y, z = q[ m ]->z, w = q[ m ]->w;
+      u[ m ][ 0 ][ 0 ] = 1 - 2 * ( y * y + z * z );
+      u[ m ][ 0 ][ 1 ] = 2 * ( x * y + z * w );
+      u[ m ][ 0 ][ 2 ] = 2 * ( z * x - w * y );
+      u[ m ][ 1 ][ 0 ] = 2 * ( x * y - z * w );
+      u[ m ][ 1 ][ 1 ] = 1 - 2 * ( z * z + x * x );
+      u[ m ][ 1 ][ 2 ] = 2 * ( y * z + w * x );
+      u[ m ][ 2 ][ 0 ] = 2 * ( z * x + w * y );
+      u[ m ][ 2 ][ 1 ] = 2 * ( y * z - x * w );
+      u[ m ][ 2 ][ 2 ] = 1 - 2 * ( y * y + x * x );
+    }
+  e[ 0 ][ 0 ] = ea.x[ j ]; e[ 0 ][ 1 ] = ea.y[ j ]; e[ 0 ][ 2 ] = ea.z[ j ];
+  e[ 1 ][ 0 ] = eb.x[ j ]; e[ 1 ][ 1 ] = eb.y[ j ]; e[ 1 ][ 2 ] = eb.z[ j ];
+  c[ 0 ][ 0 ] = ca.x[ j ]; c[ 0 ][ 1 ] = ca.y[ j ]; c[ 0 ][ 2 ] = ca.z[ j ];
+  c[ 1 ][ 0 ] = cb.x[ j ]; c[ 1 ][ 1 ] = cb.y[ j ]; c[ 1 ][ 2 ] = cb.z[ j ];
+}
+
+//
+template< typename T >
+inline void Collide< T >::triangles( T v[ 2 ][ 3 ][ 3 ], T e[ 2 ][ 4 ][ 3 ], const Vector3SoA< T > &a0, const Vector3SoA< T > &a1, const Vector3SoA< T > &a2, const Vector3SoA< T > &b0, const Vector3SoA< T > &b1, const Vector3SoA< T > &b2, unsigned int j )
+{
+  // vertices, edges ( e[ m ][ h ] from vertex h to h + 1 ), face normals in e[ m ][ 3 ]
+  const Vector3SoA< T > *s[ 2 ][ 3 ] = { { &a0, &a1, &a2 }, { &b0, &b1, &b2 } };
+  for( int m = 0; m < 2; ++m )
+    {
+      for( int h = 0; h < 3; ++h )
+	{
+	  v[ m ][ h ][ 0 ] = s[ m ][ h ]->x[ j ];
+	  v[ m ][ h ][ 1 ] = s[ m ][ h ]->y[ j ];
+	  v[ m ][ h ][ 2 ] = s[ m ][ h ]->z[ j ];
+	}
+      for( int h = 0; h < 3; ++h )
+	{
+	  for( int x = 0; x < 3; ++x )
+	    {
+	      e[ m ][ h ][ x ] = v[ m ][ ( h + 1 ) % 3 ][ x ] - v[ m ][ h ][ x ];
+	    }
+	}
+      e[ m ][ 3 ][ 0 ] = e[ m ][ 0 ][ 1 ] * e[ m ][ 1 ][ 2 ] - e[ m ][ 0 ][ 2 ] * e[ m ][ 1 ][ 1 ];
+      e[ m ][ 3 ][ 1 ] = e[ m ][ 0 ][ 2 ] * e[ m ][ 1 ][ 0 ] - e[ m ][ 0 ][ 0 ] * e[ m ][ 1 ][ 2 ];
+      e[ m ][ 3 ][ 2 ] = e[ m ][ 0 ][ 0 ] * e[ m ][ 1 ][ 1 ] - e[ m ][ 0 ][ 1 ] * e[ m ][ 1 ][ 0 ];
+    }
+}
+
+//
+template< typename T >
+inline void Collide< T >::separate( Axis &s, const T v[ 2 ][ 3 ][ 3 ], const T *p, const T *q, T kind, T a, T b )
+{
+  // axis p x q, unnormalized : d / | l | ranks as d | d | / l^2, one square root for the winner
+  T x = p[ 1 ] * q[ 2 ] - p[ 2 ] * q[ 1 ];
+  T y = p[ 2 ] * q[ 0 ] - p[ 0 ] * q[ 2 ];
+  T z = p[ 0 ] * q[ 1 ] - p[ 1 ] * q[ 0 ];
+  T l2 = x * x + y * y + z * z;
+  T pp = p[ 0 ] * p[ 0 ] + p[ 1 ] * p[ 1 ] + p[ 2 ] * p[ 2 ];
+  T qq = q[ 0 ] * q[ 0 ] + q[ 1 ] * q[ 1 ] + q[ 2 ] * q[ 2 ];
+  // near parallel edges give no reliable axis
+  bool valid = l2 > std::numeric_limits< T >::epsilon() * pp * qq;
+  T lo[ 2 ], hi[ 2 ];
+  for( int m = 0; m < 2; ++m )
+    {
+      T d0 = v[ m ][ 0 ][ 0 ] * x + v[ m ][ 0 ][ 1 ] * y + v[ m ][ 0 ][ 2 ] * z;
+      T d1 = v[ m ][ 1 ][ 0 ] * x + v[ m ][ 1 ][ 1 ] * y + v[ m ][ 1 ][ 2 ] * z;
+      T d2 = v[ m ][ 2 ][ 0 ] * x + v[ m ][ 2 ][ 1 ] * y + v[ m ][ 2 ][ 2 ] * z;
+      lo[ m ] = std::min( d0, std::min( d1, d2 ) );
+      hi[ m ] = std::max( d0, std::max( d1, d2 ) );
+    }
+  // b beyond a along +axis, or behind it
+  T up = hi[ 0 ] - lo[ 1 ], down = hi[ 1 ] - lo[ 0 ];
+  T d = std::min( up, down ), sg = up <= down ? 1 : -1;
+  T k = d / ( l2 + std::numeric_limits< T >::min() ) * std::abs( d );
+  T sx = x * sg, sy = y * sg, sz = z * sg;
+  bool take = valid & ( k < s.key );
+  s.key = take ? k : s.key;
+  s.best = take ? d : s.best;
+  s.l2 = take ? l2 : s.l2;
+  s.x = take ? sx : s.x;
+  s.y = take ? sy : s.y;
+  s.z = take ? sz : s.z;
+  s.kind = take ? kind : s.kind;
+  s.a = take ? a : s.a;
+  s.b = take ? b : s.b;
+}
+
+//
+template< typename T >
+void Collide< T >::sphereSphere( Contacts &o, const Vector3SoA< T > &c0, const T *r0, const Vector3SoA< T > &c1, const T *r1, unsigned int n )
+{
+  int blocks = static_cast< int >( ( n + PAIR_BLOCK - 1 ) / PAIR_BLOCK );
+
+#ifdef _OPENMP
+#pragma omp parallel for if( n > 65536 )
+#endif
+  for( int b = 0; b < blocks; ++b )
+    {
+      unsigned int begin = b * PAIR_BLOCK;
+      unsigned int k = std::min( begin + PAIR_BLOCK, n ) - begin;
+      const T *ax = c0.x + begin, *ay = c0.y + begin, *az = c0.z + begin, *ar = r0 + begin;
+      const T *bx = c1.x + begin, *by = c1.y + begin, *bz = c1.z + begin, *br = r1 + begin;
+      Block c;
+      for( unsigned int i = 0; i < k; ++i )
+	{
+	  centers( c, i, ax[ i ], ay[ i ], az[ i ], bx[ i ], by[ i ], bz[ i ] );
+	}
+      Root::run( c.l, k );
+      for( unsigned int i = 0; i < k; ++i )
+	{
+	  spheres( c, i, ar[ i ], br[ i ], 0, 0, 1 );
+	}
+      c.store( o, begin, k );
+    }
+}
+
+//
+template< typename T >
+void Collide< T >::spherePlane( Contacts &o, const Vector3SoA< T > &c, const T *r, const Plane< T > &plane, unsigned int n )
+{
+  const T a = plane.a, b = plane.b, cc = plane.c, dd = plane.d;
+  int blocks = static_cast< int >( ( n + PAIR_BLOCK - 1 ) / PAIR_BLOCK );
+
+#ifdef _OPENMP
+#pragma omp parallel for if( n > 65536 )
+#endif
+  for( int bl = 0; bl < blocks; ++bl )
+    {
+      unsigned int begin = bl * PAIR_BLOCK;
+      unsigned int k = std::min( begin + PAIR_BLOCK, n ) - begin;
+      const T *x = c.x + begin, *y = c.y + begin, *z = c.z + begin, *s = r + begin;
+      Block o2;
+      for( unsigned int i = 0; i < k; ++i )
+	{
+	  // the solid lies behind the plane, so the normal into it is -n
+	  T dist = a * x[ i ] + b * y[ i ] + cc * z[ i ] + dd;
+	  T d = s[ i ] - dist;
+	  T h = dist + d / 2;
+	  o2.px[ i ] = x[ i ] - a * h;
+	  o2.py[ i ] = y[ i ] - b * h;
+	  o2.pz[ i ] = z[ i ] - cc * h;
+	  o2.nx[ i ] = -a;
+	  o2.ny[ i ] = -b;
+	  o2.nz[ i ] = -cc;
+	  o2.d[ i ] = d;
+	}
+      o2.store( o, begin, k );
+    }
+}
+
+//
+template< typename T >
+void Collide< T >::spherePlane( Contacts &o, const Vector3SoA< T > &c, const T *r, const Vector3SoA< T > &pn, const T *pd, unsigned int n )
+{
+  int blocks = static_cast< int >( ( n + PAIR_BLOCK - 1 ) / PAIR_BLOCK );
+
+#ifdef _OPENMP
+#pragma omp parallel for if( n > 65536 )
+#endif
+  for( int bl = 0; bl < blocks; ++bl )
+    {
+      unsigned int begin = bl * PAIR_BLOCK;
+      unsigned int k = std::min( begin + PAIR_BLOCK, n ) - begin;
+      const T *x = c.x + begin, *y = c.y + begin, *z = c.z + begin, *s = r + begin;
+      const T *a = pn.x + begin, *b = pn.y + begin, *cc = pn.z + begin, *dd = pd + begin;
+      Block o2;
+      for( unsigned int i = 0; i < k; ++i )
+	{
+	  T dist = a[ i ] * x[ i ] + b[ i ] * y[ i ] + cc[ i ] * z[ i ] + dd[ i ];
+	  T d = s[ i ] - dist;
+	  T h = dist + d / 2;
+	  o2.px[ i ] = x[ i ] - a[ i ] * h;
+	  o2.py[ i ] = y[ i ] - b[ i ] * h;
+	  o2.pz[ i ] = z[ i ] - cc[ i ] * h;
+	  o2.nx[ i ] = -a[ i ];
+	  o2.ny[ i ] = -b[ i ];
+	  o2.nz[ i ] = -cc[ i ];
+	  o2.d[ i ] = d;
+	}
+      o2.store( o, begin, k );
+    }
+}
+
+//
+template< typename T >
+void Collide< T >::sphereTriangle( Contacts &o, const Vector3SoA< T > &c, const T *r, const Vector3SoA< T > &v0, const Vector3SoA< T > &v1, const Vector3SoA< T > &v2, unsigned int n )
+{
+  const T eps = std::numeric_limits< T >::min();
+  int blocks = static_cast< int >( ( n + PAIR_BLOCK - 1 ) / PAIR_BLOCK );
+
+#ifdef _OPENMP
+#pragma omp parallel for if( n > 65536 )
+#endif
+  for( int bl = 0; bl < blocks; ++bl )
+    {
+      unsigned int begin = bl * PAIR_BLOCK;
+      unsigned int k = std::min( begin + PAIR_BLOCK, n ) - begin;
+      const T *x = c.x + begin, *y = c.y + begin, *z = c.z + begin, *s0 = r + begin;
+      const T *x0 = v0.x + begin, *y0 = v0.y + begin, *z0 = v0.z + begin;
+      const T *x1 = v1.x + begin, *y1 = v1.y + begin, *z1 = v1.z + begin;
+      const T *x2 = v2.x + begin, *y2 = v2.y + begin, *z2 = v2.z + begin;
+      Block o2;
+      for( unsigned int i = 0; i < k; ++i )
+	{
+	  T px = x[ i ], py = y[ i ], pz = z[ i ];
+	  T ax = x0[ i ], ay = y0[ i ], az = z0[ i ];
+	  T bx = x1[ i ], by = y1[ i ], bz = z1[ i ];
+	  T cx = x2[ i ], cy = y2[ i ], cz = z2[ i ];
+	  T abx = bx - ax, aby = by - ay, abz = bz - az;
+	  T bcx = cx - bx, bcy = cy - by, bcz = cz - bz;
+	  T cax = ax - cx, cay = ay - cy, caz = az - cz;
+	  T apx = px - ax, apy = py - ay, apz = pz - az;
+	  T bpx = px - bx, bpy = py - by, bpz = pz - bz;
+	  T cpx = px - cx, cpy = py - cy, cpz = pz - cz;
+	  // face normal ( -ca ) x ab = ab x ac
+	  T fx = cay * abz - caz * aby, fy = caz * abx - cax * abz, fz = cax * aby - cay * abx;
+	  T ff = fx * fx + fy * fy + fz * fz;
+
+	  // nearest points on the three edges
+	  T t, ex, ey, ez, qx, qy, qz, rx, ry, rz, qq, dd;
+	  t = clamp( ( apx * abx + apy * aby + apz * abz ) / ( abx * abx + aby * aby + abz * abz + eps ) );
+	  qx = ax + abx * t; qy = ay + aby * t; qz = az + abz * t;
+	  ex = px - qx; ey = py - qy; ez = pz - qz;
+	  qq = ex * ex + ey * ey + ez * ez;
+	  t = clamp( ( bpx * bcx + bpy * bcy + bpz * bcz ) / ( bcx * bcx + bcy * bcy + bcz * bcz + eps ) );
+	  rx = bx + bcx * t; ry = by + bcy * t; rz = bz + bcz * t;
+	  ex = px - rx; ey = py - ry; ez = pz - rz;
+	  dd = ex * ex + ey * ey + ez * ez;
+	  qx = dd < qq ? rx : qx;
+	  qy = dd < qq ? ry : qy;
+	  qz = dd < qq ? rz : qz;
+	  qq = dd < qq ? dd : qq;
+	  t = clamp( ( cpx * cax + cpy * cay + cpz * caz ) / ( cax * cax + cay * cay + caz * caz + eps ) );
+	  rx = cx + cax * t; ry = cy + cay * t; rz = cz + caz * t;
+	  ex = px - rx; ey = py - ry; ez = pz - rz;
+	  dd = ex * ex + ey * ey + ez * ez;
+	  qx = dd < qq ? rx : qx;
+	  qy = dd < qq ? ry : qy;
+	  qz = dd < qq ? rz : qz;
+
+	  // inside all three edges the projection onto the plane is nearest
+	  T w0 = ( ( aby * apz - abz * apy ) * fx + ( abz * apx - abx * apz ) * fy + ( abx * apy - aby * apx ) * fz );
+	  T w1 = ( ( bcy * bpz - bcz * bpy ) * fx + ( bcz * bpx - bcx * bpz ) * fy + ( bcx * bpy - bcy * bpx ) * fz );
+	  T w2 = ( ( cay * cpz - caz * cpy ) * fx + ( caz * cpx - cax * cpz ) * fy + ( cax * cpy - cay * cpx ) * fz );
+	  // weighted by 0 and 1 rather than selected, both points are finite so the sum is exact
+	  T m = static_cast< T >( ( w0 >= 0 ) & ( w1 >= 0 ) & ( w2 >= 0 ) & ( ff > 0 ) );
+	  T s = ( apx * fx + apy * fy + apz * fz ) / ( ff + eps );
+	  qx = ( px - fx * s ) * m + qx * ( 1 - m );
+	  qy = ( py - fy * s ) * m + qy * ( 1 - m );
+	  qz = ( pz - fz * s ) * m + qz * ( 1 - m );
+	  centers( o2, i, px, py, pz, qx, qy, qz );
+	  o2.f[ i ] = ff;
+	}
+      Root::run( o2.l, k );
+      Root::run( o2.f, k );
+      for( unsigned int i = 0; i < k; ++i )
+	{
+	  // a center on the triangle is pushed out of its front face
+	  T abx = x1[ i ] - x0[ i ], aby = y1[ i ] - y0[ i ], abz = z1[ i ] - z0[ i ];
+	  T cax = x0[ i ] - x2[ i ], cay = y0[ i ] - y2[ i ], caz = z0[ i ] - z2[ i ];
+	  T fx = cay * abz - caz * aby, fy = caz * abx - cax * abz, fz = cax * aby - cay * abx;
+	  T il = -inverse( o2.f[ i ] );
+	  spheres( o2, i, s0[ i ], 0, fx * il, fy * il, fz * il + ( o2.f[ i ] > 0 ? 0 : 1 ) );
+	}
+      o2.store( o, begin, k );
+    }
+}
+
+//
+template< typename T >
+void Collide< T >::capsuleCapsule( Contacts &o, const Vector3SoA< T > &a0, const Vector3SoA< T > &a1, const T *ra, const Vector3SoA< T > &b0, const Vector3SoA< T > &b1, const T *rb, unsigned int n )
+{
+  int blocks = static_cast< int >( ( n + PAIR_BLOCK - 1 ) / PAIR_BLOCK );
+
+#ifdef _OPENMP
+#pragma omp parallel for if( n > 65536 )
+#endif
+  for( int bl = 0; bl < blocks; ++bl )
+    {
+      unsigned int begin = bl * PAIR_BLOCK;
+      unsigned int k = std::min( begin + PAIR_BLOCK, n ) - begin;
+      const T *ax0 = a0.x + begin, *ay0 = a0.y + begin, *az0 = a0.z + begin, *ax1 = a1.x + begin, *ay1 = a1.y + begin, *az1 = a1.z + begin;
+      const T *bx0 = b0.x + begin, *by0 = b0.y + begin, *bz0 = b0.z + begin, *bx1 = b1.x + begin, *by1 = b1.y + begin, *bz1 = b1.z + begin;
+      const T *sa = ra + begin, *sb = rb + begin;
+      Block o2;
+      for( unsigned int i = 0; i < k; ++i )
+	{
+	  T px = ax0[ i ], py = ay0[ i ], pz = az0[ i ];
+	  T qx = bx0[ i ], qy = by0[ i ], qz = bz0[ i ];
+	  T d1x = ax1[ i ] - px, d1y = ay1[ i ] - py, d1z = az1[ i ] - pz;
+	  T d2x = bx1[ i ] - qx, d2y = by1[ i ] - qy, d2z = bz1[ i ] - qz;
+	  T s, t;
+	  segments( s, t, d1x, d1y, d1z, d2x, d2y, d2z, px - qx, py - qy, pz - qz );
+	  centers( o2, i, px + d1x * s, py + d1y * s, pz + d1z * s, qx + d2x * t, qy + d2y * t, qz + d2z * t );
+	}
+      Root::run( o2.l, k );
+      for( unsigned int i = 0; i < k; ++i )
+	{
+	  spheres( o2, i, sa[ i ], sb[ i ], 0, 0, 1 );
+	}
+      o2.store( o, begin, k );
+    }
+}
+
+//
+template< typename T >
+void Collide< T >::boxBox( Contacts &o, const Vector3SoA< T > &ca, const Vector3SoA< T > &ea, const Quaternion< T > *qa, const Vector3SoA< T > &cb, const Vector3SoA< T > &eb, const Quaternion< T > *qb, unsigned int n )
+{
+  // edge axes closer than this to parallel cannot separate more than a face
+  const T parallel = 1 - std::numeric_limits< T >::epsilon() * 64;
+  int blocks = static_cast< int >( ( n + PAIR_BLOCK - 1 ) / PAIR_BLOCK );
+
+#ifdef _OPENMP
+#pragma omp parallel for if( n > 65536 )
+#endif
+  for( int bl = 0; bl < blocks; ++bl )
+    {
+      unsigned int begin = bl * PAIR_BLOCK;
+      unsigned int k = std::min( begin + PAIR_BLOCK, n ) - begin;
+      Block o2;
+      // first pass : the axis of least penetration
+      for( unsigned int i = 0; i < k; ++i )
+	{
+	  unsigned int j = begin + i;
+	  T u[ 2 ][ 3 ][ 3 ], e[ 2 ][ 3 ], c[ 2 ][ 3 ];
+	  boxes( u, e, c, ca, ea, qa[ j ], cb, eb, qb[ j ], j );
+	  T tx = c[ 1 ][ 0 ] - c[ 0 ][ 0 ], ty = c[ 1 ][ 1 ] - c[ 0 ][ 1 ], tz = c[ 1 ][ 2 ] - c[ 0 ][ 2 ];
+
+	  // r = rows of a against rows of b, t = center of b in the frame of a ( Gottschalk )
+	  T r[ 3 ][ 3 ], ar[ 3 ][ 3 ], t[ 3 ];
+	  for( int h = 0; h < 3; ++h )
+	    {
+	      t[ h ] = u[ 0 ][ h ][ 0 ] * tx + u[ 0 ][ h ][ 1 ] * ty + u[ 0 ][ h ][ 2 ] * tz;
+	      for( int m = 0; m < 3; ++m )
+		{
+		  r[ h ][ m ] = u[ 0 ][ h ][ 0 ] * u[ 1 ][ m ][ 0 ] + u[ 0 ][ h ][ 1 ] * u[ 1 ][ m ][ 1 ] + u[ 0 ][ h ][ 2 ] * u[ 1 ][ m ][ 2 ];
+		  ar[ h ][ m ] = std::abs( r[ h ][ m ] );
+		}
+	    }
+
+	  // 3 + 3 face axes, then 9 edge axes ; faces win ties
+	  // edge axes are compared unnormalized, d / | l | < b / | lb | as d | d | lb^2 < b | b | l^2
+	  T best = std::numeric_limits< T >::max(), bl2 = 1, lx = 0, ly = 0, lz = 1;
+	  T kind = 0, ai = 0, bi = 0;
+	  for( int h = 0; h < 3; ++h )
+	    {
+	      T d = e[ 0 ][ h ] + e[ 1 ][ 0 ] * ar[ h ][ 0 ] + e[ 1 ][ 1 ] * ar[ h ][ 1 ] + e[ 1 ][ 2 ] * ar[ h ][ 2 ] - std::abs( t[ h ] );
+	      T sg = t[ h ] < 0 ? -1 : 1;
+	      T sx = u[ 0 ][ h ][ 0 ] * sg, sy = u[ 0 ][ h ][ 1 ] * sg, sz = u[ 0 ][ h ][ 2 ] * sg;
+	      bool take = d < best;
+	      best = take ? d : best;
+	      lx = take ? sx : lx;
+	      ly = take ? sy : ly;
+	      lz = take ? sz : lz;
+	      ai = take ? h : ai;
+	    }
+	  for( int m = 0; m < 3; ++m )
+	    {
+	      T dist = t[ 0 ] * r[ 0 ][ m ] + t[ 1 ] * r[ 1 ][ m ] + t[ 2 ] * r[ 2 ][ m ];
+	      T d = e[ 0 ][ 0 ] * ar[ 0 ][ m ] + e[ 0 ][ 1 ] * ar[ 1 ][ m ] + e[ 0 ][ 2 ] * ar[ 2 ][ m ] + e[ 1 ][ m ] - std::abs( dist );
+	      T sg = dist < 0 ? -1 : 1;
+	      T sx = u[ 1 ][ m ][ 0 ] * sg, sy = u[ 1 ][ m ][ 1 ] * sg, sz = u[ 1 ][ m ][ 2 ] * sg;
+	      bool take = d < best;
+	      best = take ? d : best;
+	      lx = take ? sx : lx;
+	      ly = take ? sy : ly;
+	      lz = take ? sz : lz;
+	      kind = take ? 1 : kind;
+	      bi = take ? m : bi;
+	    }
+	  T key = best * std::abs( best );
+	  for( int h = 0; h < 3; ++h )
+	    {
+	      int h1 = ( h + 1 ) % 3, h2 = ( h + 2 ) % 3;
+	      for( int m = 0; m < 3; ++m )
+		{
+		  int m1 = ( m + 1 ) % 3, m2 = ( m + 2 ) % 3;
+		  // near parallel edges are skipped, a face axis separates them as well
+		  T l2 = 1 - r[ h ][ m ] * r[ h ][ m ];
+		  T dist = t[ h2 ] * r[ h1 ][ m ] - t[ h1 ] * r[ h2 ][ m ];
+		  T d = e[ 0 ][ h1 ] * ar[ h2 ][ m ] + e[ 0 ][ h2 ] * ar[ h1 ][ m ] + e[ 1 ][ m1 ] * ar[ h ][ m2 ] + e[ 1 ][ m2 ] * ar[ h ][ m1 ] - std::abs( dist );
+		  T sg = dist < 0 ? -1 : 1, dd = d * std::abs( d );
+		  bool take = ( l2 > 1 - parallel ) & ( dd * bl2 < key * l2 );
+		  key = take ? dd : key;
+		  best = take ? d : best;
+		  bl2 = take ? l2 : bl2;
+		  // lx holds the sign until the winning edge axis is built in the second pass
+		  lx = take ? sg : lx;
+		  kind = take ? 2 : kind;
+		  ai = take ? h : ai;
+		  bi = take ? m : bi;
+		}
+	    }
+	  // the point is written in the second pass, until then it holds the axis
+	  o2.px[ i ] = kind;
+	  o2.py[ i ] = ai;
+	  o2.pz[ i ] = bi;
+	  o2.nx[ i ] = lx;
+	  o2.ny[ i ] = ly;
+	  o2.nz[ i ] = lz;
+	  o2.d[ i ] = best;
+	  o2.l[ i ] = bl2;
+	}
+      Root::run( o2.l, k );
+      // second pass : normal and contact point
+      for( unsigned int i = 0; i < k; ++i )
+	{
+	  unsigned int j = begin + i;
+	  T u[ 2 ][ 3 ][ 3 ], e[ 2 ][ 3 ], c[ 2 ][ 3 ];
+	  boxes( u, e, c, ca, ea, qa[ j ], cb, eb, qb[ j ], j );
+	  T kind = o2.px[ i ], ai = o2.py[ i ], bi = o2.pz[ i ];
+	  // candidates are weighted by kind, ai and bi rather than selected
+	  T wk[ 3 ], wa[ 3 ], wb[ 3 ];
+	  weights( wk, kind );
+	  weights( wa, ai );
+	  weights( wb, bi );
+	  T edge = wk[ 2 ], face = 1 - edge;
+	  // the winning edges ; face axes have l = 1
+	  T v[ 3 ], w[ 3 ];
+	  for( int m = 0; m < 3; ++m )
+	    {
+	      v[ m ] = u[ 0 ][ 0 ][ m ] * wa[ 0 ] + u[ 0 ][ 1 ][ m ] * wa[ 1 ] + u[ 0 ][ 2 ][ m ] * wa[ 2 ];
+	      w[ m ] = u[ 1 ][ 0 ][ m ] * wb[ 0 ] + u[ 1 ][ 1 ][ m ] * wb[ 1 ] + u[ 1 ][ 2 ][ m ] * wb[ 2 ];
+	    }
+	  T s = 1 / o2.l[ i ], sg = o2.nx[ i ] * s;
+	  T best = o2.d[ i ] * s;
+	  T cx = ( v[ 1 ] * w[ 2 ] - v[ 2 ] * w[ 1 ] ) * sg;
+	  T cy = ( v[ 2 ] * w[ 0 ] - v[ 0 ] * w[ 2 ] ) * sg;
+	  T cz = ( v[ 0 ] * w[ 1 ] - v[ 1 ] * w[ 0 ] ) * sg;
+	  T lx = cx * edge + o2.nx[ i ] * face;
+	  T ly = cy * edge + o2.ny[ i ] * face;
+	  T lz = cz * edge + o2.nz[ i ] * face;
+
+	  // deepest corners, a along the normal and b against it
+	  T sa[ 3 ] = { c[ 0 ][ 0 ], c[ 0 ][ 1 ], c[ 0 ][ 2 ] }, sb[ 3 ] = { c[ 1 ][ 0 ], c[ 1 ][ 1 ], c[ 1 ][ 2 ] };
+	  T ga[ 3 ], gb[ 3 ];
+	  for( int h = 0; h < 3; ++h )
+	    {
+	      ga[ h ] = u[ 0 ][ h ][ 0 ] * lx + u[ 0 ][ h ][ 1 ] * ly + u[ 0 ][ h ][ 2 ] * lz < 0 ? -e[ 0 ][ h ] : e[ 0 ][ h ];
+	      gb[ h ] = u[ 1 ][ h ][ 0 ] * lx + u[ 1 ][ h ][ 1 ] * ly + u[ 1 ][ h ][ 2 ] * lz < 0 ? e[ 1 ][ h ] : -e[ 1 ][ h ];
+	      for( int m = 0; m < 3; ++m )
+		{
+		  sa[ m ] += u[ 0 ][ h ][ m ] * ga[ h ];
+		  sb[ m ] += u[ 1 ][ h ][ m ] * gb[ h ];
+		}
+	    }
+
+	  // edge axes take the closest points of the two deepest edges, face axes
+	  // the incident corner moved halfway out along the normal
+	  T gv = ga[ 0 ] * wa[ 0 ] + ga[ 1 ] * wa[ 1 ] + ga[ 2 ] * wa[ 2 ];
+	  T gw = gb[ 0 ] * wb[ 0 ] + gb[ 1 ] * wb[ 1 ] + gb[ 2 ] * wb[ 2 ];
+	  T d1[ 3 ], d2[ 3 ], p[ 3 ], se, te;
+	  for( int m = 0; m < 3; ++m )
+	    {
+	      d1[ m ] = -2 * gv * v[ m ];
+	      d2[ m ] = -2 * gw * w[ m ];
+	    }
+	  segments( se, te, d1[ 0 ], d1[ 1 ], d1[ 2 ], d2[ 0 ], d2[ 1 ], d2[ 2 ], sa[ 0 ] - sb[ 0 ], sa[ 1 ] - sb[ 1 ], sa[ 2 ] - sb[ 2 ] );
+	  T h = best / 2 * ( 2 * wk[ 0 ] - 1 );
+	  T l[ 3 ] = { lx, ly, lz };
+	  for( int m = 0; m < 3; ++m )
+	    {
+	      T pe = ( sa[ m ] + d1[ m ] * se + sb[ m ] + d2[ m ] * te ) / 2;
+	      T pf = sb[ m ] * wk[ 0 ] + sa[ m ] * ( 1 - wk[ 0 ] ) + l[ m ] * h;
+	      p[ m ] = pe * edge + pf * face;
+	    }
+	  o2.px[ i ] = p[ 0 ];
+	  o2.py[ i ] = p[ 1 ];
+	  o2.pz[ i ] = p[ 2 ];
+	  o2.nx[ i ] = lx;
+	  o2.ny[ i ] = ly;
+	  o2.nz[ i ] = lz;
+	  o2.d[ i ] = best;
+	}
+      o2.store( o, begin, k );
+    }
+}
+
+//
+template< typename T >
+void Collide< T >::triangleTriangle( Contacts &o, const Vector3SoA< T > &a0, const Vector3SoA< T > &a1, const Vector3SoA< T > &a2, const Vector3SoA< T > &b0, const Vector3SoA< T > &b1, const Vector3SoA< T > &b2, unsigned int n )
+{
+  int blocks = static_cast< int >( ( n + PAIR_BLOCK - 1 ) / PAIR_BLOCK );
+
+#ifdef _OPENMP
+#pragma omp parallel for if( n > 65536 )
+#endif
+  for( int bl = 0; bl < blocks; ++bl )
+    {
+      unsigned int begin = bl * PAIR_BLOCK;
+      unsigned int k = std::min( begin + PAIR_BLOCK, n ) - begin;
+      Block o2;
+      // first pass : the axis of least penetration
+      for( unsigned int i = 0; i < k; ++i )
+	{
+	  T v[ 2 ][ 3 ][ 3 ], e[ 2 ][ 4 ][ 3 ];
+	  triangles( v, e, a0, a1, a2, b0, b1, b2, begin + i );
+	  // axes as cross products : 2 faces ( kind 0, 1 ), 9 edge pairs ( 2 ), then
+	  // 6 in-plane edge normals for coplanar pairs ( 3 ) ; written out, GCC keeps
+	  // loops over the calls rolled and the pass would not be innermost
+	  Axis s = { std::numeric_limits< T >::max(), -std::numeric_limits< T >::max(), 1, 0, 0, 1, 0, 0, 0 };
+	  separate( s, v, e[ 0 ][ 0 ], e[ 0 ][ 1 ], 0, 0, 1 );
+	  separate( s, v, e[ 1 ][ 0 ], e[ 1 ][ 1 ], 1, 0, 1 );
+	  separate( s, v, e[ 0 ][ 0 ], e[ 1 ][ 0 ], 2, 0, 0 );
+	  separate( s, v, e[ 0 ][ 0 ], e[ 1 ][ 1 ], 2, 0, 1 );
+	  separate( s, v, e[ 0 ][ 0 ], e[ 1 ][ 2 ], 2, 0, 2 );
+	  separate( s, v, e[ 0 ][ 1 ], e[ 1 ][ 0 ], 2, 1, 0 );
+	  separate( s, v, e[ 0 ][ 1 ], e[ 1 ][ 1 ], 2, 1, 1 );
+	  separate( s, v, e[ 0 ][ 1 ], e[ 1 ][ 2 ], 2, 1, 2 );
+	  separate( s, v, e[ 0 ][ 2 ], e[ 1 ][ 0 ], 2, 2, 0 );
+	  separate( s, v, e[ 0 ][ 2 ], e[ 1 ][ 1 ], 2, 2, 1 );
+	  separate( s, v, e[ 0 ][ 2 ], e[ 1 ][ 2 ], 2, 2, 2 );
+	  separate( s, v, e[ 0 ][ 3 ], e[ 0 ][ 0 ], 3, 3, 0 );
+	  separate( s, v, e[ 0 ][ 3 ], e[ 0 ][ 1 ], 3, 3, 1 );
+	  separate( s, v, e[ 0 ][ 3 ], e[ 0 ][ 2 ], 3, 3, 2 );
+	  separate( s, v, e[ 1 ][ 3 ], e[ 1 ][ 0 ], 3, 3, 0 );
+	  separate( s, v, e[ 1 ][ 3 ], e[ 1 ][ 1 ], 3, 3, 1 );
+	  separate( s, v, e[ 1 ][ 3 ], e[ 1 ][ 2 ], 3, 3, 2 );
+	  // the point is written in the second pass, until then it holds the axis
+	  o2.px[ i ] = s.kind;
+	  o2.py[ i ] = s.a;
+	  o2.pz[ i ] = s.b;
+	  o2.nx[ i ] = s.x;
+	  o2.ny[ i ] = s.y;
+	  o2.nz[ i ] = s.z;
+	  o2.d[ i ] = s.best;
+	  o2.l[ i ] = s.l2;
+	}
+      Root::run( o2.l, k );
+      // second pass : normal and contact point ; without a valid axis
+      // ( degenerate triangles ) the pair misses
+      for( unsigned int i = 0; i < k; ++i )
+	{
+	  T v[ 2 ][ 3 ][ 3 ], e[ 2 ][ 4 ][ 3 ];
+	  triangles( v, e, a0, a1, a2, b0, b1, b2, begin + i );
+	  T kind = o2.px[ i ], ai = o2.py[ i ], bi = o2.pz[ i ];
+	  // 1 for kind 0, 2 and 3 respectively, else 0 ; weights as in boxBox
+	  T face0 = ( 1 - kind ) * ( 2 - kind ) * ( 3 - kind ) / 6;
+	  T edge = kind * ( kind - 1 ) * ( 3 - kind ) / 2, plane = kind * ( kind - 1 ) * ( kind - 2 ) / 6;
+	  T face = 1 - edge - plane;
+	  T s = 1 / o2.l[ i ];
+	  T best = o2.d[ i ] * s, lx = o2.nx[ i ] * s, ly = o2.ny[ i ] * s, lz = o2.nz[ i ] * s;
+
+	  // deepest vertices, a along the normal and b against it
+	  T da[ 3 ], db[ 3 ];
+	  for( int h = 0; h < 3; ++h )
+	    {
+	      da[ h ] = v[ 0 ][ h ][ 0 ] * lx + v[ 0 ][ h ][ 1 ] * ly + v[ 0 ][ h ][ 2 ] * lz;
+	      db[ h ] = v[ 1 ][ h ][ 0 ] * lx + v[ 1 ][ h ][ 1 ] * ly + v[ 1 ][ h ][ 2 ] * lz;
+	    }
+	  // vertices and edges weighted rather than selected, as in boxBox ; the
+	  // in-plane axes have ai = 3, whose weights only reach the unused edge point
+	  // the first vertex wins ties ; a running extreme tests each condition once
+	  bool a1 = da[ 1 ] > da[ 0 ], b1 = db[ 1 ] < db[ 0 ];
+	  bool a2 = da[ 2 ] > std::max( da[ 0 ], da[ 1 ] ), b2 = db[ 2 ] < std::min( db[ 0 ], db[ 1 ] );
+	  T wa[ 3 ], wb[ 3 ];
+	  weights( wa, ai );
+	  weights( wb, bi );
+	  T sa[ 3 ], sb[ 3 ], pa[ 3 ], pb[ 3 ], d1[ 3 ], d2[ 3 ];
+	  for( int x = 0; x < 3; ++x )
+	    {
+	      sa[ x ] = a1 ? v[ 0 ][ 1 ][ x ] : v[ 0 ][ 0 ][ x ];
+	      sa[ x ] = a2 ? v[ 0 ][ 2 ][ x ] : sa[ x ];
+	      sb[ x ] = b1 ? v[ 1 ][ 1 ][ x ] : v[ 1 ][ 0 ][ x ];
+	      sb[ x ] = b2 ? v[ 1 ][ 2 ][ x ] : sb[ x ];
+	      // the two separating edges
+	      pa[ x ] = v[ 0 ][ 0 ][ x ] * wa[ 0 ] + v[ 0 ][ 1 ][ x ] * wa[ 1 ] + v[ 0 ][ 2 ][ x ] * wa[ 2 ];
+	      pb[ x ] = v[ 1 ][ 0 ][ x ] * wb[ 0 ] + v[ 1 ][ 1 ][ x ] * wb[ 1 ] + v[ 1 ][ 2 ][ x ] * wb[ 2 ];
+	      d1[ x ] = e[ 0 ][ 0 ][ x ] * wa[ 0 ] + e[ 0 ][ 1 ][ x ] * wa[ 1 ] + e[ 0 ][ 2 ][ x ] * wa[ 2 ];
+	      d2[ x ] = e[ 1 ][ 0 ][ x ] * wb[ 0 ] + e[ 1 ][ 1 ][ x ] * wb[ 1 ] + e[ 1 ][ 2 ][ x ] * wb[ 2 ];
+	    }
+
+	  // edge pairs take the closest points of the separating edges, coplanar
+	  // pairs the middle of the deepest vertices and faces the incident vertex
+	  // moved halfway out along the normal
+	  T se, te;
+	  segments( se, te, d1[ 0 ], d1[ 1 ], d1[ 2 ], d2[ 0 ], d2[ 1 ], d2[ 2 ], pa[ 0 ] - pb[ 0 ], pa[ 1 ] - pb[ 1 ], pa[ 2 ] - pb[ 2 ] );
+	  T h = best / 2 * ( 2 * face0 - 1 );
+	  T l[ 3 ] = { lx, ly, lz }, p[ 3 ];
+	  for( int x = 0; x < 3; ++x )
+	    {
+	      T pe = ( pa[ x ] + d1[ x ] * se + pb[ x ] + d2[ x ] * te ) / 2;
+	      T pm = ( sa[ x ] + sb[ x ] ) / 2;
+	      T pf = sb[ x ] * face0 + sa[ x ] * ( 1 - face0 ) + l[ x ] * h;
+	      p[ x ] = pe * edge + pm * plane + pf * face;
+	    }
+	  o2.px[ i ] = p[ 0 ];
+	  o2.py[ i ] = p[ 1 ];
+	  o2.pz[ i ] = p[ 2 ];
+	  o2.nx[ i ] = lx;
+	  o2.ny[ i ] = ly;
+	  o2.nz[ i ] = lz;
+	  o2.d[ i ] = best;
+	}
+      o2.store( o, begin, k );
+    }
+}
+
+typedef Collide< float > CollideF;
+typedef Collide< double > CollideD;
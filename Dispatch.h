@@ -0,0 +1,617 @@
+#pragma once
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+#include "Vector3.h"
+#include "Vector3SoA.h"
+#include "Matrix4.h"
+#include "Color.h"
+#include "Instrument.h"
+
+#if defined( _MSC_VER ) && ( defined( _M_X64 ) || defined( _M_IX86 ) )
+#include <intrin.h>
+#endif
+
+#if ( defined( __GNUC__ ) || defined( __clang__ ) ) && ( defined( __x86_64__ ) || defined( __i386__ ) )
+#include <immintrin.h>
+#define MATH_DISPATCH_X86 1
+#define MATH_DISPATCH_INLINE inline __attribute__(( always_inline ))
+#define MATH_TARGET_SSE42 __attribute__(( target( "sse4.2" ) ))
+#define MATH_TARGET_AVX2 __attribute__(( target( "avx2,fma" ) ))
+#define MATH_TARGET_AVX512 __attribute__(( target( "avx512f,avx512vl,avx512dq,avx2,fma" ) ))
+#else
+#define MATH_DISPATCH_INLINE inline
+#endif
+
+//! cpu instruction set level
+/*!
+  Detected once with cpuid. The environment variable MATH_SIMD
+  ( scalar, sse4.2, avx2, avx512 ) lowers the level for testing
+  each path; it never raises it above what the cpu supports.
+*/
+struct Cpu
+{
+  enum Level
+    {
+      SCALAR,
+      SSE42,
+      AVX2,
+      AVX512
+    };
+
+  // static function
+  /*!
+    @brief detect highest level supported by cpu and os
+  */
+  static Level detect();
+  /*!
+    @brief level used by Dispatch ( detected and overridden once )
+  */
+  static Level level();
+  /*!
+    @brief parse level name, returns false if unknown
+  */
+  static bool parse( Level &level, const char *name );
+  /*!
+    @brief name of level
+  */
+  static const char *name( Level level );
+
+private:
+  static Level select();
+};
+
+//
+inline Cpu::Level Cpu::detect()
+{
+#if defined( MATH_DISPATCH_X86 )
+  __builtin_cpu_init();
+  if( __builtin_cpu_supports( "avx512f" ) && __builtin_cpu_supports( "avx512vl" ) && __builtin_cpu_supports( "avx512dq" ) )
+    {
+      return AVX512;
+    }
+  if( __builtin_cpu_supports( "avx2" ) && __builtin_cpu_supports( "fma" ) )
+    {
+      return AVX2;
+    }
+  if( __builtin_cpu_supports( "sse4.2" ) )
+    {
+      return SSE42;
+    }
+  return SCALAR;
+#elif defined( _MSC_VER ) && ( defined( _M_X64 ) || defined( _M_IX86 ) )
+  // kernels are not compiled per target on this compiler, the level is informative
+  int r[ 4 ];
+  __cpuid( r, 1 );
+  bool sse42 = ( r[ 2 ] & ( 1 << 20 ) ) != 0;
+  bool osxsave = ( r[ 2 ] & ( 1 << 27 ) ) != 0;
+  bool fma = ( r[ 2 ] & ( 1 << 12 ) ) != 0;
+  unsigned long long xcr0 = osxsave ? _xgetbv( 0 ) : 0;
+  __cpuidex( r, 7, 0 );
+  if( ( xcr0 & 0xe6 ) == 0xe6 && ( r[ 1 ] & ( 1 << 16 ) ) && ( r[ 1 ] & ( 1 << 17 ) ) && ( r[ 1 ] & ( 1 << 31 ) ) )
+    {
+      return AVX512;
+    }
+  if( ( xcr0 & 0x6 ) == 0x6 && ( r[ 1 ] & ( 1 << 5 ) ) && fma )
+    {
+      return AVX2;
+    }
+  return sse42 ? SSE42 : SCALAR;
+#else
+  return SCALAR;
+#endif
+}
+
+//
+inline Cpu::Level Cpu::level()
+{
+  static const Level selected = select();
+  return selected;
+}
+
+//
+inline Cpu::Level Cpu::select()
+{
+  Level l = detect();
+  const char *env = getenv( "MATH_SIMD" );
+  Level o;
+  if( env && parse( o, env ) && o < l )
+    {
+      l = o;
+    }
+  return l;
+}
+
+//
+inline bool Cpu::parse( Level &level, const char *name )
+{
+  if( strcmp( name, "scalar" ) == 0 )
+    level = SCALAR;
+  else if( strcmp( name, "sse4.2" ) == 0 || strcmp( name, "sse42" ) == 0 )
+    level = SSE42;
+  else if( strcmp( name, "avx2" ) == 0 )
+    level = AVX2;
+  else if( strcmp( name, "avx512" ) == 0 )
+    level = AVX512;
+  else
+    return false;
+  return true;
+}
+
+//
+inline const char *Cpu::name( Level level )
+{
+  switch( level )
+    {
+    case SSE42:
+      return "sse4.2";
+    case AVX2:
+      return "avx2";
+    case AVX512:
+      return "avx512";
+    default:
+      return "scalar";
+    }
+}
+
+//! square roots of a block, per instruction set level
+/*!
+  sqrt may set errno, so GCC keeps it scalar unless -fno-math-errno is given.
+  The x86 levels use the packed square root instructions instead, which
+  give the same correctly rounded results.
+*/
+template< typename T, Cpu::Level L >
+struct DispatchRoot
+{
+  static MATH_DISPATCH_INLINE void run( T *s, unsigned int n )
+  {
+    for( unsigned int i = 0; i < n; ++i )
+      {
+	s[ i ] = std::sqrt( s[ i ] );
+      }
+  }
+};
+
+#if defined( MATH_DISPATCH_X86 )
+#define MATH_DISPATCH_ROOT( TYPE, LEVEL, TARGET, WIDTH, SQRT )		\
+  template<>								\
+  struct DispatchRoot< TYPE, Cpu::LEVEL >				\
+  {									\
+    TARGET static void run( TYPE *s, unsigned int n )			\
+    {									\
+      unsigned int i = 0;						\
+      for( ; i + WIDTH <= n; i += WIDTH )				\
+	{								\
+	  SQRT;								\
+	}								\
+      for( ; i < n; ++i )						\
+	{								\
+	  s[ i ] = std::sqrt( s[ i ] );				\
+	}								\
+    }									\
+  };
+
+MATH_DISPATCH_ROOT( float, SSE42, MATH_TARGET_SSE42, 4, _mm_storeu_ps( s + i, _mm_sqrt_ps( _mm_loadu_ps( s + i ) ) ) )
+MATH_DISPATCH_ROOT( double, SSE42, MATH_TARGET_SSE42, 2, _mm_storeu_pd( s + i, _mm_sqrt_pd( _mm_loadu_pd( s + i ) ) ) )
+MATH_DISPATCH_ROOT( float, AVX2, MATH_TARGET_AVX2, 8, _mm256_storeu_ps( s + i, _mm256_sqrt_ps( _mm256_loadu_ps( s + i ) ) ) )
+MATH_DISPATCH_ROOT( double, AVX2, MATH_TARGET_AVX2, 4, _mm256_storeu_pd( s + i, _mm256_sqrt_pd( _mm256_loadu_pd( s + i ) ) ) )
+// the masked forms with every lane set avoid _mm512_undefined, which GCC warns about
+MATH_DISPATCH_ROOT( float, AVX512, MATH_TARGET_AVX512, 16, _mm512_storeu_ps( s + i, _mm512_maskz_sqrt_ps( 0xffff, _mm512_loadu_ps( s + i ) ) ) )
+MATH_DISPATCH_ROOT( double, AVX512, MATH_TARGET_AVX512, 8, _mm512_storeu_pd( s + i, _mm512_maskz_sqrt_pd( 0xff, _mm512_loadu_pd( s + i ) ) ) )
+
+#undef MATH_DISPATCH_ROOT
+#endif
+
+//! kernel bodies, compiled once per instruction set level by Dispatch
+/*!
+  Every wide loop runs exactly BLOCK iterations over local arrays ( a short
+  last block is padded ), so it vectorizes without a scalar epilogue or
+  alias checks, which the -O2 cost model of GCC requires. Bodies are written
+  out rather than calling the baseline members, which would be compiled for
+  the baseline instruction set.
+*/
+template< typename T >
+struct DispatchKernel
+{
+  enum
+    {
+      BLOCK = 256
+    };
+
+  static MATH_DISPATCH_INLINE void multiply( Matrix4< T > *m, const Matrix4< T > *m1, const Matrix4< T > *m2, unsigned int n )
+  {
+    // row r of the product is the sum of the rows of m2 weighted by row r of m1,
+    // summed in the same order as Matrix4::operator *
+    for( unsigned int i = 0; i < n; ++i )
+      {
+	const T *a = m1[ i ].m, *b = m2[ i ].m;
+	T t[ 16 ];
+	for( unsigned int r = 0; r < 16; r += 4 )
+	  {
+	    const T a0 = a[ r ], a1 = a[ r + 1 ], a2 = a[ r + 2 ], a3 = a[ r + 3 ];
+	    t[ r ] = a0 * b[ 0 ] + a1 * b[ 4 ] + a2 * b[ 8 ] + a3 * b[ 12 ];
+	    t[ r + 1 ] = a0 * b[ 1 ] + a1 * b[ 5 ] + a2 * b[ 9 ] + a3 * b[ 13 ];
+	    t[ r + 2 ] = a0 * b[ 2 ] + a1 * b[ 6 ] + a2 * b[ 10 ] + a3 * b[ 14 ];
+	    t[ r + 3 ] = a0 * b[ 3 ] + a1 * b[ 7 ] + a2 * b[ 11 ] + a3 * b[ 15 ];
+	  }
+	// m may alias m1 or m2
+	std::copy( t, t + 16, m[ i ].m );
+      }
+  }
+
+  static MATH_DISPATCH_INLINE void transform( Vector3< T > *v, const Vector3< T > *v0, unsigned int n, const Matrix4< T > &m )
+  {
+    // gather into local soa blocks : the vectors carry a vptr, so only the middle loop is wide
+    T x[ BLOCK ], y[ BLOCK ], z[ BLOCK ];
+    for( unsigned int begin = 0; begin < n; begin += BLOCK )
+      {
+	unsigned int k = std::min< unsigned int >( BLOCK, n - begin );
+	for( unsigned int i = 0; i < k; ++i )
+	  {
+	    x[ i ] = v0[ begin + i ].x;
+	    y[ i ] = v0[ begin + i ].y;
+	    z[ i ] = v0[ begin + i ].z;
+	  }
+	transform( x, y, z, x, y, z, k, m );
+	for( unsigned int i = 0; i < k; ++i )
+	  {
+	    v[ begin + i ].x = x[ i ];
+	    v[ begin + i ].y = y[ i ];
+	    v[ begin + i ].z = z[ i ];
+	  }
+      }
+  }
+
+  static MATH_DISPATCH_INLINE void transform( T *ox, T *oy, T *oz, const T *x, const T *y, const T *z, unsigned int n, const Matrix4< T > &m )
+  {
+    const T m11 = m._11, m12 = m._12, m13 = m._13, m21 = m._21, m22 = m._22, m23 = m._23;
+    const T m31 = m._31, m32 = m._32, m33 = m._33, m41 = m._41, m42 = m._42, m43 = m._43;
+    T lx[ BLOCK ], ly[ BLOCK ], lz[ BLOCK ];
+    for( unsigned int begin = 0; begin < n; begin += BLOCK )
+      {
+	// local outputs keep the loop free of runtime alias checks
+	T tx[ BLOCK ], ty[ BLOCK ], tz[ BLOCK ];
+	unsigned int k = std::min< unsigned int >( BLOCK, n - begin );
+	const T *px = x + begin, *py = y + begin, *pz = z + begin;
+	if( k < BLOCK )
+	  {
+	    pad( lx, px, k );
+	    pad( ly, py, k );
+	    pad( lz, pz, k );
+	    px = lx;
+	    py = ly;
+	    pz = lz;
+	  }
+	for( unsigned int i = 0; i < BLOCK; ++i )
+	  {
+	    tx[ i ] = px[ i ] * m11 + py[ i ] * m21 + pz[ i ] * m31 + m41;
+	    ty[ i ] = px[ i ] * m12 + py[ i ] * m22 + pz[ i ] * m32 + m42;
+	    tz[ i ] = px[ i ] * m13 + py[ i ] * m23 + pz[ i ] * m33 + m43;
+	  }
+	std::copy( tx, tx + k, ox + begin );
+	std::copy( ty, ty + k, oy + begin );
+	std::copy( tz, tz + k, oz + begin );
+      }
+  }
+
+  template< typename Root >
+  static MATH_DISPATCH_INLINE void normalize( Vector3< T > *v, const Vector3< T > *v0, unsigned int n )
+  {
+    T x[ BLOCK ], y[ BLOCK ], z[ BLOCK ], l[ BLOCK ];
+    for( unsigned int begin = 0; begin < n; begin += BLOCK )
+      {
+	unsigned int k = std::min< unsigned int >( BLOCK, n - begin );
+	for( unsigned int i = 0; i < k; ++i )
+	  {
+	    x[ i ] = v0[ begin + i ].x;
+	    y[ i ] = v0[ begin + i ].y;
+	    z[ i ] = v0[ begin + i ].z;
+	  }
+	if( k < BLOCK )
+	  {
+	    std::fill( x + k, x + BLOCK, T() );
+	    std::fill( y + k, y + BLOCK, T() );
+	    std::fill( z + k, z + BLOCK, T() );
+	  }
+	for( unsigned int i = 0; i < BLOCK; ++i )
+	  {
+	    l[ i ] = x[ i ] * x[ i ] + y[ i ] * y[ i ] + z[ i ] * z[ i ];
+	  }
+	Root::run( l, BLOCK );
+	for( unsigned int i = 0; i < BLOCK; ++i )
+	  {
+	    // both sides of the select are safe to compute, so it stays branch free
+	    T f = ( l[ i ] > 0 ? 1 : 0 ) / ( l[ i ] > 0 ? l[ i ] : 1 );
+	    x[ i ] *= f;
+	    y[ i ] *= f;
+	    z[ i ] *= f;
+	  }
+	for( unsigned int i = 0; i < k; ++i )
+	  {
+	    v[ begin + i ].x = x[ i ];
+	    v[ begin + i ].y = y[ i ];
+	    v[ begin + i ].z = z[ i ];
+	  }
+      }
+  }
+
+  static MATH_DISPATCH_INLINE void scale( Color< T > *c, const Color< T > *c0, unsigned int n, T s )
+  {
+    T l[ BLOCK ];
+    for( unsigned int begin = 0; begin < n; begin += BLOCK / 4 )
+      {
+	unsigned int k = std::min< unsigned int >( BLOCK / 4, n - begin );
+	gather( l, c0 + begin, k );
+	for( unsigned int i = 0; i < BLOCK; ++i )
+	  {
+	    l[ i ] *= s;
+	  }
+	scatter( c + begin, l, k );
+      }
+  }
+
+  static MATH_DISPATCH_INLINE void modulate( Color< T > *c, const Color< T > *c1, const Color< T > *c2, unsigned int n )
+  {
+    T lp[ BLOCK ], lq[ BLOCK ];
+    for( unsigned int begin = 0; begin < n; begin += BLOCK / 4 )
+      {
+	unsigned int k = std::min< unsigned int >( BLOCK / 4, n - begin );
+	gather( lp, c1 + begin, k );
+	gather( lq, c2 + begin, k );
+	for( unsigned int i = 0; i < BLOCK; ++i )
+	  {
+	    lp[ i ] *= lq[ i ];
+	  }
+	scatter( c + begin, lp, k );
+      }
+  }
+
+private:
+  static MATH_DISPATCH_INLINE void pad( T *l, const T *p, unsigned int k )
+  {
+    std::copy( p, p + k, l );
+    std::fill( l + k, l + BLOCK, T() );
+  }
+
+  static MATH_DISPATCH_INLINE void gather( T *l, const Color< T > *c, unsigned int k )
+  {
+    // colors are separate objects, so their components are copied one color at a time
+    for( unsigned int i = 0; i < k; ++i )
+      {
+	std::copy( c[ i ].v, c[ i ].v + 4, l + i * 4 );
+      }
+    std::fill( l + k * 4, l + BLOCK, T() );
+  }
+
+  static MATH_DISPATCH_INLINE void scatter( Color< T > *c, const T *l, unsigned int k )
+  {
+    for( unsigned int i = 0; i < k; ++i )
+      {
+	std::copy( l + i * 4, l + i * 4 + 4, c[ i ].v );
+      }
+  }
+};
+
+#define MATH_DISPATCH_DEFINE( LEVEL, CPU, TARGET )			\
+  TARGET static void multiply##LEVEL( Matrix4< T > *m, const Matrix4< T > *m1, const Matrix4< T > *m2, unsigned int n ) \
+  { DispatchKernel< T >::multiply( m, m1, m2, n ); }			\
+  TARGET static void transformAffine##LEVEL( Vector3< T > *v, const Vector3< T > *v0, unsigned int n, const Matrix4< T > &m ) \
+  { DispatchKernel< T >::transform( v, v0, n, m ); }			\
+  TARGET static void transformAffineSoA##LEVEL( T *ox, T *oy, T *oz, const T *x, const T *y, const T *z, unsigned int n, const Matrix4< T > &m ) \
+  { DispatchKernel< T >::transform( ox, oy, oz, x, y, z, n, m ); }	\
+  TARGET static void normalize##LEVEL( Vector3< T > *v, const Vector3< T > *v0, unsigned int n ) \
+  { DispatchKernel< T >::template normalize< DispatchRoot< T, Cpu::CPU > >( v, v0, n ); } \
+  TARGET static void scale##LEVEL( Color< T > *c, const Color< T > *c0, unsigned int n, T s ) \
+  { DispatchKernel< T >::scale( c, c0, n, s ); }			\
+  TARGET static void modulate##LEVEL( Color< T > *c, const Color< T > *c1, const Color< T > *c2, unsigned int n ) \
+  { DispatchKernel< T >::modulate( c, c1, c2, n ); }
+
+//! batch kernels selected at run time by Cpu::level
+/*!
+  Each kernel is compiled for every level ( GCC / Clang on x86 ) and the
+  function table of the selected level is chosen on first use, so one
+  binary runs the widest path the machine supports. Results of the
+  avx2 / avx512 paths can differ from scalar in the last bit ( fma ).
+  Large arrays are split into chunks and run under OpenMP.
+*/
+template< typename T >
+struct Dispatch
+{
+  struct Table
+  {
+    void ( *multiply )( Matrix4< T > *m, const Matrix4< T > *m1, const Matrix4< T > *m2, unsigned int n );
+    void ( *transformAffine )( Vector3< T > *v, const Vector3< T > *v0, unsigned int n, const Matrix4< T > &m );
+    void ( *transformAffineSoA )( T *ox, T *oy, T *oz, const T *x, const T *y, const T *z, unsigned int n, const Matrix4< T > &m );
+    void ( *normalize )( Vector3< T > *v, const Vector3< T > *v0, unsigned int n );
+    void ( *scale )( Color< T > *c, const Color< T > *c0, unsigned int n, T s );
+    void ( *modulate )( Color< T > *c, const Color< T > *c1, const Color< T > *c2, unsigned int n );
+  };
+
+  // static function
+  /*!
+    @brief kernel table of level ( falls back to the highest compiled level below it )
+  */
+  static const Table &table( Cpu::Level level );
+  /*!
+    @brief kernel table of Cpu::level
+  */
+  static const Table &table();
+  /*!
+    @brief multiply matrices pairwise : m[ i ] = m1[ i ] * m2[ i ]
+  */
+  static void multiply( Matrix4< T > *m, const Matrix4< T > *m1, const Matrix4< T > *m2, unsigned int n );
+  /*!
+    @brief transform points by the affine part of m ( no divide by w, unlike Vector3::transform )
+  */
+  static void transformAffine( Vector3< T > *v, const Vector3< T > *v0, unsigned int n, const Matrix4< T > &m );
+  /*!
+    @brief transform points by the affine part of m ( no divide by w, unlike Vector3::transform )
+  */
+  static void transformAffine( Vector3SoA< T > &v, const Vector3SoA< T > &v0, unsigned int n, const Matrix4< T > &m );
+  /*!
+    @brief normalize vectors ( zero vectors stay zero )
+  */
+  static void normalize( Vector3< T > *v, const Vector3< T > *v0, unsigned int n );
+  /*!
+    @brief scale colors
+  */
+  static void scale( Color< T > *c, const Color< T > *c0, unsigned int n, T s );
+  /*!
+    @brief multiply colors component-wise
+  */
+  static void modulate( Color< T > *c, const Color< T > *c1, const Color< T > *c2, unsigned int n );
+
+private:
+  enum
+    {
+      CHUNK = 16384
+    };
+
+  MATH_DISPATCH_DEFINE( Scalar, SCALAR, )
+#if defined( MATH_DISPATCH_X86 )
+  MATH_DISPATCH_DEFINE( SSE42, SSE42, MATH_TARGET_SSE42 )
+  MATH_DISPATCH_DEFINE( AVX2, AVX2, MATH_TARGET_AVX2 )
+  MATH_DISPATCH_DEFINE( AVX512, AVX512, MATH_TARGET_AVX512 )
+#endif
+};
+
+#undef MATH_DISPATCH_DEFINE
+
+//
+template< typename T >
+const typename Dispatch< T >::Table &Dispatch< T >::table( Cpu::Level level )
+{
+  static const Table scalar = { multiplyScalar, transformAffineScalar, transformAffineSoAScalar, normalizeScalar, scaleScalar, modulateScalar };
+#if defined( MATH_DISPATCH_X86 )
+  static const Table sse42 = { multiplySSE42, transformAffineSSE42, transformAffineSoASSE42, normalizeSSE42, scaleSSE42, modulateSSE42 };
+  static const Table avx2 = { multiplyAVX2, transformAffineAVX2, transformAffineSoAAVX2, normalizeAVX2, scaleAVX2, modulateAVX2 };
+  static const Table avx512 = { multiplyAVX512, transformAffineAVX512, transformAffineSoAAVX512, normalizeAVX512, scaleAVX512, modulateAVX512 };
+  switch( level )
+    {
+    case Cpu::AVX512:
+      return avx512;
+    case Cpu::AVX2:
+      return avx2;
+    case Cpu::SSE42:
+      return sse42;
+    default:
+      break;
+    }
+#else
+  ( void )level;
+#endif
+  return scalar;
+}
+
+//
+template< typename T >
+inline const typename Dispatch< T >::Table &Dispatch< T >::table()
+{
+  static const Table &selected = table( Cpu::level() );
+  return selected;
+}
+
+//
+template< typename T >
+void Dispatch< T >::multiply( Matrix4< T > *m, const Matrix4< T > *m1, const Matrix4< T > *m2, unsigned int n )
+{
+  MATH_INSTRUMENT_SCOPE( Instrument::DISPATCH_MULTIPLY, n );
+  const Table &t = table();
+  int chunks = static_cast< int >( ( n + CHUNK - 1 ) / CHUNK );
+#ifdef _OPENMP
+#pragma omp parallel for if( chunks > 4 )
+#endif
+  for( int c = 0; c < chunks; ++c )
+    {
+      unsigned int begin = c * CHUNK;
+      t.multiply( m + begin, m1 + begin, m2 + begin, std::min< unsigned int >( CHUNK, n - begin ) );
+    }
+}
+
+//
+template< typename T >
+void Dispatch< T >::transformAffine( Vector3< T > *v, const Vector3< T > *v0, unsigned int n, const Matrix4< T > &m )
+{
+  MATH_INSTRUMENT_SCOPE( Instrument::DISPATCH_TRANSFORM, n );
+  const Table &t = table();
+  int chunks = static_cast< int >( ( n + CHUNK - 1 ) / CHUNK );
+#ifdef _OPENMP
+#pragma omp parallel for if( chunks > 4 )
+#endif
+  for( int c = 0; c < chunks; ++c )
+    {
+      unsigned int begin = c * CHUNK;
+      t.transformAffine( v + begin, v0 + begin, std::min< unsigned int >( CHUNK, n - begin ), m );
+    }
+}
+
+//
+template< typename T >
+void Dispatch< T >::transformAffine( Vector3SoA< T > &v, const Vector3SoA< T > &v0, unsigned int n, const Matrix4< T > &m )
+{
+  MATH_INSTRUMENT_SCOPE( Instrument::DISPATCH_TRANSFORM, n );
+  const Table &t = table();
+  int chunks = static_cast< int >( ( n + CHUNK - 1 ) / CHUNK );
+#ifdef _OPENMP
+#pragma omp parallel for if( chunks > 4 )
+#endif
+  for( int c = 0; c < chunks; ++c )
+    {
+      unsigned int begin = c * CHUNK;
+      t.transformAffineSoA( v.x + begin, v.y + begin, v.z + begin, v0.x + begin, v0.y + begin, v0.z + begin, std::min< unsigned int >( CHUNK, n - begin ), m );
+    }
+}
+
+//
+template< typename T >
+void Dispatch< T >::normalize( Vector3< T > *v, const Vector3< T > *v0, unsigned int n )
+{
+  MATH_INSTRUMENT_SCOPE( Instrument::DISPATCH_NORMALIZE, n );
+  const Table &t = table();
+  int chunks = static_cast< int >( ( n + CHUNK - 1 ) / CHUNK );
+#ifdef _OPENMP
+#pragma omp parallel for if( chunks > 4 )
+#endif
+  for( int c = 0; c < chunks; ++c )
+    {
+      unsigned int begin = c * CHUNK;
+      t.normalize( v + begin, v0 + begin, std::min< unsigned int >( CHUNK, n - begin ) );
+    }
+}
+
+//
+template< typename T >
+void Dispatch< T >::scale( Color< T > *c, const Color< T > *c0, unsigned int n, T s )
+{
+  const Table &t = table();
+  int chunks = static_cast< int >( ( n + CHUNK - 1 ) / CHUNK );
+#ifdef _OPENMP
+#pragma omp parallel for if( chunks > 4 )
+#endif
+  for( int k = 0; k < chunks; ++k )
+    {
+      unsigned int begin = k * CHUNK;
+      t.scale( c + begin, c0 + begin, std::min< unsigned int >( CHUNK, n - begin ), s );
+    }
+}
+
+//
+template< typename T >
+void Dispatch< T >::modulate( Color< T > *c, const Color< T > *c1, const Color< T > *c2, unsigned int n )
+{
+  const Table &t = table();
+  int chunks = static_cast< int >( ( n + CHUNK - 1 ) / CHUNK );
+#ifdef _OPENMP
+#pragma omp parallel for if( chunks > 4 )
+#endif
+  for( int k = 0; k < chunks; ++k )
+    {
+      unsigned int begin = k * CHUNK;
+      t.modulate( c + begin, c1 + begin, c2 + begin, std::min< unsigned int >( CHUNK, n - begin ) );
+    }
+}
+
+typedef Dispatch< float > DispatchF;
+typedef Dispatch< double > DispatchD;
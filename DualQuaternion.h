@@ -0,0 +1,418 @@
+#pragma once
+
+#include <cmath>
+#include "Vector3.h"
+#include "Quaternion.h"
+#include "Matrix4.h"
+
+//! Dual quaternion ( rigid transform : rotation real, translation in dual )
+/*!
+  Follows the Quaternion and Matrix4 convention : a * b applies a then b.
+*/
+template< typename T = double >
+struct DualQuaternion
+{
+  DualQuaternion< T >();
+  DualQuaternion< T >( const Quaternion< T > &real, const Quaternion< T > &dual );
+  DualQuaternion< T >( const DualQuaternion< T > &dq );
+
+  DualQuaternion< T > &operator =( const DualQuaternion< T > &dq );
+
+  DualQuaternion< T > operator +( const DualQuaternion< T > &dq ) const;
+  DualQuaternion< T > operator *( const DualQuaternion< T > &dq ) const;
+  DualQuaternion< T > operator *( T s ) const;
+
+  DualQuaternion< T > &operator +=( const DualQuaternion< T > &dq );
+  DualQuaternion< T > &operator *=( const DualQuaternion< T > &dq );
+  DualQuaternion< T > &operator *=( T s );
+
+  bool operator ==( const DualQuaternion< T > &dq ) const;
+  bool operator !=( const DualQuaternion< T > &dq ) const;
+
+  // static function
+  /*!
+    @brief create identity
+  */
+  static DualQuaternion< T > &identity( DualQuaternion< T > &dq );
+  /*!
+    @brief create from rotation and translation ( rotation first )
+  */
+  static DualQuaternion< T > &rotationTranslation( DualQuaternion< T > &dq, const Quaternion< T > &rot, const Vector3< T > &trans );
+  /*!
+    @brief get rotation and translation
+  */
+  static void toRotationTranslation( Quaternion< T > &rot, Vector3< T > &trans, const DualQuaternion< T > &dq );
+  /*!
+    @brief normalize dual quaternion
+  */
+  static DualQuaternion< T > &normalize( DualQuaternion< T > &dq, const DualQuaternion< T > &dq0 );
+  /*!
+    @brief calculate inverse ( unit dual quaternion )
+  */
+  static DualQuaternion< T > &inverse( DualQuaternion< T > &dq, const DualQuaternion< T > &dq0 );
+  /*!
+    @brief transform point
+  */
+  static Vector3< T > &transform( Vector3< T > &v, const Vector3< T > &v0, const DualQuaternion< T > &dq );
+  /*!
+    @brief transform points
+  */
+  static void transform( Vector3< T > *v, const Vector3< T > *v0, unsigned int n, const DualQuaternion< T > &dq );
+  /*!
+    @brief convert to matrix
+  */
+  static Matrix4< T > &toMatrix( Matrix4< T > &m, const DualQuaternion< T > &dq );
+  /*!
+    @brief convert from rigid matrix ( scaling is discarded )
+  */
+  static DualQuaternion< T > &fromMatrix( DualQuaternion< T > &dq, const Matrix4< T > &m );
+  /*!
+    @brief screw linear interpolation
+  */
+  static DualQuaternion< T > &sclerp( DualQuaternion< T > &dq, const DualQuaternion< T > &dq1, const DualQuaternion< T > &dq2, T t );
+  /*!
+    @brief blend dual quaternions by weights and normalize ( dual quaternion skinning )
+  */
+  static DualQuaternion< T > &blend( DualQuaternion< T > &dq, const DualQuaternion< T > *dqs, const T *weights, unsigned int n );
+  /*!
+    @brief blend per output element : out[ i ] = blend of influences [ i * k, i * k + k )
+  */
+  static void blend( DualQuaternion< T > *out, const DualQuaternion< T > *dqs, const unsigned int *indices, const T *weights, unsigned int n, unsigned int k );
+  /*!
+    @brief normalize dual quaternions
+  */
+  static void normalize( DualQuaternion< T > *dq, const DualQuaternion< T > *dq0, unsigned int n );
+
+  Quaternion< T > real, dual;
+};
+
+//
+template< typename T >
+inline DualQuaternion< T >::DualQuaternion() : real(), dual( 0, 0, 0, 0 )
+{
+}
+
+//
+template< typename T >
+inline DualQuaternion< T >::DualQuaternion( const Quaternion< T > &real, const Quaternion< T > &dual ) : real( real ), dual( dual )
+{
+}
+
+//
+template< typename T >
+inline DualQuaternion< T >::DualQuaternion( const DualQuaternion< T > &dq ) : real( dq.real ), dual( dq.dual )
+{
+}
+
+//
+template< typename T >
+inline DualQuaternion< T > &DualQuaternion< T >::operator =( const DualQuaternion< T > &dq )
+{
+  real = dq.real;
+  dual = dq.dual;
+  return *this;
+}
+
+//
+template< typename T >
+inline DualQuaternion< T > DualQuaternion< T >::operator +( const DualQuaternion< T > &dq ) const
+{
+  return DualQuaternion< T >( real + dq.real, dual + dq.dual );
+}
+
+//
+template< typename T >
+inline DualQuaternion< T > DualQuaternion< T >::operator *( const DualQuaternion< T > &dq ) const
+{
+  return DualQuaternion< T >( real * dq.real, real * dq.dual + dual * dq.real );
+}
+
+//
+template< typename T >
+inline DualQuaternion< T > DualQuaternion< T >::operator *( T s ) const
+{
+  return DualQuaternion< T >( real * s, dual * s );
+}
+
+//
+template< typename T >
+inline DualQuaternion< T > &DualQuaternion< T >::operator +=( const DualQuaternion< T > &dq )
+{
+  real += dq.real;
+  dual += dq.dual;
+  return *this;
+}
+
+//
+template< typename T >
+inline DualQuaternion< T > &DualQuaternion< T >::operator *=( const DualQuaternion< T > &dq )
+{
+  *this = *this * dq;
+  return *this;
+}
+
+//
+template< typename T >
+inline DualQuaternion< T > &DualQuaternion< T >::operator *=( T s )
+{
+  real *= s;
+  dual *= s;
+  return *this;
+}
+
+//
+template< typename T >
+inline bool DualQuaternion< T >::operator ==( const DualQuaternion< T > &dq ) const
+{
+  return ( real == dq.real && dual == dq.dual );
+}
+
+//
+template< typename T >
+inline bool DualQuaternion< T >::operator !=( const DualQuaternion< T > &dq ) const
+{
+  return !operator ==( dq );
+}
+
+//
+template< typename T >
+inline DualQuaternion< T > &DualQuaternion< T >::identity( DualQuaternion< T > &dq )
+{
+  Quaternion< T >::identity( dq.real );
+  dq.dual = Quaternion< T >( 0, 0, 0, 0 );
+  return dq;
+}
+
+//
+template< typename T >
+inline DualQuaternion< T > &DualQuaternion< T >::rotationTranslation( DualQuaternion< T > &dq, const Quaternion< T > &rot, const Vector3< T > &trans )
+{
+  dq.real = rot;
+  dq.dual = rot * Quaternion< T >( trans.x, trans.y, trans.z, 0 ) * static_cast< T >( 0.5 );
+  return dq;
+}
+
+//
+template< typename T >
+inline void DualQuaternion< T >::toRotationTranslation( Quaternion< T > &rot, Vector3< T > &trans, const DualQuaternion< T > &dq )
+{
+  Quaternion< T > c;
+  Quaternion< T >::conjugate( c, dq.real );
+  Quaternion< T > t = c * dq.dual;
+  rot = dq.real;
+  trans = Vector3< T >( t.x * 2, t.y * 2, t.z * 2 );
+}
+
+//
+template< typename T >
+DualQuaternion< T > &DualQuaternion< T >::normalize( DualQuaternion< T > &dq, const DualQuaternion< T > &dq0 )
+{
+  T l = Quaternion< T >::length( dq0.real );
+  if( l == 0 )
+    {
+      return identity( dq );
+    }
+
+  Quaternion< T > r = dq0.real / l;
+  Quaternion< T > d = dq0.dual / l;
+
+  // remove the part of dual that is not orthogonal to real
+  T c = r.x * d.x + r.y * d.y + r.z * d.z + r.w * d.w;
+  dq.real = r;
+  dq.dual = d - r * c;
+  return dq;
+}
+
+//
+template< typename T >
+inline DualQuaternion< T > &DualQuaternion< T >::inverse( DualQuaternion< T > &dq, const DualQuaternion< T > &dq0 )
+{
+  Quaternion< T >::conjugate( dq.real, dq0.real );
+  Quaternion< T >::conjugate( dq.dual, dq0.dual );
+  return dq;
+}
+
+//
+template< typename T >
+inline Vector3< T > &DualQuaternion< T >::transform( Vector3< T > &v, const Vector3< T > &v0, const DualQuaternion< T > &dq )
+{
+  // v' = v + 2 r x ( r x v + w v ) + t with t = 2 ( conj( real ) * dual )
+  const Quaternion< T > &r = dq.real;
+  const Quaternion< T > &d = dq.dual;
+  Vector3< T > a( r.x, r.y, r.z );
+  Vector3< T > t( 2 * ( r.w * d.x - d.w * r.x + r.y * d.z - r.z * d.y ),
+		  2 * ( r.w * d.y - d.w * r.y + r.z * d.x - r.x * d.z ),
+		  2 * ( r.w * d.z - d.w * r.z + r.x * d.y - r.y * d.x ) );
+  Vector3< T > c1, c2;
+  Vector3< T >::cross( c1, a, v0 );
+  c1 += v0 * r.w;
+  Vector3< T >::cross( c2, a, c1 );
+  v = v0 + c2 * 2 + t;
+  return v;
+}
+
+//
+template< typename T >
+void DualQuaternion< T >::transform( Vector3< T > *v, const Vector3< T > *v0, unsigned int n, const DualQuaternion< T > &dq )
+{
+  // same as a rigid matrix : 9 multiply-adds per point
+  Matrix4< T > m;
+  toMatrix( m, dq );
+#ifdef _OPENMP
+#pragma omp parallel for if( n > 65536 )
+#endif
+  for( int i = 0; i < static_cast< int >( n ); ++i )
+    {
+      T x = v0[ i ].x, y = v0[ i ].y, z = v0[ i ].z;
+      v[ i ].x = x * m._11 + y * m._21 + z * m._31 + m._41;
+      v[ i ].y = x * m._12 + y * m._22 + z * m._32 + m._42;
+      v[ i ].z = x * m._13 + y * m._23 + z * m._33 + m._43;
+    }
+}
+
+//
+template< typename T >
+Matrix4< T > &DualQuaternion< T >::toMatrix( Matrix4< T > &m, const DualQuaternion< T > &dq )
+{
+  Quaternion< T > r;
+  Vector3< T > t;
+  toRotationTranslation( r, t, dq );
+  Quaternion< T >::toMatrix( m, r );
+  m._41 = t.x;
+  m._42 = t.y;
+  m._43 = t.z;
+  return m;
+}
+
+//
+template< typename T >
+DualQuaternion< T > &DualQuaternion< T >::fromMatrix( DualQuaternion< T > &dq, const Matrix4< T > &m )
+{
+  Vector3< T > s, t;
+  Quaternion< T > r;
+  Matrix4< T >::decompose( s, r, t, m );
+  return rotationTranslation( dq, r, t );
+}
+
+//
+template< typename T >
+DualQuaternion< T > &DualQuaternion< T >::sclerp( DualQuaternion< T > &dq, const DualQuaternion< T > &dq1, const DualQuaternion< T > &dq2, T t )
+{
+  // shortest path
+  DualQuaternion< T > b = dq2;
+  if( dq1.real.x * b.real.x + dq1.real.y * b.real.y + dq1.real.z * b.real.z + dq1.real.w * b.real.w < 0 )
+    {
+      b *= -1;
+    }
+
+  // relative transform raised to the power t through its screw parameters
+  DualQuaternion< T > ia, d;
+  inverse( ia, dq1 );
+  d = ia * b;
+
+  double w = static_cast< double >( d.real.w );
+  w = w > 1 ? 1 : ( w < -1 ? -1 : w );
+  double s = sqrt( 1 - w * w );
+  DualQuaternion< T > p;
+  if( s < 1e-6 )
+    {
+      // pure translation
+      p.real = Quaternion< T >();
+      p.dual = d.dual * t;
+    }
+  else
+    {
+      double angle = 2 * acos( w );
+      double lx = d.real.x / s, ly = d.real.y / s, lz = d.real.z / s;
+      double dist = -2 * d.dual.w / s;
+      double mx = ( d.dual.x - lx * dist / 2 * w ) / s;
+      double my = ( d.dual.y - ly * dist / 2 * w ) / s;
+      double mz = ( d.dual.z - lz * dist / 2 * w ) / s;
+
+      angle *= t;
+      dist *= t;
+      double sh = sin( angle / 2 ), ch = cos( angle / 2 );
+      p.real = Quaternion< T >( static_cast< T >( lx * sh ), static_cast< T >( ly * sh ), static_cast< T >( lz * sh ), static_cast< T >( ch ) );
+      p.dual = Quaternion< T >( static_cast< T >( sh * mx + dist / 2 * ch * lx ),
+				static_cast< T >( sh * my + dist / 2 * ch * ly ),
+				static_cast< T >( sh * mz + dist / 2 * ch * lz ),
+				static_cast< T >( -dist / 2 * sh ) );
+    }
+
+  dq = dq1 * p;
+  return dq;
+}
+
+//
+template< typename T >
+DualQuaternion< T > &DualQuaternion< T >::blend( DualQuaternion< T > &dq, const DualQuaternion< T > *dqs, const T *weights, unsigned int n )
+{
+  if( n == 0 )
+    {
+      return identity( dq );
+    }
+
+  DualQuaternion< T > s( Quaternion< T >( 0, 0, 0, 0 ), Quaternion< T >( 0, 0, 0, 0 ) );
+  const Quaternion< T > &p = dqs[ 0 ].real;
+  for( unsigned int i = 0; i < n; ++i )
+    {
+      // antipodality : blend in the hemisphere of the first one
+      T w = weights[ i ];
+      const Quaternion< T > &r = dqs[ i ].real;
+      if( p.x * r.x + p.y * r.y + p.z * r.z + p.w * r.w < 0 )
+	{
+	  w = -w;
+	}
+      s += dqs[ i ] * w;
+    }
+  return normalize( dq, s );
+}
+
+//
+template< typename T >
+void DualQuaternion< T >::blend( DualQuaternion< T > *out, const DualQuaternion< T > *dqs, const unsigned int *indices, const T *weights, unsigned int n, unsigned int k )
+{
+#ifdef _OPENMP
+#pragma omp parallel for if( n > 4096 )
+#endif
+  for( int i = 0; i < static_cast< int >( n ); ++i )
+    {
+      DualQuaternion< T > s( Quaternion< T >( 0, 0, 0, 0 ), Quaternion< T >( 0, 0, 0, 0 ) );
+      const unsigned int *idx = &indices[ i * k ];
+      const T *wt = &weights[ i * k ];
+      const Quaternion< T > &p = dqs[ idx[ 0 ] ].real;
+      for( unsigned int j = 0; j < k; ++j )
+	{
+	  const DualQuaternion< T > &d = dqs[ idx[ j ] ];
+	  T w = ( p.x * d.real.x + p.y * d.real.y + p.z * d.real.z + p.w * d.real.w < 0 ) ? -wt[ j ] : wt[ j ];
+	  s += d * w;
+	}
+      normalize( out[ i ], s );
+    }
+}
+
+//
+template< typename T >
+void DualQuaternion< T >::normalize( DualQuaternion< T > *dq, const DualQuaternion< T > *dq0, unsigned int n )
+{
+#ifdef _OPENMP
+#pragma omp parallel for if( n > 65536 )
+#endif
+  for( int i = 0; i < static_cast< int >( n ); ++i )
+    {
+      normalize( dq[ i ], dq0[ i ] );
+    }
+}
+
+/*!
+  output stream
+*/
+template< typename T >
+std::ostream &operator<<( std::ostream &os, const DualQuaternion< T > &dq )
+{
+  os << dq.real << ", " << dq.dual;
+  return os;
+}
+
+typedef DualQuaternion< float > DualQuaternionF;
+typedef DualQuaternion< double > DualQuaternionD;
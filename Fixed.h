@@ -0,0 +1,675 @@
+#pragma once
+
+#include <cmath>
+#include <iostream>
+
+//! unsigned 128-bit integer used by 64-bit fixed point arithmetic
+struct FixedU128
+{
+  unsigned long long hi, lo;
+
+  // static function
+  /*!
+    @brief calculate full product of 64-bit integers
+  */
+  static FixedU128 mul( unsigned long long a, unsigned long long b );
+  /*!
+    @brief shift right ( 0 < s < 64 )
+  */
+  static FixedU128 shr( const FixedU128 &a, int s );
+  /*!
+    @brief compare ( a <= b )
+  */
+  static bool lessEqual( const FixedU128 &a, const FixedU128 &b );
+  /*!
+    @brief calculate quotient of 128-bit integer by 64-bit integer ( truncated to 64 bits )
+  */
+  static unsigned long long div( const FixedU128 &a, unsigned long long d );
+};
+
+//
+inline FixedU128 FixedU128::mul( unsigned long long a, unsigned long long b )
+{
+  const unsigned long long M = 0xffffffffULL;
+  unsigned long long a0 = a & M, a1 = a >> 32;
+  unsigned long long b0 = b & M, b1 = b >> 32;
+  unsigned long long p00 = a0 * b0, p01 = a0 * b1, p10 = a1 * b0, p11 = a1 * b1;
+  unsigned long long mid = ( p00 >> 32 ) + ( p01 & M ) + ( p10 & M );
+
+  FixedU128 r;
+  r.lo = ( mid << 32 ) | ( p00 & M );
+  r.hi = p11 + ( p01 >> 32 ) + ( p10 >> 32 ) + ( mid >> 32 );
+  return r;
+}
+
+//
+inline FixedU128 FixedU128::shr( const FixedU128 &a, int s )
+{
+  FixedU128 r;
+  r.lo = ( a.lo >> s ) | ( a.hi << ( 64 - s ) );
+  r.hi = a.hi >> s;
+  return r;
+}
+
+//
+inline bool FixedU128::lessEqual( const FixedU128 &a, const FixedU128 &b )
+{
+  return ( a.hi < b.hi || ( a.hi == b.hi && a.lo <= b.lo ) );
+}
+
+//
+inline unsigned long long FixedU128::div( const FixedU128 &a, unsigned long long d )
+{
+  // restoring division, one quotient bit per step
+  unsigned long long q = 0, r = 0;
+  for( int i = 127; i >= 0; --i )
+    {
+      unsigned long long bit = ( i >= 64 ) ? ( a.hi >> ( i - 64 ) ) & 1 : ( a.lo >> i ) & 1;
+      bool carry = ( r >> 63 ) != 0;
+      r = ( r << 1 ) | bit;
+      q <<= 1;
+      if( carry || r >= d )
+	{
+	  r -= d;
+	  q |= 1;
+	}
+    }
+  return q;
+}
+
+//! wide arithmetic of fixed point types
+template< typename I >
+struct FixedTraits;
+
+//! Q*.F fixed point on 32-bit integer
+template<>
+struct FixedTraits< int >
+{
+  static int mul( int a, int b, int f );
+  static int div( int a, int b, int f );
+  static int sqrt( int a, int f );
+};
+
+//
+inline int FixedTraits< int >::mul( int a, int b, int f )
+{
+  // rounded half away from zero so that results do not depend on the sign
+  long long p = static_cast< long long >( a ) * b;
+  long long h = 1LL << ( f - 1 );
+  return static_cast< int >( p >= 0 ? ( p + h ) >> f : -( ( -p + h ) >> f ) );
+}
+
+//
+inline int FixedTraits< int >::div( int a, int b, int f )
+{
+  if( b == 0 )
+    {
+      return a >= 0 ? 0x7fffffff : -0x7fffffff - 1;
+    }
+  return static_cast< int >( static_cast< long long >( a ) * ( 1LL << f ) / b );
+}
+
+//
+inline int FixedTraits< int >::sqrt( int a, int f )
+{
+  if( a <= 0 )
+    {
+      return 0;
+    }
+
+  unsigned long long v = static_cast< unsigned long long >( a ) << f;
+  unsigned long long r = 0;
+  unsigned long long bit = 1ULL << 62;
+  while( bit > v )
+    {
+      bit >>= 2;
+    }
+  while( bit != 0 )
+    {
+      if( v >= r + bit )
+	{
+	  v -= r + bit;
+	  r = ( r >> 1 ) + bit;
+	}
+      else
+	{
+	  r >>= 1;
+	}
+      bit >>= 2;
+    }
+  return static_cast< int >( r );
+}
+
+//! Q*.F fixed point on 64-bit integer
+template<>
+struct FixedTraits< long long >
+{
+  static long long mul( long long a, long long b, int f );
+  static long long div( long long a, long long b, int f );
+  static long long sqrt( long long a, int f );
+};
+
+//
+inline long long FixedTraits< long long >::mul( long long a, long long b, int f )
+{
+  bool neg = ( a < 0 ) != ( b < 0 );
+  unsigned long long ua = a < 0 ? 0 - static_cast< unsigned long long >( a ) : a;
+  unsigned long long ub = b < 0 ? 0 - static_cast< unsigned long long >( b ) : b;
+
+  FixedU128 p = FixedU128::mul( ua, ub );
+  unsigned long long h = 1ULL << ( f - 1 );
+  p.lo += h;
+  p.hi += ( p.lo < h );
+  unsigned long long r = FixedU128::shr( p, f ).lo;
+  return neg ? -static_cast< long long >( r ) : static_cast< long long >( r );
+}
+
+//
+inline long long FixedTraits< long long >::div( long long a, long long b, int f )
+{
+  if( b == 0 )
+    {
+      return a >= 0 ? 0x7fffffffffffffffLL : -0x7fffffffffffffffLL - 1;
+    }
+
+  bool neg = ( a < 0 ) != ( b < 0 );
+  unsigned long long ua = a < 0 ? 0 - static_cast< unsigned long long >( a ) : a;
+  unsigned long long ub = b < 0 ? 0 - static_cast< unsigned long long >( b ) : b;
+
+  FixedU128 n;
+  n.hi = ua >> ( 64 - f );
+  n.lo = ua << f;
+  unsigned long long r = FixedU128::div( n, ub );
+  return neg ? -static_cast< long long >( r ) : static_cast< long long >( r );
+}
+
+//
+inline long long FixedTraits< long long >::sqrt( long long a, int f )
+{
+  if( a <= 0 )
+    {
+      return 0;
+    }
+
+  FixedU128 v;
+  v.hi = static_cast< unsigned long long >( a ) >> ( 64 - f );
+  v.lo = static_cast< unsigned long long >( a ) << f;
+
+  // result bits from the top : keep r * r <= v
+  unsigned long long r = 0;
+  for( int i = 63; i >= 0; --i )
+    {
+      unsigned long long t = r | ( 1ULL << i );
+      if( FixedU128::lessEqual( FixedU128::mul( t, t ), v ) )
+	{
+	  r = t;
+	}
+    }
+  return static_cast< long long >( r );
+}
+
+//! enabled for built-in arithmetic types mixed with Fixed
+template< typename S, typename R > struct FixedEnable {};
+template< typename R > struct FixedEnable< int, R > { typedef R type; };
+template< typename R > struct FixedEnable< unsigned int, R > { typedef R type; };
+template< typename R > struct FixedEnable< long, R > { typedef R type; };
+template< typename R > struct FixedEnable< unsigned long, R > { typedef R type; };
+template< typename R > struct FixedEnable< long long, R > { typedef R type; };
+template< typename R > struct FixedEnable< float, R > { typedef R type; };
+template< typename R > struct FixedEnable< double, R > { typedef R type; };
+
+//! deterministic fixed point scalar
+/*!
+  I is the underlying integer ( int or long long ) and F the number of
+  fractional bits. All arithmetic, sqrt, sin and cos are integer only,
+  so results are bit exact on every machine. Fixed converts implicitly
+  to and from double so that it works as T of every math template;
+  builders that call the double math library ( e.g. Matrix4::rotationX )
+  are only as deterministic as that library.
+  Using Fixed as T requires C++11, since the vector and matrix unions
+  then hold members with constructors.
+*/
+template< typename I = int, int F = 16 >
+struct Fixed
+{
+  Fixed();
+  Fixed( const Fixed &f );
+  Fixed( int i );
+  Fixed( unsigned int i );
+  Fixed( long i );
+  Fixed( unsigned long i );
+  Fixed( long long i );
+  Fixed( float d );
+  Fixed( double d );
+
+  operator double () const;
+
+  Fixed operator + () const;
+  Fixed operator - () const;
+
+  Fixed operator + ( const Fixed &f ) const;
+  Fixed operator - ( const Fixed &f ) const;
+  Fixed operator * ( const Fixed &f ) const;
+  Fixed operator / ( const Fixed &f ) const;
+
+  Fixed &operator += ( const Fixed &f );
+  Fixed &operator -= ( const Fixed &f );
+  Fixed &operator *= ( const Fixed &f );
+  Fixed &operator /= ( const Fixed &f );
+
+  bool operator == ( const Fixed &f ) const;
+  bool operator != ( const Fixed &f ) const;
+  bool operator < ( const Fixed &f ) const;
+  bool operator > ( const Fixed &f ) const;
+  bool operator <= ( const Fixed &f ) const;
+  bool operator >= ( const Fixed &f ) const;
+
+  // static function
+  /*!
+    @brief create from raw integer representation
+  */
+  static Fixed fromRaw( I raw );
+  /*!
+    @brief calculate reciprocal
+  */
+  static Fixed reciprocal( const Fixed &f );
+  /*!
+    @brief calculate square root
+  */
+  static Fixed sqrt( const Fixed &f );
+  /*!
+    @brief calculate sine
+  */
+  static Fixed sin( const Fixed &rad );
+  /*!
+    @brief calculate cosine
+  */
+  static Fixed cos( const Fixed &rad );
+  /*!
+    @brief calculate pi
+  */
+  static Fixed pi();
+
+  static const I ONE = static_cast< I >( 1 ) << F;
+
+  I raw;
+};
+
+//
+template< typename I, int F >
+inline Fixed< I, F >::Fixed() : raw( 0 )
+{
+}
+
+//
+template< typename I, int F >
+inline Fixed< I, F >::Fixed( const Fixed &f ) : raw( f.raw )
+{
+}
+
+//
+template< typename I, int F >
+inline Fixed< I, F >::Fixed( int i ) : raw( static_cast< I >( i ) * ONE )
+{
+}
+
+//
+template< typename I, int F >
+inline Fixed< I, F >::Fixed( unsigned int i ) : raw( static_cast< I >( i ) * ONE )
+{
+}
+
+//
+template< typename I, int F >
+inline Fixed< I, F >::Fixed( long i ) : raw( static_cast< I >( i ) * ONE )
+{
+}
+
+//
+template< typename I, int F >
+inline Fixed< I, F >::Fixed( unsigned long i ) : raw( static_cast< I >( i ) * ONE )
+{
+}
+
+//
+template< typename I, int F >
+inline Fixed< I, F >::Fixed( long long i ) : raw( static_cast< I >( i ) * ONE )
+{
+}
+
+//
+template< typename I, int F >
+inline Fixed< I, F >::Fixed( float d ) : raw( static_cast< I >( floor( static_cast< double >( d ) * ONE + 0.5 ) ) )
+{
+}
+
+//
+template< typename I, int F >
+inline Fixed< I, F >::Fixed( double d ) : raw( static_cast< I >( floor( d * ONE + 0.5 ) ) )
+{
+}
+
+//
+template< typename I, int F >
+inline Fixed< I, F >::operator double () const
+{
+  return static_cast< double >( raw ) / ONE;
+}
+
+//
+template< typename I, int F >
+inline Fixed< I, F > Fixed< I, F >::fromRaw( I raw )
+{
+  Fixed f;
+  f.raw = raw;
+  return f;
+}
+
+//
+template< typename I, int F >
+inline Fixed< I, F > Fixed< I, F >::operator + () const
+{
+  return *this;
+}
+
+//
+template< typename I, int F >
+inline Fixed< I, F > Fixed< I, F >::operator - () const
+{
+  return fromRaw( -raw );
+}
+
+//
+template< typename I, int F >
+inline Fixed< I, F > Fixed< I, F >::operator + ( const Fixed &f ) const
+{
+  return fromRaw( raw + f.raw );
+}
+
+//
+template< typename I, int F >
+inline Fixed< I, F > Fixed< I, F >::operator - ( const Fixed &f ) const
+{
+  return fromRaw( raw - f.raw );
+}
+
+//
+template< typename I, int F >
+inline Fixed< I, F > Fixed< I, F >::operator * ( const Fixed &f ) const
+{
+  return fromRaw( FixedTraits< I >::mul( raw, f.raw, F ) );
+}
+
+//
+template< typename I, int F >
+inline Fixed< I, F > Fixed< I, F >::operator / ( const Fixed &f ) const
+{
+  return fromRaw( FixedTraits< I >::div( raw, f.raw, F ) );
+}
+
+//
+template< typename I, int F >
+inline Fixed< I, F > &Fixed< I, F >::operator += ( const Fixed &f )
+{
+  raw += f.raw;
+  return *this;
+}
+
+//
+template< typename I, int F >
+inline Fixed< I, F > &Fixed< I, F >::operator -= ( const Fixed &f )
+{
+  raw -= f.raw;
+  return *this;
+}
+
+//
+template< typename I, int F >
+inline Fixed< I, F > &Fixed< I, F >::operator *= ( const Fixed &f )
+{
+  raw = FixedTraits< I >::mul( raw, f.raw, F );
+  return *this;
+}
+
+//
+template< typename I, int F >
+inline Fixed< I, F > &Fixed< I, F >::operator /= ( const Fixed &f )
+{
+  raw = FixedTraits< I >::div( raw, f.raw, F );
+  return *this;
+}
+
+//
+template< typename I, int F >
+inline bool Fixed< I, F >::operator == ( const Fixed &f ) const
+{
+  return raw == f.raw;
+}
+
+//
+template< typename I, int F >
+inline bool Fixed< I, F >::operator != ( const Fixed &f ) const
+{
+  return raw != f.raw;
+}
+
+//
+template< typename I, int F >
+inline bool Fixed< I, F >::operator < ( const Fixed &f ) const
+{
+  return raw < f.raw;
+}
+
+//
+template< typename I, int F >
+inline bool Fixed< I, F >::operator > ( const Fixed &f ) const
+{
+  return raw > f.raw;
+}
+
+//
+template< typename I, int F >
+inline bool Fixed< I, F >::operator <= ( const Fixed &f ) const
+{
+  return raw <= f.raw;
+}
+
+//
+template< typename I, int F >
+inline bool Fixed< I, F >::operator >= ( const Fixed &f ) const
+{
+  return raw >= f.raw;
+}
+
+//
+template< typename I, int F >
+inline Fixed< I, F > Fixed< I, F >::reciprocal( const Fixed &f )
+{
+  return Fixed( 1 ) / f;
+}
+
+//
+template< typename I, int F >
+inline Fixed< I, F > Fixed< I, F >::sqrt( const Fixed &f )
+{
+  return fromRaw( FixedTraits< I >::sqrt( f.raw, F ) );
+}
+
+//
+template< typename I, int F >
+inline Fixed< I, F > Fixed< I, F >::pi()
+{
+  // exact rounding of pi in double is the same on every IEEE machine
+  return Fixed( 3.1415926535897932384626433832795 );
+}
+
+//
+template< typename I, int F >
+Fixed< I, F > Fixed< I, F >::sin( const Fixed &rad )
+{
+  const Fixed p = pi();
+  const Fixed p2 = p + p;
+  const Fixed h = fromRaw( p.raw / 2 );
+
+  // reduce to [ -pi, pi ] then to [ -pi / 2, pi / 2 ]
+  Fixed x = fromRaw( rad.raw % p2.raw );
+  if( x > p ) x -= p2;
+  if( x < -p ) x += p2;
+  if( x > h ) x = p - x;
+  if( x < -h ) x = -p - x;
+
+  // Taylor series up to x^17 ( truncation error below 2^-40 on the reduced range )
+  Fixed x2 = x * x;
+  Fixed s = 1;
+  const int d[] = { 272, 210, 156, 110, 72, 42, 20, 6 };
+  for( int i = 0; i < 8; ++i )
+    {
+      s = Fixed( 1 ) - x2 * s / Fixed( d[ i ] );
+    }
+  return x * s;
+}
+
+//
+template< typename I, int F >
+inline Fixed< I, F > Fixed< I, F >::cos( const Fixed &rad )
+{
+  return sin( rad + fromRaw( pi().raw / 2 ) );
+}
+
+//
+template< typename S, typename I, int F >
+inline typename FixedEnable< S, Fixed< I, F > >::type operator + ( S s, const Fixed< I, F > &f )
+{
+  return Fixed< I, F >( s ) + f;
+}
+
+//
+template< typename S, typename I, int F >
+inline typename FixedEnable< S, Fixed< I, F > >::type operator + ( const Fixed< I, F > &f, S s )
+{
+  return f + Fixed< I, F >( s );
+}
+
+//
+template< typename S, typename I, int F >
+inline typename FixedEnable< S, Fixed< I, F > >::type operator - ( S s, const Fixed< I, F > &f )
+{
+  return Fixed< I, F >( s ) - f;
+}
+
+//
+template< typename S, typename I, int F >
+inline typename FixedEnable< S, Fixed< I, F > >::type operator - ( const Fixed< I, F > &f, S s )
+{
+  return f - Fixed< I, F >( s );
+}
+
+//
+template< typename S, typename I, int F >
+inline typename FixedEnable< S, Fixed< I, F > >::type operator * ( S s, const Fixed< I, F > &f )
+{
+  return Fixed< I, F >( s ) * f;
+}
+
+//
+template< typename S, typename I, int F >
+inline typename FixedEnable< S, Fixed< I, F > >::type operator * ( const Fixed< I, F > &f, S s )
+{
+  return f * Fixed< I, F >( s );
+}
+
+//
+template< typename S, typename I, int F >
+inline typename FixedEnable< S, Fixed< I, F > >::type operator / ( S s, const Fixed< I, F > &f )
+{
+  return Fixed< I, F >( s ) / f;
+}
+
+//
+template< typename S, typename I, int F >
+inline typename FixedEnable< S, Fixed< I, F > >::type operator / ( const Fixed< I, F > &f, S s )
+{
+  return f / Fixed< I, F >( s );
+}
+
+//
+template< typename S, typename I, int F >
+inline typename FixedEnable< S, bool >::type operator == ( const Fixed< I, F > &f, S s )
+{
+  return f == Fixed< I, F >( s );
+}
+
+//
+template< typename S, typename I, int F >
+inline typename FixedEnable< S, bool >::type operator != ( const Fixed< I, F > &f, S s )
+{
+  return f != Fixed< I, F >( s );
+}
+
+//
+template< typename S, typename I, int F >
+inline typename FixedEnable< S, bool >::type operator < ( const Fixed< I, F > &f, S s )
+{
+  return f < Fixed< I, F >( s );
+}
+
+//
+template< typename S, typename I, int F >
+inline typename FixedEnable< S, bool >::type operator > ( const Fixed< I, F > &f, S s )
+{
+  return f > Fixed< I, F >( s );
+}
+
+//
+template< typename S, typename I, int F >
+inline typename FixedEnable< S, bool >::type operator <= ( const Fixed< I, F > &f, S s )
+{
+  return f <= Fixed< I, F >( s );
+}
+
+//
+template< typename S, typename I, int F >
+inline typename FixedEnable< S, bool >::type operator >= ( const Fixed< I, F > &f, S s )
+{
+  return f >= Fixed< I, F >( s );
+}
+
+/*!
+  @brief square root ( found by the math templates through argument dependent lookup )
+*/
+template< typename I, int F >
+inline Fixed< I, F > sqrt( const Fixed< I, F > &f )
+{
+  return Fixed< I, F >::sqrt( f );
+}
+
+/*!
+  @brief sine
+*/
+template< typename I, int F >
+inline Fixed< I, F > sin( const Fixed< I, F > &f )
+{
+  return Fixed< I, F >::sin( f );
+}
+
+/*!
+  @brief cosine
+*/
+template< typename I, int F >
+inline Fixed< I, F > cos( const Fixed< I, F > &f )
+{
+  return Fixed< I, F >::cos( f );
+}
+
+/*!
+  output stream
+*/
+template< typename I, int F >
+std::ostream &operator<<( std::ostream &os, const Fixed< I, F > &f )
+{
+  os << static_cast< double >( f );
+  return os;
+}
+
+typedef Fixed< int, 16 > Fixed16;
+typedef Fixed< long long, 32 > Fixed32;
@@ -0,0 +1,460 @@
+#pragma once
+
+#include <cstring>
+#include <iostream>
+#include "Dispatch.h"
+
+#if !defined( MATH_DISPATCH_X86 ) && ( defined( __F16C__ ) || defined( __AVX512F__ ) )
+#include <immintrin.h>
+#endif
+
+//! IEEE 754 half precision (fp16) storage scalar
+/*!
+  Converts implicitly to and from float, so arithmetic is done in float
+  and only storage is 16 bits. Using Half as T of the vector, matrix and
+  color templates requires C++11 ( members with constructors in unions ).
+  Arrays of Vector2 / Vector4 / Quaternion / Color of Half are contiguous
+  Half scalars and can be converted in bulk through toFloat / fromFloat.
+  The bulk conversions pick F16C / AVX-512 at run time from Cpu::level
+  ( GCC / Clang on x86 ), elsewhere only when enabled at compile time.
+*/
+struct Half
+{
+  Half();
+  Half( float f );
+
+  operator float () const;
+
+  Half &operator += ( float f );
+  Half &operator -= ( float f );
+  Half &operator *= ( float f );
+  Half &operator /= ( float f );
+
+  // static function
+  /*!
+    @brief create from raw bits
+  */
+  static Half fromBits( unsigned short bits );
+  /*!
+    @brief convert float to half bits (round to nearest even)
+  */
+  static unsigned short fromFloat( float f );
+  /*!
+    @brief convert half bits to float
+  */
+  static float toFloat( unsigned short h );
+  /*!
+    @brief convert array of half to float (F16C / AVX-512 when available)
+  */
+  static void toFloat( float *out, const Half *in, unsigned int n );
+  /*!
+    @brief convert array of float to half (F16C / AVX-512 when available)
+  */
+  static void fromFloat( Half *out, const float *in, unsigned int n );
+
+  unsigned short bits;
+
+private:
+#if defined( MATH_DISPATCH_X86 )
+  static bool f16c();
+  __attribute__(( target( "avx512f" ) )) static unsigned int toFloatAVX512( float *out, const Half *in, unsigned int n );
+  __attribute__(( target( "avx,f16c" ) )) static unsigned int toFloatF16C( float *out, const Half *in, unsigned int n, unsigned int i );
+  __attribute__(( target( "avx512f" ) )) static unsigned int fromFloatAVX512( Half *out, const float *in, unsigned int n );
+  __attribute__(( target( "avx,f16c" ) )) static unsigned int fromFloatF16C( Half *out, const float *in, unsigned int n, unsigned int i );
+#endif
+};
+
+//! bfloat16 storage scalar ( upper 16 bits of float )
+/*!
+  Same usage as Half. Conversion is a shift, so the portable loops
+  vectorize without special instructions.
+*/
+struct BFloat16
+{
+  BFloat16();
+  BFloat16( float f );
+
+  operator float () const;
+
+  BFloat16 &operator += ( float f );
+  BFloat16 &operator -= ( float f );
+  BFloat16 &operator *= ( float f );
+  BFloat16 &operator /= ( float f );
+
+  // static function
+  /*!
+    @brief create from raw bits
+  */
+  static BFloat16 fromBits( unsigned short bits );
+  /*!
+    @brief convert float to bfloat16 bits (round to nearest even)
+  */
+  static unsigned short fromFloat( float f );
+  /*!
+    @brief convert bfloat16 bits to float
+  */
+  static float toFloat( unsigned short h );
+  /*!
+    @brief convert array of bfloat16 to float
+  */
+  static void toFloat( float *out, const BFloat16 *in, unsigned int n );
+  /*!
+    @brief convert array of float to bfloat16
+  */
+  static void fromFloat( BFloat16 *out, const float *in, unsigned int n );
+
+  unsigned short bits;
+};
+
+//
+inline Half::Half() : bits( 0 )
+{
+}
+
+//
+inline Half::Half( float f ) : bits( fromFloat( f ) )
+{
+}
+
+//
+inline Half::operator float () const
+{
+  return toFloat( bits );
+}
+
+//
+inline Half &Half::operator += ( float f )
+{
+  bits = fromFloat( toFloat( bits ) + f );
+  return *this;
+}
+
+//
+inline Half &Half::operator -= ( float f )
+{
+  bits = fromFloat( toFloat( bits ) - f );
+  return *this;
+}
+
+//
+inline Half &Half::operator *= ( float f )
+{
+  bits = fromFloat( toFloat( bits ) * f );
+  return *this;
+}
+
+//
+inline Half &Half::operator /= ( float f )
+{
+  bits = fromFloat( toFloat( bits ) / f );
+  return *this;
+}
+
+//
+inline Half Half::fromBits( unsigned short bits )
+{
+  Half h;
+  h.bits = bits;
+  return h;
+}
+
+//
+inline unsigned short Half::fromFloat( float f )
+{
+  unsigned int u;
+  memcpy( &u, &f, 4 );
+  unsigned int sign = ( u >> 16 ) & 0x8000;
+  u &= 0x7fffffff;
+
+  unsigned short o;
+  if( u >= 0x47800000 )
+    {
+      // overflow to infinity, NaN stays NaN
+      o = ( u > 0x7f800000 ) ? 0x7e00 : 0x7c00;
+    }
+  else if( u < 0x38800000 )
+    {
+      // subnormal : let the float adder do the rounding
+      const unsigned int magic = 126 << 23;
+      float m, a;
+      memcpy( &m, &magic, 4 );
+      memcpy( &a, &u, 4 );
+      a += m;
+      memcpy( &u, &a, 4 );
+      o = static_cast< unsigned short >( u - magic );
+    }
+  else
+    {
+      unsigned int odd = ( u >> 13 ) & 1;
+      u += ( static_cast< unsigned int >( 15 - 127 ) << 23 ) + 0xfff + odd;
+      o = static_cast< unsigned short >( u >> 13 );
+    }
+  return static_cast< unsigned short >( o | sign );
+}
+
+//
+inline float Half::toFloat( unsigned short h )
+{
+  const unsigned int shifted = 0x7c00 << 13;
+  unsigned int u = ( h & 0x7fff ) << 13;
+  unsigned int e = shifted & u;
+  u += ( 127 - 15 ) << 23;
+
+  float f;
+  if( e == shifted )
+    {
+      // infinity or NaN
+      u += ( 128 - 16 ) << 23;
+      memcpy( &f, &u, 4 );
+    }
+  else if( e == 0 )
+    {
+      // zero or subnormal
+      const unsigned int magic = 113 << 23;
+      float m;
+      memcpy( &m, &magic, 4 );
+      u += 1 << 23;
+      memcpy( &f, &u, 4 );
+      f -= m;
+    }
+  else
+    {
+      memcpy( &f, &u, 4 );
+    }
+
+  unsigned int s = ( h & 0x8000 ) << 16;
+  memcpy( &u, &f, 4 );
+  u |= s;
+  memcpy( &f, &u, 4 );
+  return f;
+}
+
+//
+inline void Half::toFloat( float *out, const Half *in, unsigned int n )
+{
+  unsigned int i = 0;
+#if defined( MATH_DISPATCH_X86 )
+  if( Cpu::level() >= Cpu::AVX512 )
+    {
+      i = toFloatAVX512( out, in, n );
+    }
+  if( Cpu::level() >= Cpu::AVX2 && f16c() )
+    {
+      i = toFloatF16C( out, in, n, i );
+    }
+#else
+#ifdef __AVX512F__
+  for( ; i + 16 <= n; i += 16 )
+    {
+      _mm512_storeu_ps( out + i, _mm512_cvtph_ps( _mm256_loadu_si256( reinterpret_cast< const __m256i * >( in + i ) ) ) );
+    }
+#endif
+#ifdef __F16C__
+  for( ; i + 8 <= n; i += 8 )
+    {
+      _mm256_storeu_ps( out + i, _mm256_cvtph_ps( _mm_loadu_si128( reinterpret_cast< const __m128i * >( in + i ) ) ) );
+    }
+#endif
+#endif
+  for( ; i < n; ++i )
+    {
+      out[ i ] = toFloat( in[ i ].bits );
+    }
+}
+
+//
+inline void Half::fromFloat( Half *out, const float *in, unsigned int n )
+{
+  unsigned int i = 0;
+#if defined( MATH_DISPATCH_X86 )
+  if( Cpu::level() >= Cpu::AVX512 )
+    {
+      i = fromFloatAVX512( out, in, n );
+    }
+  if( Cpu::level() >= Cpu::AVX2 && f16c() )
+    {
+      i = fromFloatF16C( out, in, n, i );
+    }
+#else
+#ifdef __AVX512F__
+  for( ; i + 16 <= n; i += 16 )
+    {
+      _mm256_storeu_si256( reinterpret_cast< __m256i * >( out + i ), _mm512_cvtps_ph( _mm512_loadu_ps( in + i ), _MM_FROUND_TO_NEAREST_INT ) );
+    }
+#endif
+#ifdef __F16C__
+  for( ; i + 8 <= n; i += 8 )
+    {
+      _mm_storeu_si128( reinterpret_cast< __m128i * >( out + i ), _mm256_cvtps_ph( _mm256_loadu_ps( in + i ), _MM_FROUND_TO_NEAREST_INT ) );
+    }
+#endif
+#endif
+  for( ; i < n; ++i )
+    {
+      out[ i ].bits = fromFloat( in[ i ] );
+    }
+}
+
+#if defined( MATH_DISPATCH_X86 )
+//
+inline bool Half::f16c()
+{
+  // every avx2 cpu has f16c, but the level only promises avx2 and fma
+  static const bool supported = ( __builtin_cpu_init(), __builtin_cpu_supports( "f16c" ) != 0 );
+  return supported;
+}
+
+//
+inline unsigned int Half::toFloatAVX512( float *out, const Half *in, unsigned int n )
+{
+  unsigned int i = 0;
+  // the full mask forms, the plain ones trip -Wmaybe-uninitialized on GCC 12
+  for( ; i + 16 <= n; i += 16 )
+    {
+      _mm512_storeu_ps( out + i, _mm512_maskz_cvtph_ps( 0xffff, _mm256_loadu_si256( reinterpret_cast< const __m256i * >( in + i ) ) ) );
+    }
+  return i;
+}
+
+//
+inline unsigned int Half::toFloatF16C( float *out, const Half *in, unsigned int n, unsigned int i )
+{
+  for( ; i + 8 <= n; i += 8 )
+    {
+      _mm256_storeu_ps( out + i, _mm256_cvtph_ps( _mm_loadu_si128( reinterpret_cast< const __m128i * >( in + i ) ) ) );
+    }
+  return i;
+}
+
+//
+inline unsigned int Half::fromFloatAVX512( Half *out, const float *in, unsigned int n )
+{
+  unsigned int i = 0;
+  for( ; i + 16 <= n; i += 16 )
+    {
+      _mm256_storeu_si256( reinterpret_cast< __m256i * >( out + i ), _mm512_maskz_cvtps_ph( 0xffff, _mm512_loadu_ps( in + i ), _MM_FROUND_TO_NEAREST_INT ) );
+    }
+  return i;
+}
+
+//
+inline unsigned int Half::fromFloatF16C( Half *out, const float *in, unsigned int n, unsigned int i )
+{
+  for( ; i + 8 <= n; i += 8 )
+    {
+      _mm_storeu_si128( reinterpret_cast< __m128i * >( out + i ), _mm256_cvtps_ph( _mm256_loadu_ps( in + i ), _MM_FROUND_TO_NEAREST_INT ) );
+    }
+  return i;
+}
+#endif
+
+//
+inline BFloat16::BFloat16() : bits( 0 )
+{
+}
+
+//
+inline BFloat16::BFloat16( float f ) : bits( fromFloat( f ) )
+{
+}
+
+//
+inline BFloat16::operator float () const
+{
+  return toFloat( bits );
+}
+
+//
+inline BFloat16 &BFloat16::operator += ( float f )
+{
+  bits = fromFloat( toFloat( bits ) + f );
+  return *this;
+}
+
+//
+inline BFloat16 &BFloat16::operator -= ( float f )
+{
+  bits = fromFloat( toFloat( bits ) - f );
+  return *this;
+}
+
+//
+inline BFloat16 &BFloat16::operator *= ( float f )
+{
+  bits = fromFloat( toFloat( bits ) * f );
+  return *this;
+}
+
+//
+inline BFloat16 &BFloat16::operator /= ( float f )
+{
+  bits = fromFloat( toFloat( bits ) / f );
+  return *this;
+}
+
+//
+inline BFloat16 BFloat16::fromBits( unsigned short bits )
+{
+  BFloat16 h;
+  h.bits = bits;
+  return h;
+}
+
+//
+inline unsigned short BFloat16::fromFloat( float f )
+{
+  unsigned int u;
+  memcpy( &u, &f, 4 );
+  if( ( u & 0x7fffffff ) > 0x7f800000 )
+    {
+      // quiet NaN, keep sign
+      return static_cast< unsigned short >( ( u >> 16 ) | 0x40 );
+    }
+  u += 0x7fff + ( ( u >> 16 ) & 1 );
+  return static_cast< unsigned short >( u >> 16 );
+}
+
+//
+inline float BFloat16::toFloat( unsigned short h )
+{
+  unsigned int u = static_cast< unsigned int >( h ) << 16;
+  float f;
+  memcpy( &f, &u, 4 );
+  return f;
+}
+
+//
+inline void BFloat16::toFloat( float *out, const BFloat16 *in, unsigned int n )
+{
+  for( unsigned int i = 0; i < n; ++i )
+    {
+      out[ i ] = toFloat( in[ i ].bits );
+    }
+}
+
+//
+inline void BFloat16::fromFloat( BFloat16 *out, const float *in, unsigned int n )
+{
+  for( unsigned int i = 0; i < n; ++i )
+    {
+      out[ i ].bits = fromFloat( in[ i ] );
+    }
+}
+
+/*!
+  output stream
+*/
+inline std::ostream &operator<<( std::ostream &os, const Half &h )
+{
+  os << static_cast< float >( h );
+  return os;
+}
+
+/*!
+  output stream
+*/
+inline std::ostream &operator<<( std::ostream &os, const BFloat16 &h )
+{
+  os << static_cast< float >( h );
+  return os;
+}
@@ -0,0 +1,747 @@
+#pragma once
+
+#include <cmath>
+#include <ctime>
+#include <limits>
+#include <algorithm>
+#include <string>
+#include <vector>
+#include <iostream>
+#include <iomanip>
+#if __cplusplus >= 201103L
+#include <chrono>
+#endif
+#include "Vector3.h"
+#include "Matrix4.h"
+#include "Quaternion.h"
+#include "Precise.h"
+#include "TaggedMatrix4.h"
+#include "Affine3.h"
+#include "Dispatch.h"
+#include "Half.h"
+
+//! accuracy and throughput comparison of kernel backends
+/*!
+  Runs the float kernels ( normalize, inverse, slerp, rotation builders,
+  intersectTri, color scale / modulate, half / bfloat16 conversion ) of every backend in the tree
+  over random and adversarial inputs ( extreme magnitudes, near-singular
+  matrices, near-parallel quaternions, large angles, degenerate
+  triangles, rounding ties ) and measures the error in ulp against a
+  long double reference together with elements per second.
+  Components of unit results ( normalized vectors, quaternions, rotation
+  matrices ) and of inverse matrices are measured in ulp of the largest
+  reference component instead of their own, so cancellation near zero
+  does not dominate. mismatch counts results whose class differs from
+  the reference ( hit / miss, finite / non-finite ).
+
+    std::vector< Harness::Result > r;
+    Harness::run( r );
+    Harness::print( std::cout, r );
+*/
+struct Harness
+{
+  struct Result
+  {
+    std::string kernel;
+    std::string backend;
+    double maxUlp;
+    double meanUlp;
+    unsigned int count;
+    unsigned int mismatch;
+    double rate;
+  };
+
+  // static function
+  /*!
+    @brief run all kernels of all backends
+    @param n number of inputs per kernel
+  */
+  static void run( std::vector< Result > &results, unsigned int n = 1 << 18, unsigned int seed = 1 );
+  /*!
+    @brief print results as one table
+  */
+  static void print( std::ostream &os, const std::vector< Result > &results );
+  /*!
+    @brief unit in the last place of ref for a format with digits bits of significand
+  */
+  static long double ulp( long double ref, int digits );
+  /*!
+    @brief wall clock in seconds
+  */
+  static double seconds();
+
+private:
+  struct Error
+  {
+    Error();
+    void add( long double value, long double ref, int digits, long double scale = 0 );
+    void miss();
+    Result result( const char *kernel, const std::string &backend, double time, unsigned int elements ) const;
+
+    double max, sum;
+    unsigned int count, mismatch;
+  };
+
+  static float random( unsigned int &state );
+  static Quaternion< float > randomQuaternion( unsigned int &state );
+  static bool inverse( long double *r, const long double *m );
+  static void rotation( long double *m, long double x, long double y, long double z, long double w );
+  static void product( long double *r, const long double *a, const long double *b );
+
+  static void normalize( std::vector< Result > &results, unsigned int n, unsigned int seed );
+  static void inverse( std::vector< Result > &results, unsigned int n, unsigned int seed );
+  static void slerp( std::vector< Result > &results, unsigned int n, unsigned int seed );
+  static void rotation( std::vector< Result > &results, unsigned int n, unsigned int seed );
+  static void intersectTri( std::vector< Result > &results, unsigned int n, unsigned int seed );
+  static void color( std::vector< Result > &results, unsigned int n, unsigned int seed );
+  static void convert( std::vector< Result > &results, unsigned int n, unsigned int seed );
+};
+
+//
+inline Harness::Error::Error() : max( 0 ), sum( 0 ), count( 0 ), mismatch( 0 )
+{
+}
+
+//
+inline void Harness::Error::add( long double value, long double ref, int digits, long double scale )
+{
+  bool fv = value == value && std::fabs( value ) <= std::numeric_limits< long double >::max();
+  bool fr = ref == ref && std::fabs( ref ) <= std::numeric_limits< long double >::max();
+  if( fv != fr )
+    {
+      ++mismatch;
+      return;
+    }
+  if( !fr )
+    {
+      return;
+    }
+  // components of unit results are measured against ulp( scale ), so cancellation near zero does not dominate
+  long double r = std::fabs( ref ) > scale ? ref : scale;
+  double e = static_cast< double >( std::fabs( value - ref ) / ulp( r, digits ) );
+  max = e > max ? e : max;
+  sum += e;
+  ++count;
+}
+
+//
+inline void Harness::Error::miss()
+{
+  ++mismatch;
+}
+
+//
+inline Harness::Result Harness::Error::result( const char *kernel, const std::string &backend, double time, unsigned int elements ) const
+{
+  Result r;
+  r.kernel = kernel;
+  r.backend = backend;
+  r.maxUlp = max;
+  r.meanUlp = count ? sum / count : 0;
+  r.count = count;
+  r.mismatch = mismatch;
+  r.rate = time > 0 ? elements / time : 0;
+  return r;
+}
+
+//
+inline long double Harness::ulp( long double ref, int digits )
+{
+  // ulp of the smallest normal float below it, so tiny references do not blow up the ratio
+  const long double tiny = std::numeric_limits< float >::min();
+  long double a = std::fabs( ref ) > tiny ? std::fabs( ref ) : tiny;
+  int e;
+  std::frexp( a, &e );
+  return std::ldexp( static_cast< long double >( 1 ), e - digits );
+}
+
+//
+inline double Harness::seconds()
+{
+#if __cplusplus >= 201103L
+  return std::chrono::duration< double >( std::chrono::steady_clock::now().time_since_epoch() ).count();
+#else
+  return static_cast< double >( clock() ) / CLOCKS_PER_SEC;
+#endif
+}
+
+//
+inline float Harness::random( unsigned int &state )
+{
+  state = state * 1664525u + 1013904223u;
+  return static_cast< float >( state >> 8 ) / 8388608.0f - 1;
+}
+
+//
+inline Quaternion< float > Harness::randomQuaternion( unsigned int &state )
+{
+  Quaternion< float > q( random( state ), random( state ), random( state ), random( state ) );
+  Quaternion< float >::normalize( q, q );
+  return q;
+}
+
+//
+inline bool Harness::inverse( long double *r, const long double *m )
+{
+  // Gauss-Jordan with partial pivoting
+  long double a[ 16 ];
+  for( int i = 0; i < 16; ++i )
+    {
+      a[ i ] = m[ i ];
+      r[ i ] = ( i % 5 ) == 0 ? 1 : 0;
+    }
+  for( int c = 0; c < 4; ++c )
+    {
+      int p = c;
+      for( int i = c + 1; i < 4; ++i )
+	{
+	  if( std::fabs( a[ i * 4 + c ] ) > std::fabs( a[ p * 4 + c ] ) )
+	    p = i;
+	}
+      if( a[ p * 4 + c ] == 0 )
+	{
+	  return false;
+	}
+      for( int j = 0; j < 4; ++j )
+	{
+	  std::swap( a[ c * 4 + j ], a[ p * 4 + j ] );
+	  std::swap( r[ c * 4 + j ], r[ p * 4 + j ] );
+	}
+      long double f = 1 / a[ c * 4 + c ];
+      for( int j = 0; j < 4; ++j )
+	{
+	  a[ c * 4 + j ] *= f;
+	  r[ c * 4 + j ] *= f;
+	}
+      for( int i = 0; i < 4; ++i )
+	{
+	  if( i == c )
+	    continue;
+	  long double g = a[ i * 4 + c ];
+	  for( int j = 0; j < 4; ++j )
+	    {
+	      a[ i * 4 + j ] -= g * a[ c * 4 + j ];
+	      r[ i * 4 + j ] -= g * r[ c * 4 + j ];
+	    }
+	}
+    }
+  return true;
+}
+
+//
+inline void Harness::rotation( long double *m, long double x, long double y, long double z, long double w )
+{
+  // same layout as Quaternion::toMatrix
+  for( int i = 0; i < 16; ++i )
+    {
+      m[ i ] = 0;
+    }
+  m[ 0 ] = 1 - 2 * ( y * y + z * z );
+  m[ 1 ] = 2 * ( x * y + z * w );
+  m[ 2 ] = 2 * ( z * x - w * y );
+  m[ 4 ] = 2 * ( x * y - z * w );
+  m[ 5 ] = 1 - 2 * ( z * z + x * x );
+  m[ 6 ] = 2 * ( y * z + w * x );
+  m[ 8 ] = 2 * ( z * x + w * y );
+  m[ 9 ] = 2 * ( y * z - x * w );
+  m[ 10 ] = 1 - 2 * ( y * y + x * x );
+  m[ 15 ] = 1;
+}
+
+//
+inline void Harness::product( long double *r, const long double *a, const long double *b )
+{
+  long double t[ 16 ];
+  for( int i = 0; i < 4; ++i )
+    {
+      for( int j = 0; j < 4; ++j )
+	{
+	  t[ i * 4 + j ] = a[ i * 4 ] * b[ j ] + a[ i * 4 + 1 ] * b[ 4 + j ] + a[ i * 4 + 2 ] * b[ 8 + j ] + a[ i * 4 + 3 ] * b[ 12 + j ];
+	}
+    }
+  for( int i = 0; i < 16; ++i )
+    {
+      r[ i ] = t[ i ];
+    }
+}
+
+//
+inline void Harness::normalize( std::vector< Result > &results, unsigned int n, unsigned int seed )
+{
+  // magnitudes from 1e-20 to 1e20 : squares underflow and overflow in float
+  std::vector< Vector3< float > > v( n ), o( n );
+  for( unsigned int i = 0; i < n; ++i )
+    {
+      float s = static_cast< float >( pow( 10.0, static_cast< double >( random( seed ) ) * 20 ) );
+      v[ i ] = Vector3< float >( random( seed ) * s, random( seed ) * s, random( seed ) * s );
+    }
+
+  std::vector< std::string > names;
+  names.push_back( "Vector3" );
+  names.push_back( "Precise" );
+  for( int l = Cpu::SCALAR; l <= Cpu::detect(); ++l )
+    {
+      names.push_back( std::string( "dispatch-" ) + Cpu::name( static_cast< Cpu::Level >( l ) ) );
+    }
+
+  for( unsigned int b = 0; b < names.size(); ++b )
+    {
+      double t0 = seconds();
+      if( b == 0 )
+	{
+	  for( unsigned int i = 0; i < n; ++i )
+	    Vector3< float >::normalize( o[ i ], v[ i ] );
+	}
+      else if( b == 1 )
+	{
+	  for( unsigned int i = 0; i < n; ++i )
+	    Precise< float >::normalize( o[ i ], v[ i ] );
+	}
+      else
+	{
+	  Dispatch< float >::table( static_cast< Cpu::Level >( b - 2 ) ).normalize( n ? &o[ 0 ] : 0, n ? &v[ 0 ] : 0, n );
+	}
+      double t = seconds() - t0;
+
+      Error e;
+      for( unsigned int i = 0; i < n; ++i )
+	{
+	  long double x = v[ i ].x, y = v[ i ].y, z = v[ i ].z;
+	  long double l = std::sqrt( x * x + y * y + z * z );
+	  if( l == 0 )
+	    continue;
+	  e.add( o[ i ].x, x / l, 24, 1 );
+	  e.add( o[ i ].y, y / l, 24, 1 );
+	  e.add( o[ i ].z, z / l, 24, 1 );
+	}
+      results.push_back( e.result( "normalize", names[ b ], t, n ) );
+    }
+}
+
+//
+inline void Harness::inverse( std::vector< Result > &results, unsigned int n, unsigned int seed )
+{
+  // affine matrices, every other one nearly singular ( third row close to a combination of the first two )
+  std::vector< Matrix4< float > > m( n ), o( n );
+  for( unsigned int i = 0; i < n; ++i )
+    {
+      Matrix4< float > &a = m[ i ];
+      for( int k = 0; k < 12; ++k )
+	{
+	  a.m[ k ] = random( seed ) * 4;
+	}
+      if( i & 1 )
+	{
+	  float s = random( seed ), r = random( seed ), eps = 1e-4f;
+	  a._31 = s * a._11 + r * a._21 + eps * random( seed );
+	  a._32 = s * a._12 + r * a._22 + eps * random( seed );
+	  a._33 = s * a._13 + r * a._23 + eps * random( seed );
+	}
+      a._14 = a._24 = a._34 = 0;
+      a._44 = 1;
+      a._41 = random( seed ) * 100;
+      a._42 = random( seed ) * 100;
+      a._43 = random( seed ) * 100;
+    }
+
+  const char *names[] = { "Matrix4", "Precise", "TaggedMatrix4", "Affine3" };
+  for( int b = 0; b < 4; ++b )
+    {
+      double t0 = seconds();
+      for( unsigned int i = 0; i < n; ++i )
+	{
+	  switch( b )
+	    {
+	    case 0:
+	      Matrix4< float >::inverse( o[ i ], m[ i ] );
+	      break;
+	    case 1:
+	      Precise< float >::inverse( o[ i ], m[ i ] );
+	      break;
+	    case 2:
+	      {
+		TaggedMatrix4< float > r;
+		TaggedMatrix4< float >::inverse( r, TaggedMatrix4< float >( m[ i ], TaggedMatrix4< float >::AFFINE ) );
+		o[ i ] = r.m;
+	      }
+	      break;
+	    case 3:
+	      {
+		Affine3< float > a, r;
+		Affine3< float >::fromMatrix( a, m[ i ] );
+		Affine3< float >::inverse( r, a );
+		Affine3< float >::toMatrix( o[ i ], r );
+	      }
+	      break;
+	    }
+	}
+      double t = seconds() - t0;
+
+      Error e;
+      for( unsigned int i = 0; i < n; ++i )
+	{
+	  long double a[ 16 ], r[ 16 ];
+	  for( int k = 0; k < 16; ++k )
+	    {
+	      a[ k ] = m[ i ].m[ k ];
+	    }
+	  if( !inverse( r, a ) )
+	    continue;
+	  long double s = 0;
+	  for( int k = 0; k < 16; ++k )
+	    {
+	      s = std::max( s, std::fabs( r[ k ] ) );
+	    }
+	  for( int k = 0; k < 16; ++k )
+	    {
+	      e.add( o[ i ].m[ k ], r[ k ], 24, s );
+	    }
+	}
+      results.push_back( e.result( "inverse", names[ b ], t, n ) );
+    }
+}
+
+//
+inline void Harness::slerp( std::vector< Result > &results, unsigned int n, unsigned int seed )
+{
+  // a third each : random pairs, nearly equal pairs, nearly opposite pairs
+  std::vector< Quaternion< float > > q1( n ), q2( n ), o( n );
+  std::vector< float > t( n );
+  for( unsigned int i = 0; i < n; ++i )
+    {
+      q1[ i ] = randomQuaternion( seed );
+      Quaternion< float > d( random( seed ) * 1e-4f, random( seed ) * 1e-4f, random( seed ) * 1e-4f, 0 );
+      switch( i % 3 )
+	{
+	case 0:
+	  q2[ i ] = randomQuaternion( seed );
+	  break;
+	case 1:
+	  Quaternion< float >::normalize( q2[ i ], q1[ i ] + d );
+	  break;
+	case 2:
+	  Quaternion< float >::normalize( q2[ i ], -q1[ i ] + d );
+	  break;
+	}
+      t[ i ] = ( random( seed ) + 1 ) / 2;
+    }
+
+  double t0 = seconds();
+  for( unsigned int i = 0; i < n; ++i )
+    {
+      Quaternion< float >::slerp( o[ i ], q1[ i ], q2[ i ], t[ i ] );
+    }
+  double time = seconds() - t0;
+
+  Error e;
+  for( unsigned int i = 0; i < n; ++i )
+    {
+      const Quaternion< float > &a = q1[ i ], &b = q2[ i ];
+      long double c = static_cast< long double >( a.x ) * b.x + static_cast< long double >( a.y ) * b.y + static_cast< long double >( a.z ) * b.z + static_cast< long double >( a.w ) * b.w;
+      c = c > 1 ? 1 : ( c < -1 ? -1 : c );
+      long double th = std::acos( c ), s = std::sin( th );
+      long double k1 = 1 - t[ i ], k2 = t[ i ];
+      if( s > 1e-12L )
+	{
+	  k1 = std::sin( ( 1 - t[ i ] ) * th ) / s;
+	  k2 = std::sin( t[ i ] * th ) / s;
+	}
+      else if( c < 0 )
+	{
+	  // opposite : no unique path, skip
+	  continue;
+	}
+      e.add( o[ i ].x, k1 * a.x + k2 * b.x, 24, 1 );
+      e.add( o[ i ].y, k1 * a.y + k2 * b.y, 24, 1 );
+      e.add( o[ i ].z, k1 * a.z + k2 * b.z, 24, 1 );
+      e.add( o[ i ].w, k1 * a.w + k2 * b.w, 24, 1 );
+    }
+  results.push_back( e.result( "slerp", "Quaternion", time, n ) );
+}
+
+//
+inline void Harness::rotation( std::vector< Result > &results, unsigned int n, unsigned int seed )
+{
+  // half the angles in [ -pi, pi ], half up to 1e4 rad ( argument reduction )
+  std::vector< Vector3< float > > axis( n );
+  std::vector< float > a( n ), b( n ), c( n );
+  std::vector< Matrix4< float > > o( n );
+  for( unsigned int i = 0; i < n; ++i )
+    {
+      float s = ( i & 1 ) ? 1e4f : 3.14159265f;
+      axis[ i ] = Vector3< float >( random( seed ), random( seed ), random( seed ) );
+      Vector3< float >::normalize( axis[ i ], axis[ i ] );
+      a[ i ] = random( seed ) * s;
+      b[ i ] = random( seed ) * s;
+      c[ i ] = random( seed ) * s;
+    }
+
+  for( int k = 0; k < 2; ++k )
+    {
+      double t0 = seconds();
+      for( unsigned int i = 0; i < n; ++i )
+	{
+	  if( k == 0 )
+	    Matrix4< float >::rotationAxis( o[ i ], axis[ i ], a[ i ] );
+	  else
+	    Matrix4< float >::rotationYawPitchRoll( o[ i ], a[ i ], b[ i ], c[ i ] );
+	}
+      double t = seconds() - t0;
+
+      Error e;
+      for( unsigned int i = 0; i < n; ++i )
+	{
+	  long double r[ 16 ];
+	  if( k == 0 )
+	    {
+	      long double x = axis[ i ].x, y = axis[ i ].y, z = axis[ i ].z;
+	      long double l = std::sqrt( x * x + y * y + z * z );
+	      if( l == 0 )
+		continue;
+	      long double h = static_cast< long double >( a[ i ] ) / 2, s = std::sin( h ) / l;
+	      rotation( r, x * s, y * s, z * s, std::cos( h ) );
+	    }
+	  else
+	    {
+	      // roll * pitch * yaw as rotationYawPitchRoll
+	      long double rz[ 16 ], rx[ 16 ], ry[ 16 ];
+	      long double hy = static_cast< long double >( a[ i ] ) / 2, hp = static_cast< long double >( b[ i ] ) / 2, hr = static_cast< long double >( c[ i ] ) / 2;
+	      rotation( rz, 0, 0, std::sin( hr ), std::cos( hr ) );
+	      rotation( rx, std::sin( hp ), 0, 0, std::cos( hp ) );
+	      rotation( ry, 0, std::sin( hy ), 0, std::cos( hy ) );
+	      product( r, rz, rx );
+	      product( r, r, ry );
+	    }
+	  for( int j = 0; j < 16; ++j )
+	    {
+	      e.add( o[ i ].m[ j ], r[ j ], 24, 1 );
+	    }
+	}
+      results.push_back( e.result( "rotation", k == 0 ? "rotationAxis" : "rotationYawPitchRoll", t, n ) );
+    }
+}
+
+//
+inline void Harness::intersectTri( std::vector< Result > &results, unsigned int n, unsigned int seed )
+{
+  // rays aimed inside the triangle, a quarter of the triangles nearly degenerate
+  std::vector< Vector3< float > > v( n * 3 ), org( n ), dir( n );
+  std::vector< float > dist( n );
+  std::vector< unsigned char > hit( n );
+  for( unsigned int i = 0; i < n; ++i )
+    {
+      Vector3< float > a( random( seed ), random( seed ), random( seed ) );
+      Vector3< float > b( random( seed ), random( seed ), random( seed ) );
+      Vector3< float > c( random( seed ), random( seed ), random( seed ) );
+      if( ( i & 3 ) == 0 )
+	{
+	  float s = ( random( seed ) + 1 ) / 2;
+	  c = a + ( b - a ) * s + Vector3< float >( random( seed ), random( seed ), random( seed ) ) * 1e-5f;
+	}
+      v[ i * 3 ] = a;
+      v[ i * 3 + 1 ] = b;
+      v[ i * 3 + 2 ] = c;
+      float u = ( random( seed ) + 1 ) / 2, w = ( random( seed ) + 1 ) / 2;
+      if( u + w > 1 )
+	{
+	  u = 1 - u;
+	  w = 1 - w;
+	}
+      Vector3< float > p = a + ( b - a ) * u + ( c - a ) * w;
+      org[ i ] = Vector3< float >( random( seed ), random( seed ), random( seed ) ) * 4;
+      dir[ i ] = p - org[ i ];
+    }
+
+  double t0 = seconds();
+  for( unsigned int i = 0; i < n; ++i )
+    {
+      float d = 0;
+      hit[ i ] = Vector3< float >::intersectTri( v[ i * 3 ], v[ i * 3 + 1 ], v[ i * 3 + 2 ], org[ i ], dir[ i ], 0, 0, &d );
+      dist[ i ] = d;
+    }
+  double time = seconds() - t0;
+
+  Error e;
+  for( unsigned int i = 0; i < n; ++i )
+    {
+      // Moller-Trumbore in long double
+      long double p[ 3 ][ 3 ], o[ 3 ], d[ 3 ];
+      for( int k = 0; k < 3; ++k )
+	{
+	  p[ k ][ 0 ] = v[ i * 3 + k ].x;
+	  p[ k ][ 1 ] = v[ i * 3 + k ].y;
+	  p[ k ][ 2 ] = v[ i * 3 + k ].z;
+	}
+      o[ 0 ] = org[ i ].x; o[ 1 ] = org[ i ].y; o[ 2 ] = org[ i ].z;
+      d[ 0 ] = dir[ i ].x; d[ 1 ] = dir[ i ].y; d[ 2 ] = dir[ i ].z;
+      long double e1[ 3 ], e2[ 3 ], s[ 3 ], h[ 3 ], q[ 3 ];
+      for( int k = 0; k < 3; ++k )
+	{
+	  e1[ k ] = p[ 1 ][ k ] - p[ 0 ][ k ];
+	  e2[ k ] = p[ 2 ][ k ] - p[ 0 ][ k ];
+	  s[ k ] = o[ k ] - p[ 0 ][ k ];
+	}
+      h[ 0 ] = d[ 1 ] * e2[ 2 ] - d[ 2 ] * e2[ 1 ];
+      h[ 1 ] = d[ 2 ] * e2[ 0 ] - d[ 0 ] * e2[ 2 ];
+      h[ 2 ] = d[ 0 ] * e2[ 1 ] - d[ 1 ] * e2[ 0 ];
+      q[ 0 ] = s[ 1 ] * e1[ 2 ] - s[ 2 ] * e1[ 1 ];
+      q[ 1 ] = s[ 2 ] * e1[ 0 ] - s[ 0 ] * e1[ 2 ];
+      q[ 2 ] = s[ 0 ] * e1[ 1 ] - s[ 1 ] * e1[ 0 ];
+      long double det = e1[ 0 ] * h[ 0 ] + e1[ 1 ] * h[ 1 ] + e1[ 2 ] * h[ 2 ];
+      if( det == 0 )
+	continue;
+      long double bu = ( s[ 0 ] * h[ 0 ] + s[ 1 ] * h[ 1 ] + s[ 2 ] * h[ 2 ] ) / det;
+      long double bv = ( d[ 0 ] * q[ 0 ] + d[ 1 ] * q[ 1 ] + d[ 2 ] * q[ 2 ] ) / det;
+      long double t = ( e2[ 0 ] * q[ 0 ] + e2[ 1 ] * q[ 1 ] + e2[ 2 ] * q[ 2 ] ) / det;
+      bool in = bu >= 0 && bv >= 0 && bu + bv <= 1;
+      if( in != ( hit[ i ] != 0 ) )
+	{
+	  e.miss();
+	  continue;
+	}
+      if( in )
+	{
+	  e.add( dist[ i ], t, 24 );
+	}
+    }
+  results.push_back( e.result( "intersectTri", "Vector3", time, n ) );
+}
+
+//
+inline void Harness::color( std::vector< Result > &results, unsigned int n, unsigned int seed )
+{
+  // components from 1e-18 to 1e18 : products reach the ends of the float range without overflowing
+  std::vector< Color< float > > c1( n ), c2( n ), o( n );
+  for( unsigned int i = 0; i < n; ++i )
+    {
+      for( int k = 0; k < 4; ++k )
+	{
+	  c1[ i ].v[ k ] = static_cast< float >( pow( 10.0, static_cast< double >( random( seed ) ) * 18 ) ) * random( seed );
+	  c2[ i ].v[ k ] = static_cast< float >( pow( 10.0, static_cast< double >( random( seed ) ) * 18 ) ) * random( seed );
+	}
+    }
+  const float s = 1.0f / 3;
+
+  std::vector< std::string > names;
+  names.push_back( "Color" );
+  for( int l = Cpu::SCALAR; l <= Cpu::detect(); ++l )
+    {
+      names.push_back( std::string( "dispatch-" ) + Cpu::name( static_cast< Cpu::Level >( l ) ) );
+    }
+
+  for( int k = 0; k < 2; ++k )
+    {
+      for( unsigned int b = 0; b < names.size(); ++b )
+	{
+	  double t0 = seconds();
+	  if( b == 0 )
+	    {
+	      for( unsigned int i = 0; i < n; ++i )
+		{
+		  if( k == 0 )
+		    o[ i ] = c1[ i ] * s;
+		  else
+		    o[ i ] = Color< float >( c1[ i ].r * c2[ i ].r, c1[ i ].g * c2[ i ].g, c1[ i ].b * c2[ i ].b, c1[ i ].a * c2[ i ].a );
+		}
+	    }
+	  else if( k == 0 )
+	    {
+	      Dispatch< float >::table( static_cast< Cpu::Level >( b - 1 ) ).scale( n ? &o[ 0 ] : 0, n ? &c1[ 0 ] : 0, n, s );
+	    }
+	  else
+	    {
+	      Dispatch< float >::table( static_cast< Cpu::Level >( b - 1 ) ).modulate( n ? &o[ 0 ] : 0, n ? &c1[ 0 ] : 0, n ? &c2[ 0 ] : 0, n );
+	    }
+	  double t = seconds() - t0;
+
+	  Error e;
+	  for( unsigned int i = 0; i < n; ++i )
+	    {
+	      for( int j = 0; j < 4; ++j )
+		{
+		  long double r = static_cast< long double >( c1[ i ].v[ j ] ) * ( k == 0 ? s : c2[ i ].v[ j ] );
+		  e.add( o[ i ].v[ j ], r, 24 );
+		}
+	    }
+	  results.push_back( e.result( k == 0 ? "colorScale" : "colorModulate", names[ b ], t, n ) );
+	}
+    }
+}
+
+//
+inline void Harness::convert( std::vector< Result > &results, unsigned int n, unsigned int seed )
+{
+  // normal half range, every eighth value an exact rounding tie
+  std::vector< float > f( n ), o( n );
+  std::vector< Half > h( n );
+  std::vector< BFloat16 > bf( n );
+  for( unsigned int i = 0; i < n; ++i )
+    {
+      float x = static_cast< float >( pow( 2.0, static_cast< double >( random( seed ) ) * 14 ) ) * ( random( seed ) < 0 ? -1 : 1 );
+      if( ( i & 7 ) == 0 )
+	{
+	  // half way between two halves
+	  unsigned short b = Half::fromFloat( x );
+	  x = ( Half::toFloat( b ) + Half::toFloat( static_cast< unsigned short >( b + 1 ) ) ) / 2;
+	}
+      f[ i ] = x;
+    }
+
+  for( int b = 0; b < 3; ++b )
+    {
+      double t0 = seconds();
+      if( b == 0 )
+	{
+	  for( unsigned int i = 0; i < n; ++i )
+	    o[ i ] = Half::toFloat( Half::fromFloat( f[ i ] ) );
+	}
+      else if( b == 1 )
+	{
+	  Half::fromFloat( n ? &h[ 0 ] : 0, n ? &f[ 0 ] : 0, n );
+	  Half::toFloat( n ? &o[ 0 ] : 0, n ? &h[ 0 ] : 0, n );
+	}
+      else
+	{
+	  BFloat16::fromFloat( n ? &bf[ 0 ] : 0, n ? &f[ 0 ] : 0, n );
+	  BFloat16::toFloat( n ? &o[ 0 ] : 0, n ? &bf[ 0 ] : 0, n );
+	}
+      double t = seconds() - t0;
+
+      // error in ulp of the storage format : 0.5 is correctly rounded
+      Error e;
+      for( unsigned int i = 0; i < n; ++i )
+	{
+	  e.add( o[ i ], f[ i ], b < 2 ? 11 : 8 );
+	}
+      results.push_back( e.result( b < 2 ? "half" : "bfloat16", b == 0 ? "scalar" : "bulk", t, n ) );
+    }
+}
+
+//
+inline void Harness::run( std::vector< Result > &results, unsigned int n, unsigned int seed )
+{
+  normalize( results, n, seed );
+  inverse( results, n / 4, seed );
+  slerp( results, n, seed );
+  rotation( results, n / 4, seed );
+  intersectTri( results, n, seed );
+  color( results, n, seed );
+  convert( results, n, seed );
+}
+
+//
+inline void Harness::print( std::ostream &os, const std::vector< Result > &results )
+{
+  os << std::left << std::setw( 14 ) << "kernel" << std::setw( 22 ) << "backend"
+     << std::right << std::setw( 12 ) << "max ulp" << std::setw( 12 ) << "mean ulp"
+     << std::setw( 10 ) << "mismatch" << std::setw( 14 ) << "Melem/s" << std::endl;
+  for( unsigned int i = 0; i < results.size(); ++i )
+    {
+      const Result &r = results[ i ];
+      os << std::left << std::setw( 14 ) << r.kernel << std::setw( 22 ) << r.backend
+	 << std::right << std::setw( 12 ) << std::setprecision( 4 ) << r.maxUlp
+	 << std::setw( 12 ) << std::setprecision( 4 ) << r.meanUlp
+	 << std::setw( 10 ) << r.mismatch
+	 << std::setw( 14 ) << std::setprecision( 4 ) << r.rate / 1e6 << std::endl;
+    }
+}
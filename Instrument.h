@@ -0,0 +1,279 @@
+#pragma once
+
+#ifndef MATH_INSTRUMENT
+
+#define MATH_INSTRUMENT_SCOPE( counter, elements )
+#define MATH_INSTRUMENT_SITE( site )
+
+#else
+
+#include <cstring>
+#include <ctime>
+
+#if defined( __GNUC__ ) && ( defined( __x86_64__ ) || defined( __i386__ ) )
+#include <x86intrin.h>
+#elif defined( _MSC_VER )
+#include <intrin.h>
+#endif
+
+#if __cplusplus >= 201103L
+#define MATH_THREAD_LOCAL thread_local
+#elif defined( _MSC_VER )
+#define MATH_THREAD_LOCAL __declspec( thread )
+#else
+#define MATH_THREAD_LOCAL __thread
+#endif
+
+//! per-thread call counters of hot functions
+/*!
+  Compiled in only when MATH_INSTRUMENT is defined; otherwise this header
+  defines the MATH_INSTRUMENT_SCOPE and MATH_INSTRUMENT_SITE hooks as
+  nothing and includes no other header. Each thread counts into its own
+  slot, so hooks take no lock. Every SAMPLE_RATE-th call of a counter on
+  a thread is timed in ticks ( rdtsc where available, clock() otherwise ).
+  Counts are split by call site : a MATH_INSTRUMENT_SITE( site ) in the
+  caller tags the calls made by its thread until the end of its scope,
+  untagged calls count as site 0.
+  snapshot and reset read and clear all slots without synchronization :
+  call them between frames for exact numbers.
+*/
+struct Instrument
+{
+  enum Counter
+    {
+      MATRIX4_INVERSE,
+      VECTOR3_NORMALIZE,
+      VECTOR3_INTERSECT_TRI,
+      QUATERNION_SLERP,
+      DISPATCH_MULTIPLY,
+      DISPATCH_TRANSFORM,
+      DISPATCH_NORMALIZE,
+      CLIP_TRIANGLES,
+      USER = 16,
+      COUNTER_COUNT = USER + 16
+    };
+
+  enum
+    {
+      MAX_THREADS = 256,
+      SITE_COUNT = 8,
+      SAMPLE_RATE = 64
+    };
+
+  struct Stats
+  {
+    unsigned long long calls;
+    unsigned long long elements;
+    unsigned long long samples;
+    unsigned long long ticks;
+  };
+
+  //! counts one call on construction, times sampled calls until destruction
+  struct Scope
+  {
+    Scope( Counter counter, unsigned long long elements = 1 );
+    ~Scope();
+
+  private:
+    Stats *stats;
+    unsigned long long start;
+  };
+
+  //! tags calls of this thread with site until destruction
+  struct Site
+  {
+    Site( unsigned int site );
+    ~Site();
+
+  private:
+    unsigned int previous;
+  };
+
+  // static function
+  /*!
+    @brief sum counters over threads and sites
+    @param stats COUNTER_COUNT entries indexed by Counter
+  */
+  static void snapshot( Stats *stats );
+  /*!
+    @brief sum counters of one call site over threads
+    @param stats COUNTER_COUNT entries indexed by Counter
+  */
+  static void snapshot( Stats *stats, unsigned int site );
+  /*!
+    @brief clear counters of all threads
+  */
+  static void reset();
+  /*!
+    @brief name of counter ( user counters are "user" )
+  */
+  static const char *name( Counter counter );
+  /*!
+    @brief current time stamp in ticks
+  */
+  static unsigned long long ticks();
+
+private:
+  struct Slot
+  {
+    Stats stats[ SITE_COUNT ][ COUNTER_COUNT ];
+    unsigned int site;
+  };
+
+  static Slot *slots();
+  static Slot &local();
+};
+
+#define MATH_INSTRUMENT_CONCAT2( a, b ) a##b
+#define MATH_INSTRUMENT_CONCAT( a, b ) MATH_INSTRUMENT_CONCAT2( a, b )
+#define MATH_INSTRUMENT_SCOPE( counter, elements ) Instrument::Scope MATH_INSTRUMENT_CONCAT( instrumentScope, __LINE__ )( counter, elements )
+#define MATH_INSTRUMENT_SITE( site ) Instrument::Site MATH_INSTRUMENT_CONCAT( instrumentSite, __LINE__ )( site )
+
+//
+inline Instrument::Scope::Scope( Counter counter, unsigned long long elements ) : stats( 0 ), start( 0 )
+{
+  Slot &slot = local();
+  stats = &slot.stats[ slot.site ][ counter ];
+  ++stats->calls;
+  stats->elements += elements;
+  if( ( stats->calls & ( SAMPLE_RATE - 1 ) ) == 0 )
+    {
+      start = ticks();
+    }
+}
+
+//
+inline Instrument::Scope::~Scope()
+{
+  if( start )
+    {
+      stats->ticks += ticks() - start;
+      ++stats->samples;
+    }
+}
+
+//
+inline Instrument::Site::Site( unsigned int site ) : previous( local().site )
+{
+  // sites past SITE_COUNT count as untagged
+  local().site = site < SITE_COUNT ? site : 0;
+}
+
+//
+inline Instrument::Site::~Site()
+{
+  local().site = previous;
+}
+
+//
+inline Instrument::Slot *Instrument::slots()
+{
+  static Slot s[ MAX_THREADS ];
+  return s;
+}
+
+//
+inline Instrument::Slot &Instrument::local()
+{
+  static MATH_THREAD_LOCAL Slot *slot = 0;
+  if( !slot )
+    {
+      // threads past MAX_THREADS share the last slot and may lose counts
+      static int next = 0;
+#if defined( _MSC_VER )
+      int i = _InterlockedExchangeAdd( reinterpret_cast< long volatile * >( &next ), 1 );
+#else
+      int i = __sync_fetch_and_add( &next, 1 );
+#endif
+      slot = &slots()[ i < MAX_THREADS ? i : MAX_THREADS - 1 ];
+    }
+  return *slot;
+}
+
+//
+inline void Instrument::snapshot( Stats *stats )
+{
+  memset( stats, 0, sizeof( Stats ) * COUNTER_COUNT );
+  Stats site[ COUNTER_COUNT ];
+  for( unsigned int k = 0; k < SITE_COUNT; ++k )
+    {
+      snapshot( site, k );
+      for( int c = 0; c < COUNTER_COUNT; ++c )
+	{
+	  stats[ c ].calls += site[ c ].calls;
+	  stats[ c ].elements += site[ c ].elements;
+	  stats[ c ].samples += site[ c ].samples;
+	  stats[ c ].ticks += site[ c ].ticks;
+	}
+    }
+}
+
+//
+inline void Instrument::snapshot( Stats *stats, unsigned int site )
+{
+  memset( stats, 0, sizeof( Stats ) * COUNTER_COUNT );
+  if( site >= SITE_COUNT )
+    {
+      return;
+    }
+  const Slot *s = slots();
+  for( int t = 0; t < MAX_THREADS; ++t )
+    {
+      for( int c = 0; c < COUNTER_COUNT; ++c )
+	{
+	  stats[ c ].calls += s[ t ].stats[ site ][ c ].calls;
+	  stats[ c ].elements += s[ t ].stats[ site ][ c ].elements;
+	  stats[ c ].samples += s[ t ].stats[ site ][ c ].samples;
+	  stats[ c ].ticks += s[ t ].stats[ site ][ c ].ticks;
+	}
+    }
+}
+
+//
+inline void Instrument::reset()
+{
+  // current sites of running threads are kept
+  Slot *s = slots();
+  for( int t = 0; t < MAX_THREADS; ++t )
+    {
+      memset( s[ t ].stats, 0, sizeof( s[ t ].stats ) );
+    }
+}
+
+//
+inline const char *Instrument::name( Counter counter )
+{
+  switch( counter )
+    {
+    case MATRIX4_INVERSE:
+      return "Matrix4::inverse";
+    case VECTOR3_NORMALIZE:
+      return "Vector3::normalize";
+    case VECTOR3_INTERSECT_TRI:
+      return "Vector3::intersectTri";
+    case QUATERNION_SLERP:
+      return "Quaternion::slerp";
+    case DISPATCH_MULTIPLY:
+      return "Dispatch::multiply";
+    case DISPATCH_TRANSFORM:
+      return "Dispatch::transformAffine";
+    case DISPATCH_NORMALIZE:
+      return "Dispatch::normalize";
+    case CLIP_TRIANGLES:
+      return "Clip::triangles";
+    default:
+      return counter >= USER && counter < COUNTER_COUNT ? "user" : "";
+    }
+}
+
+//
+inline unsigned long long Instrument::ticks()
+{
+#if ( defined( __GNUC__ ) && ( defined( __x86_64__ ) || defined( __i386__ ) ) ) || defined( _MSC_VER )
+  return __rdtsc();
+#else
+  return static_cast< unsigned long long >( clock() );
+#endif
+}
+
+#endif
@@ -8,6 +8,29 @@
 #include "Quaternion.h"
 #include "Plane.h"
 #include "Color.h"
+#include "Polygon2.h"
+#include "Clip.h"
+#include "Vector3SoA.h"
+#include "Precise.h"
+#include "Fixed.h"
+#include "Track.h"
+#include "Quantize.h"
+#include "Half.h"
+#include "DualQuaternion.h"
+#include "Camera.h"
+#include "TaggedMatrix4.h"
+#include "Affine3.h"
+#include "Dispatch.h"
+#include "Instrument.h"
+#include "MeshAttribute.h"
+#include "Mesh.h"
+#include "AABB.h"
+#include "Sphere.h"
+#include "OBB.h"
+#include "Ray.h"
+#include "Collide.h"
+#include "Reduce.h"
+#include "Stream.h"
 
 const double PI = 3.1415926535897932384626433832795;
 
@@ -2,6 +2,7 @@
 
 #include <memory>
 #include <cmath>
+#include "Instrument.h"
 
 template< typename T > struct Vector3;
 template< typename T > struct Quaternion;
@@ -120,6 +121,23 @@ struct Matrix4
     @brief transpose matrix
   */
   static Matrix4< T > &transpose( Matrix4< T > &m,const Matrix4< T > &m0 );
+  /*!
+    @brief create scaling, rotation and translation matrix
+  */
+  static Matrix4< T > &transformation( Matrix4< T > &m, const Vector3< T > &scale, const Quaternion< T > &rot, const Vector3< T > &trans );
+  /*!
+    @brief decompose into scaling, rotation and translation
+    @return false if scaling is zero
+  */
+  static bool decompose( Vector3< T > &scale, Quaternion< T > &rot, Vector3< T > &trans, const Matrix4< T > &m );
+  /*!
+    @brief decompose matrices into scaling, rotation and translation
+    @param valid if not null, 1 for the matrices that decompose, otherwise 0
+  */
+  static void decompose( Vector3< T > *scale, Quaternion< T > *rot, Vector3< T > *trans, const Matrix4< T > *m, unsigned int n, unsigned char *valid = 0 );
+
+  // number of matrices that the batch decompose handles at once
+  static const unsigned int DECOMPOSE_BLOCK = 256;
 
   union
   {
@@ -583,6 +601,7 @@ inline T Matrix4< T >::determinant( const Matrix4< T > &m )
 template< typename T >
 inline Matrix4< T > &Matrix4< T >::inverse( Matrix4< T > &m, const Matrix4< T > &m0, T *det )
 {
+  MATH_INSTRUMENT_SCOPE( Instrument::MATRIX4_INVERSE, 1 );
   T d = determinant( m0 );
   
   if( det ) * det = d;
@@ -777,6 +796,144 @@ Matrix4< T > & Matrix4< T >::screen( Matrix4< T > &m, T width, T height )
   return m;
 }
 
+//
+template< typename T >
+Matrix4< T > & Matrix4< T >::transformation( Matrix4< T > &m, const Vector3< T > &scale, const Quaternion< T > &rot, const Vector3< T > &trans )
+{
+  Quaternion< T >::toMatrix( m, rot );
+  for( int j = 0; j < 3; ++j )
+    {
+      m.m[ j ] *= scale.x;
+      m.m[ 4 + j ] *= scale.y;
+      m.m[ 8 + j ] *= scale.z;
+    }
+  m._41 = trans.x;
+  m._42 = trans.y;
+  m._43 = trans.z;
+  return m;
+}
+
+//
+template< typename T >
+bool Matrix4< T >::decompose( Vector3< T > &scale, Quaternion< T > &rot, Vector3< T > &trans, const Matrix4< T > &m )
+{
+  trans = Vector3< T >( m._41, m._42, m._43 );
+
+  // rows of the upper 3x3 are the scaled axes
+  Vector3< T > ax( m._11, m._12, m._13 );
+  Vector3< T > ay( m._21, m._22, m._23 );
+  Vector3< T > az( m._31, m._32, m._33 );
+  scale = Vector3< T >( Vector3< T >::length( ax ), Vector3< T >::length( ay ), Vector3< T >::length( az ) );
+  if( scale.x == 0 || scale.y == 0 || scale.z == 0 )
+    {
+      Quaternion< T >::identity( rot );
+      return false;
+    }
+
+  // mirrored basis : put the reflection into the x scale
+  Vector3< T > c;
+  Vector3< T >::cross( c, ax, ay );
+  if( Vector3< T >::dot( c, az ) < 0 )
+    {
+      scale.x = -scale.x;
+    }
+
+  Matrix4< T > r;
+  identity( r );
+  for( int j = 0; j < 3; ++j )
+    {
+      r.m[ j ] = m.m[ j ] / scale.x;
+      r.m[ 4 + j ] = m.m[ 4 + j ] / scale.y;
+      r.m[ 8 + j ] = m.m[ 8 + j ] / scale.z;
+    }
+  Quaternion< T >::fromMatrix( rot, r );
+  return true;
+}
+
+//
+template< typename T >
+void Matrix4< T >::decompose( Vector3< T > *scale, Quaternion< T > *rot, Vector3< T > *trans, const Matrix4< T > *m, unsigned int n, unsigned char *valid )
+{
+  // same result as the scalar version, with the zero scale and mirror tests
+  // turned into selects. the square roots of a block run in their own loop,
+  // so the other loops vectorize across matrices even where sqrt has to set
+  // errno ; the rotations of a block go through the batched
+  // Quaternion::fromMatrix
+  int blocks = static_cast< int >( ( n + DECOMPOSE_BLOCK - 1 ) / DECOMPOSE_BLOCK );
+#ifdef _OPENMP
+#pragma omp parallel for if( n > 4096 )
+#endif
+  for( int b = 0; b < blocks; ++b )
+    {
+      unsigned int begin = b * DECOMPOSE_BLOCK;
+      unsigned int count = ( begin + DECOMPOSE_BLOCK < n ? begin + DECOMPOSE_BLOCK : n ) - begin;
+      const Matrix4< T > *a = &m[ begin ];
+      Matrix4< T > r[ DECOMPOSE_BLOCK ];
+      T sx[ DECOMPOSE_BLOCK ], sy[ DECOMPOSE_BLOCK ], sz[ DECOMPOSE_BLOCK ];
+      unsigned char ok[ DECOMPOSE_BLOCK ];
+      for( unsigned int i = 0; i < count; ++i )
+	{
+	  sx[ i ] = a[ i ]._11 * a[ i ]._11 + a[ i ]._12 * a[ i ]._12 + a[ i ]._13 * a[ i ]._13;
+	  sy[ i ] = a[ i ]._21 * a[ i ]._21 + a[ i ]._22 * a[ i ]._22 + a[ i ]._23 * a[ i ]._23;
+	  sz[ i ] = a[ i ]._31 * a[ i ]._31 + a[ i ]._32 * a[ i ]._32 + a[ i ]._33 * a[ i ]._33;
+	}
+      for( unsigned int i = 0; i < count; ++i )
+	{
+	  sx[ i ] = static_cast< T >( sqrt( static_cast< double >( sx[ i ] ) ) );
+	  sy[ i ] = static_cast< T >( sqrt( static_cast< double >( sy[ i ] ) ) );
+	  sz[ i ] = static_cast< T >( sqrt( static_cast< double >( sz[ i ] ) ) );
+	}
+      for( unsigned int i = 0; i < count; ++i )
+	{
+	  T lx = sx[ i ], ly = sy[ i ], lz = sz[ i ];
+	  bool v = ( lx != 0 ) & ( ly != 0 ) & ( lz != 0 );
+
+	  // mirrored basis : put the reflection into the x scale
+	  T det = ( a[ i ]._12 * a[ i ]._23 - a[ i ]._13 * a[ i ]._22 ) * a[ i ]._31
+	    + ( a[ i ]._13 * a[ i ]._21 - a[ i ]._11 * a[ i ]._23 ) * a[ i ]._32
+	    + ( a[ i ]._11 * a[ i ]._22 - a[ i ]._12 * a[ i ]._21 ) * a[ i ]._33;
+	  lx = det < 0 ? -lx : lx;
+
+	  // rows of a zero scale matrix become the identity
+	  T ix = ( v ? 1 : 0 ) / ( v ? lx : 1 );
+	  T iy = ( v ? 1 : 0 ) / ( v ? ly : 1 );
+	  T iz = ( v ? 1 : 0 ) / ( v ? lz : 1 );
+	  T one = v ? 0 : 1;
+	  // every element is stored so that the stores form one contiguous group
+	  r[ i ]._11 = a[ i ]._11 * ix + one;
+	  r[ i ]._12 = a[ i ]._12 * ix;
+	  r[ i ]._13 = a[ i ]._13 * ix;
+	  r[ i ]._14 = 0;
+	  r[ i ]._21 = a[ i ]._21 * iy;
+	  r[ i ]._22 = a[ i ]._22 * iy + one;
+	  r[ i ]._23 = a[ i ]._23 * iy;
+	  r[ i ]._24 = 0;
+	  r[ i ]._31 = a[ i ]._31 * iz;
+	  r[ i ]._32 = a[ i ]._32 * iz;
+	  r[ i ]._33 = a[ i ]._33 * iz + one;
+	  r[ i ]._34 = 0;
+	  r[ i ]._41 = r[ i ]._42 = r[ i ]._43 = 0;
+	  r[ i ]._44 = 1;
+	  sx[ i ] = lx;
+	  ok[ i ] = v;
+	}
+
+      Quaternion< T >::fromMatrix( &rot[ begin ], r, count );
+      for( unsigned int i = 0; i < count; ++i )
+	{
+	  scale[ begin + i ] = Vector3< T >( sx[ i ], sy[ i ], sz[ i ] );
+	  trans[ begin + i ] = Vector3< T >( a[ i ]._41, a[ i ]._42, a[ i ]._43 );
+	}
+      if( valid )
+	{
+	  for( unsigned int i = 0; i < count; ++i )
+	    {
+	      valid[ begin + i ] = ok[ i ];
+	    }
+	}
+    }
+}
+
 /*!
   @brief output stream
 */
@@ -0,0 +1,725 @@
+#pragma once
+
+#include <cmath>
+#include <vector>
+#include <algorithm>
+#include "Vector2.h"
+#include "Vector3.h"
+#include "Vector3SoA.h"
+#include "MeshAttribute.h"
+
+//! indexed triangle mesh with attributes in structure-of-arrays layout
+/*!
+  Owns its arrays. Normals and texture coordinates are optional : they
+  are present when their arrays hold vertexCount() entries.
+  Triangles are three consecutive entries of index, counter-clockwise front.
+  The usual preparation is weld, optimizeVertexCache, then optimizeVertexFetch.
+*/
+template< typename T = double >
+struct Mesh
+{
+  enum
+    {
+      // vertex cache modelled by optimizeVertexCache
+      CACHE_SIZE = 32
+    };
+
+  struct Statistics
+  {
+    //! transformed vertices per triangle ( 0.5 is ideal for large regular meshes )
+    T acmr;
+    //! transformed vertices per referenced vertex ( 1 is ideal )
+    T atvr;
+    //! shaded fragments per covered pixel over six axis views ( 1 is ideal )
+    T overdraw;
+  };
+
+  Mesh< T >();
+  Mesh< T >( const Vector3< T > *position, unsigned int vertexCount, const unsigned int *index, unsigned int triangleCount );
+
+  unsigned int vertexCount() const;
+  unsigned int triangleCount() const;
+  bool hasNormals() const;
+  bool hasUvs() const;
+
+  /*!
+    @brief view of positions
+  */
+  Vector3SoA< T > position();
+  /*!
+    @brief view of normals ( allocated if missing )
+  */
+  Vector3SoA< T > normal();
+  /*!
+    @brief get texture coordinate of i-th vertex
+  */
+  Vector2< T > uv( unsigned int i ) const;
+
+  /*!
+    @brief calculate vertex normals
+  */
+  void computeNormals( typename MeshAttribute< T >::Weight weight = MeshAttribute< T >::AREA );
+  /*!
+    @brief merge vertices whose position and attributes differ by at most epsilon
+  */
+  void weld( T epsilon = 0 );
+  /*!
+    @brief reorder triangles for the post-transform vertex cache, then vertices for fetch locality
+    Vertices no triangle references are dropped. A mesh without indices is left unchanged.
+  */
+  void optimize();
+
+  // static function
+  /*!
+    @brief calculate vertex remap that merges equal vertices ( spatial grid of cell epsilon )
+    @param remap vertexCount entries, new index of each vertex ( first occurrence order )
+    @return new vertex count
+  */
+  static unsigned int weldRemap( unsigned int *remap, const Mesh< T > &m, T epsilon );
+  /*!
+    @brief reorder triangles for the post-transform vertex cache ( Forsyth )
+    @param o 3 * triangleCount entries, must not alias index
+  */
+  static void optimizeVertexCache( unsigned int *o, const unsigned int *index, unsigned int triangleCount, unsigned int vertexCount );
+  /*!
+    @brief calculate vertex remap in order of first use by the index buffer
+    @param remap vertexCount entries, ~0u for unreferenced vertices
+    @return new vertex count
+  */
+  static unsigned int optimizeVertexFetch( unsigned int *remap, const unsigned int *index, unsigned int triangleCount, unsigned int vertexCount );
+  /*!
+    @brief apply vertex remap to indices and attributes ( o may be m )
+    @param vertexCount new vertex count
+    Of the vertices merged into one, the attributes of the lowest index are kept.
+  */
+  static Mesh< T > &remap( Mesh< T > &o, const Mesh< T > &m, const unsigned int *remap, unsigned int vertexCount );
+  /*!
+    @brief simulate FIFO vertex cache and rasterize six axis views
+  */
+  static Statistics statistics( const Mesh< T > &m, unsigned int cacheSize = 16, unsigned int resolution = 256 );
+
+  std::vector< T > px, py, pz;
+  std::vector< T > nx, ny, nz;
+  std::vector< T > u, v;
+  std::vector< unsigned int > index;
+
+private:
+  struct CellLess
+  {
+    const std::vector< T > *cell;
+    bool operator ()( unsigned int a, unsigned int b ) const;
+  };
+
+  bool equal( unsigned int a, unsigned int b, T epsilon ) const;
+
+  static unsigned int cellHash( const T *cell );
+  static float cacheScore( int position, unsigned int live );
+  static void overdraw( unsigned long long &shaded, unsigned long long &covered, const Mesh< T > &m, int axis, bool negative, unsigned int resolution );
+};
+
+//
+template< typename T >
+inline Mesh< T >::Mesh()
+{
+}
+
+//
+template< typename T >
+Mesh< T >::Mesh( const Vector3< T > *position, unsigned int vertexCount, const unsigned int *index, unsigned int triangleCount ) : px( vertexCount ), py( vertexCount ), pz( vertexCount ), index( index, index + triangleCount * 3 )
+{
+  for( unsigned int i = 0; i < vertexCount; ++i )
+    {
+      px[ i ] = position[ i ].x;
+      py[ i ] = position[ i ].y;
+      pz[ i ] = position[ i ].z;
+    }
+}
+
+//
+template< typename T >
+inline unsigned int Mesh< T >::vertexCount() const
+{
+  return static_cast< unsigned int >( px.size() );
+}
+
+//
+template< typename T >
+inline unsigned int Mesh< T >::triangleCount() const
+{
+  return static_cast< unsigned int >( index.size() / 3 );
+}
+
+//
+template< typename T >
+inline bool Mesh< T >::hasNormals() const
+{
+  return !px.empty() && nx.size() == px.size();
+}
+
+//
+template< typename T >
+inline bool Mesh< T >::hasUvs() const
+{
+  return !px.empty() && u.size() == px.size();
+}
+
+//
+template< typename T >
+inline Vector3SoA< T > Mesh< T >::position()
+{
+  if( px.empty() )
+    {
+      return Vector3SoA< T >();
+    }
+  return Vector3SoA< T >( &px[ 0 ], &py[ 0 ], &pz[ 0 ] );
+}
+
+//
+template< typename T >
+inline Vector3SoA< T > Mesh< T >::normal()
+{
+  if( px.empty() )
+    {
+      return Vector3SoA< T >();
+    }
+  nx.resize( px.size() );
+  ny.resize( px.size() );
+  nz.resize( px.size() );
+  return Vector3SoA< T >( &nx[ 0 ], &ny[ 0 ], &nz[ 0 ] );
+}
+
+//
+template< typename T >
+inline Vector2< T > Mesh< T >::uv( unsigned int i ) const
+{
+  return Vector2< T >( u[ i ], v[ i ] );
+}
+
+//
+template< typename T >
+void Mesh< T >::computeNormals( typename MeshAttribute< T >::Weight weight )
+{
+  if( px.empty() )
+    {
+      return;
+    }
+  std::vector< Vector3< T > > p( px.size() );
+  Vector3SoA< T > s( position() );
+  Vector3SoA< T >::store( &p[ 0 ], s, vertexCount() );
+  Vector3SoA< T > n( normal() );
+  MeshAttribute< T >::vertexNormals( n, &p[ 0 ], vertexCount(), index.empty() ? 0 : &index[ 0 ], triangleCount(), weight );
+}
+
+//
+template< typename T >
+void Mesh< T >::weld( T epsilon )
+{
+  std::vector< unsigned int > r( px.size() + 1 );
+  unsigned int n = weldRemap( &r[ 0 ], *this, epsilon );
+  remap( *this, *this, &r[ 0 ], n );
+}
+
+//
+template< typename T >
+void Mesh< T >::optimize()
+{
+  if( index.empty() )
+    {
+      return;
+    }
+  std::vector< unsigned int > o( index.size() );
+  optimizeVertexCache( &o[ 0 ], &index[ 0 ], triangleCount(), vertexCount() );
+  index.swap( o );
+  std::vector< unsigned int > r( px.size() + 1 );
+  unsigned int n = optimizeVertexFetch( &r[ 0 ], &index[ 0 ], triangleCount(), vertexCount() );
+  remap( *this, *this, &r[ 0 ], n );
+}
+
+//
+template< typename T >
+inline bool Mesh< T >::CellLess::operator ()( unsigned int a, unsigned int b ) const
+{
+  const std::vector< T > &c = *cell;
+  for( int k = 0; k < 3; ++k )
+    {
+      if( c[ a * 3 + k ] != c[ b * 3 + k ] )
+	{
+	  return c[ a * 3 + k ] < c[ b * 3 + k ];
+	}
+    }
+  return a < b;
+}
+
+//
+template< typename T >
+bool Mesh< T >::equal( unsigned int a, unsigned int b, T epsilon ) const
+{
+  T dx = px[ a ] - px[ b ], dy = py[ a ] - py[ b ], dz = pz[ a ] - pz[ b ];
+  if( dx * dx + dy * dy + dz * dz > epsilon * epsilon )
+    {
+      return false;
+    }
+  if( hasNormals() )
+    {
+      dx = nx[ a ] - nx[ b ];
+      dy = ny[ a ] - ny[ b ];
+      dz = nz[ a ] - nz[ b ];
+      if( dx * dx + dy * dy + dz * dz > epsilon * epsilon )
+	{
+	  return false;
+	}
+    }
+  if( hasUvs() )
+    {
+      dx = u[ a ] - u[ b ];
+      dy = v[ a ] - v[ b ];
+      if( dx * dx + dy * dy > epsilon * epsilon )
+	{
+	  return false;
+	}
+    }
+  return true;
+}
+
+//
+template< typename T >
+inline unsigned int Mesh< T >::cellHash( const T *cell )
+{
+  unsigned int h = 0;
+  for( int k = 0; k < 3; ++k )
+    {
+      // cells are whole numbers when hashed
+      h = ( h ^ static_cast< unsigned int >( static_cast< long long >( cell[ k ] ) ) ) * 0x9e3779b1u;
+      h ^= h >> 16;
+    }
+  return h;
+}
+
+//
+template< typename T >
+unsigned int Mesh< T >::weldRemap( unsigned int *remap, const Mesh< T > &m, T epsilon )
+{
+  unsigned int n = m.vertexCount();
+  // grid of cell 2 * epsilon : a vertex can only match in its own cell and in the
+  // nearer neighbour along each axis ; with epsilon 0 the cell is the position itself
+  T size = 2 * epsilon;
+  std::vector< T > cell( n * 3 + 3 );
+  std::vector< int > side( n * 3 + 1, 0 );
+  for( unsigned int i = 0; i < n; ++i )
+    {
+      T p[ 3 ] = { m.px[ i ], m.py[ i ], m.pz[ i ] };
+      for( int k = 0; k < 3; ++k )
+	{
+	  if( epsilon > 0 )
+	    {
+	      T f = p[ k ] / size;
+	      cell[ i * 3 + k ] = static_cast< T >( floor( static_cast< double >( f ) ) );
+	      side[ i * 3 + k ] = f - cell[ i * 3 + k ] < static_cast< T >( 0.5 ) ? -1 : 1;
+	    }
+	  else
+	    {
+	      cell[ i * 3 + k ] = p[ k ];
+	    }
+	}
+    }
+  std::vector< unsigned int > order( n + 1 );
+  for( unsigned int i = 0; i < n; ++i )
+    {
+      order[ i ] = i;
+    }
+  CellLess less;
+  less.cell = &cell;
+  std::sort( order.begin(), order.begin() + n, less );
+
+  // vertices of cell c are order[ start[ c ] ] .. order[ start[ c + 1 ] - 1 ] in ascending index
+  std::vector< unsigned int > start, own( n + 1 );
+  for( unsigned int j = 0; j < n; ++j )
+    {
+      unsigned int a = order[ j ];
+      if( j == 0 || cell[ a * 3 ] != cell[ order[ j - 1 ] * 3 ] || cell[ a * 3 + 1 ] != cell[ order[ j - 1 ] * 3 + 1 ] || cell[ a * 3 + 2 ] != cell[ order[ j - 1 ] * 3 + 2 ] )
+	{
+	  start.push_back( j );
+	}
+      own[ a ] = static_cast< unsigned int >( start.size() - 1 );
+    }
+  start.push_back( n );
+
+  // open addressing table of neighbour cells, keyed by integer cell coordinates
+  unsigned int cells = static_cast< unsigned int >( start.size() - 1 ), mask = 1;
+  while( mask < cells * 4 )
+    {
+      mask <<= 1;
+    }
+  --mask;
+  std::vector< unsigned int > table( epsilon > 0 ? mask + 1 : 0, ~0u );
+  std::vector< T > key( cells * 3 + 3 );
+  for( unsigned int c = 0; c < cells && epsilon > 0; ++c )
+    {
+      std::copy( &cell[ order[ start[ c ] ] * 3 ], &cell[ order[ start[ c ] ] * 3 ] + 3, &key[ c * 3 ] );
+      unsigned int h = cellHash( &key[ c * 3 ] ) & mask;
+      while( table[ h ] != ~0u )
+	{
+	  h = ( h + 1 ) & mask;
+	}
+      table[ h ] = c;
+    }
+
+  unsigned int count = 0;
+  std::vector< unsigned int > first( n + 1 );
+  for( unsigned int i = 0; i < n; ++i )
+    {
+      unsigned int match = i;
+      for( int k = 0; k < ( epsilon > 0 ? 8 : 1 ); ++k )
+	{
+	  unsigned int c = own[ i ];
+	  if( k > 0 )
+	    {
+	      T q[ 3 ] = { cell[ i * 3 ] + ( k & 1 ? side[ i * 3 ] : 0 ), cell[ i * 3 + 1 ] + ( k & 2 ? side[ i * 3 + 1 ] : 0 ), cell[ i * 3 + 2 ] + ( k & 4 ? side[ i * 3 + 2 ] : 0 ) };
+	      unsigned int h = cellHash( q ) & mask;
+	      for( c = table[ h ]; c != ~0u; h = ( h + 1 ) & mask, c = table[ h ] )
+		{
+		  const T *o = &key[ c * 3 ];
+		  if( o[ 0 ] == q[ 0 ] && o[ 1 ] == q[ 1 ] && o[ 2 ] == q[ 2 ] )
+		    {
+		      break;
+		    }
+		}
+	      if( c == ~0u )
+		{
+		  continue;
+		}
+	    }
+	  for( unsigned int j = start[ c ]; j < start[ c + 1 ] && order[ j ] < match; ++j )
+	    {
+	      if( first[ order[ j ] ] == order[ j ] && m.equal( i, order[ j ], epsilon ) )
+		{
+		  match = order[ j ];
+		  break;
+		}
+	    }
+	}
+      first[ i ] = match;
+      remap[ i ] = match == i ? count++ : remap[ match ];
+    }
+  return count;
+}
+
+//
+template< typename T >
+inline float Mesh< T >::cacheScore( int position, unsigned int live )
+{
+  if( live == 0 )
+    {
+      return -1;
+    }
+  float s = 0;
+  if( position >= 0 )
+    {
+      // the last triangle's vertices get a fixed score so it is not reused at once
+      if( position < 3 )
+	{
+	  s = 0.75f;
+	}
+      else
+	{
+	  s = static_cast< float >( pow( 1 - static_cast< double >( position - 3 ) / ( CACHE_SIZE - 3 ), 1.5 ) );
+	}
+    }
+  // favour vertices with few remaining triangles so they leave the mesh early
+  return s + static_cast< float >( 2 / sqrt( static_cast< double >( live ) ) );
+}
+
+//
+template< typename T >
+void Mesh< T >::optimizeVertexCache( unsigned int *o, const unsigned int *index, unsigned int triangleCount, unsigned int vertexCount )
+{
+  // live triangles of vertex a are triangle[ offset[ a ] ] .. triangle[ offset[ a ] + live[ a ] - 1 ]
+  std::vector< unsigned int > offset( vertexCount + 1 ), triangle( triangleCount * 3 + 1 ), live( vertexCount + 1 );
+  MeshAttribute< T >::vertexCorners( &offset[ 0 ], &triangle[ 0 ], index, triangleCount, vertexCount );
+  for( unsigned int c = 0; c < triangleCount * 3; ++c )
+    {
+      triangle[ c ] /= 3;
+    }
+  std::vector< int > position( vertexCount + 1, -1 );
+  std::vector< float > vertexScore( vertexCount + 1 );
+  // scores of common valences, by cache position + 1
+  const unsigned int valences = 32;
+  float score[ CACHE_SIZE + 1 ][ valences ];
+  for( int i = 0; i <= CACHE_SIZE; ++i )
+    {
+      for( unsigned int l = 0; l < valences; ++l )
+	{
+	  score[ i ][ l ] = cacheScore( i - 1, l );
+	}
+    }
+  std::vector< unsigned char > emitted( triangleCount + 1, 0 );
+  for( unsigned int a = 0; a < vertexCount; ++a )
+    {
+      live[ a ] = offset[ a + 1 ] - offset[ a ];
+      vertexScore[ a ] = live[ a ] < valences ? score[ 0 ][ live[ a ] ] : cacheScore( -1, live[ a ] );
+    }
+
+  unsigned int cache[ CACHE_SIZE + 3 ], cacheCount = 0, cursor = 0;
+  int best = -1;
+  for( unsigned int k = 0; k < triangleCount; ++k )
+    {
+      if( best < 0 )
+	{
+	  // no live triangle touches the cache : restart at the next unemitted one
+	  while( emitted[ cursor ] )
+	    {
+	      ++cursor;
+	    }
+	  best = static_cast< int >( cursor );
+	}
+      unsigned int t = static_cast< unsigned int >( best );
+      emitted[ t ] = 1;
+      unsigned int next[ CACHE_SIZE + 3 ], nextCount = 0, head;
+      for( int i = 0; i < 3; ++i )
+	{
+	  unsigned int a = index[ t * 3 + i ];
+	  o[ k * 3 + i ] = a;
+	  unsigned int *l = &triangle[ offset[ a ] ];
+	  for( unsigned int j = 0; j < live[ a ]; ++j )
+	    {
+	      if( l[ j ] == t )
+		{
+		  l[ j ] = l[ --live[ a ] ];
+		  break;
+		}
+	    }
+	  if( std::find( next, next + nextCount, a ) == next + nextCount )
+	    {
+	      next[ nextCount++ ] = a;
+	    }
+	}
+      // the triangle's vertices move to the front, the rest keep their order
+      head = nextCount;
+      for( unsigned int i = 0; i < cacheCount; ++i )
+	{
+	  if( std::find( next, next + head, cache[ i ] ) == next + head )
+	    {
+	      next[ nextCount++ ] = cache[ i ];
+	    }
+	}
+      for( unsigned int i = 0; i < nextCount; ++i )
+	{
+	  unsigned int a = next[ i ];
+	  position[ a ] = i < CACHE_SIZE ? static_cast< int >( i ) : -1;
+	  vertexScore[ a ] = live[ a ] < valences ? score[ position[ a ] + 1 ][ live[ a ] ] : cacheScore( position[ a ], live[ a ] );
+	}
+      cacheCount = std::min< unsigned int >( nextCount, CACHE_SIZE );
+      std::copy( next, next + cacheCount, cache );
+
+      // only triangles of vertices whose score changed need rescoring
+      best = -1;
+      float bestScore = 0;
+      for( unsigned int i = 0; i < nextCount; ++i )
+	{
+	  unsigned int a = next[ i ];
+	  const unsigned int *l = &triangle[ offset[ a ] ];
+	  for( unsigned int j = 0; j < live[ a ]; ++j )
+	    {
+	      unsigned int f = l[ j ];
+	      float s = vertexScore[ index[ f * 3 ] ] + vertexScore[ index[ f * 3 + 1 ] ] + vertexScore[ index[ f * 3 + 2 ] ];
+	      if( best < 0 || s > bestScore )
+		{
+		  best = static_cast< int >( f );
+		  bestScore = s;
+		}
+	    }
+	}
+    }
+}
+
+//
+template< typename T >
+unsigned int Mesh< T >::optimizeVertexFetch( unsigned int *remap, const unsigned int *index, unsigned int triangleCount, unsigned int vertexCount )
+{
+  std::fill( remap, remap + vertexCount, ~0u );
+  unsigned int count = 0;
+  for( unsigned int c = 0; c < triangleCount * 3; ++c )
+    {
+      if( remap[ index[ c ] ] == ~0u )
+	{
+	  remap[ index[ c ] ] = count++;
+	}
+    }
+  return count;
+}
+
+//
+template< typename T >
+Mesh< T > &Mesh< T >::remap( Mesh< T > &o, const Mesh< T > &m, const unsigned int *remap, unsigned int vertexCount )
+{
+  unsigned int n = m.vertexCount();
+  bool normals = m.hasNormals(), uvs = m.hasUvs();
+  Mesh< T > r;
+  r.px.resize( vertexCount );
+  r.py.resize( vertexCount );
+  r.pz.resize( vertexCount );
+  if( normals )
+    {
+      r.nx.resize( vertexCount );
+      r.ny.resize( vertexCount );
+      r.nz.resize( vertexCount );
+    }
+  if( uvs )
+    {
+      r.u.resize( vertexCount );
+      r.v.resize( vertexCount );
+    }
+  // backwards so that the lowest of merged vertices is written last
+  for( unsigned int i = n; i > 0; --i )
+    {
+      unsigned int j = remap[ i - 1 ];
+      if( j == ~0u )
+	{
+	  continue;
+	}
+      r.px[ j ] = m.px[ i - 1 ];
+      r.py[ j ] = m.py[ i - 1 ];
+      r.pz[ j ] = m.pz[ i - 1 ];
+      if( normals )
+	{
+	  r.nx[ j ] = m.nx[ i - 1 ];
+	  r.ny[ j ] = m.ny[ i - 1 ];
+	  r.nz[ j ] = m.nz[ i - 1 ];
+	}
+      if( uvs )
+	{
+	  r.u[ j ] = m.u[ i - 1 ];
+	  r.v[ j ] = m.v[ i - 1 ];
+	}
+    }
+  r.index.resize( m.index.size() );
+  for( unsigned int c = 0; c < m.index.size(); ++c )
+    {
+      r.index[ c ] = remap[ m.index[ c ] ];
+    }
+  o.px.swap( r.px );
+  o.py.swap( r.py );
+  o.pz.swap( r.pz );
+  o.nx.swap( r.nx );
+  o.ny.swap( r.ny );
+  o.nz.swap( r.nz );
+  o.u.swap( r.u );
+  o.v.swap( r.v );
+  o.index.swap( r.index );
+  return o;
+}
+
+//
+template< typename T >
+typename Mesh< T >::Statistics Mesh< T >::statistics( const Mesh< T > &m, unsigned int cacheSize, unsigned int resolution )
+{
+  Statistics s;
+  unsigned int n = m.vertexCount(), triangles = m.triangleCount();
+
+  // a vertex is cached while fewer than cacheSize misses followed its load
+  std::vector< unsigned int > load( n + 1, 0 );
+  std::vector< unsigned char > used( n + 1, 0 );
+  unsigned int misses = 0, referenced = 0;
+  for( unsigned int c = 0; c < triangles * 3; ++c )
+    {
+      unsigned int a = m.index[ c ];
+      if( load[ a ] == 0 || load[ a ] + cacheSize <= misses )
+	{
+	  load[ a ] = ++misses;
+	}
+      referenced += used[ a ] ? 0 : 1;
+      used[ a ] = 1;
+    }
+  s.acmr = triangles ? static_cast< T >( misses ) / triangles : 0;
+  s.atvr = referenced ? static_cast< T >( misses ) / referenced : 0;
+
+  unsigned long long shaded = 0, covered = 0;
+  for( int axis = 0; axis < 3; ++axis )
+    {
+      overdraw( shaded, covered, m, axis, false, resolution );
+      overdraw( shaded, covered, m, axis, true, resolution );
+    }
+  s.overdraw = covered ? static_cast< T >( shaded ) / static_cast< T >( covered ) : 0;
+  return s;
+}
+
+//
+template< typename T >
+void Mesh< T >::overdraw( unsigned long long &shaded, unsigned long long &covered, const Mesh< T > &m, int axis, bool negative, unsigned int resolution )
+{
+  unsigned int n = m.vertexCount();
+  if( n == 0 || resolution == 0 )
+    {
+      return;
+    }
+  const std::vector< T > *p[ 3 ] = { &m.px, &m.py, &m.pz };
+  // screen axes ( a, b ) and depth d, front faces keep counter-clockwise winding on screen
+  const std::vector< T > &a = *p[ ( axis + 1 ) % 3 ], &b = *p[ ( axis + 2 ) % 3 ], &d = *p[ axis ];
+  T lo[ 2 ] = { a[ 0 ], b[ 0 ] }, hi[ 2 ] = { a[ 0 ], b[ 0 ] };
+  for( unsigned int i = 1; i < n; ++i )
+    {
+      lo[ 0 ] = std::min( lo[ 0 ], a[ i ] );
+      hi[ 0 ] = std::max( hi[ 0 ], a[ i ] );
+      lo[ 1 ] = std::min( lo[ 1 ], b[ i ] );
+      hi[ 1 ] = std::max( hi[ 1 ], b[ i ] );
+    }
+  T extent = std::max( hi[ 0 ] - lo[ 0 ], hi[ 1 ] - lo[ 1 ] );
+  T scale = extent > 0 ? resolution / extent : 0;
+
+  std::vector< T > depth( resolution * resolution, 0 );
+  std::vector< unsigned char > written( resolution * resolution, 0 );
+  for( unsigned int t = 0; t < m.triangleCount(); ++t )
+    {
+      T x[ 3 ], y[ 3 ], z[ 3 ];
+      for( int k = 0; k < 3; ++k )
+	{
+	  unsigned int i = m.index[ t * 3 + k ];
+	  x[ k ] = ( a[ i ] - lo[ 0 ] ) * scale;
+	  y[ k ] = ( b[ i ] - lo[ 1 ] ) * scale;
+	  // viewer on the positive side of axis unless negative, nearer points have smaller depth
+	  z[ k ] = negative ? d[ i ] : -d[ i ];
+	}
+      if( negative )
+	{
+	  std::swap( x[ 1 ], x[ 2 ] );
+	  std::swap( y[ 1 ], y[ 2 ] );
+	  std::swap( z[ 1 ], z[ 2 ] );
+	}
+      T area = ( x[ 1 ] - x[ 0 ] ) * ( y[ 2 ] - y[ 0 ] ) - ( x[ 2 ] - x[ 0 ] ) * ( y[ 1 ] - y[ 0 ] );
+      if( area <= 0 )
+	{
+	  continue;
+	}
+      int x0 = std::max( 0, static_cast< int >( floor( static_cast< double >( std::min( x[ 0 ], std::min( x[ 1 ], x[ 2 ] ) ) ) ) ) );
+      int x1 = std::min( static_cast< int >( resolution ) - 1, static_cast< int >( ceil( static_cast< double >( std::max( x[ 0 ], std::max( x[ 1 ], x[ 2 ] ) ) ) ) ) );
+      int y0 = std::max( 0, static_cast< int >( floor( static_cast< double >( std::min( y[ 0 ], std::min( y[ 1 ], y[ 2 ] ) ) ) ) ) );
+      int y1 = std::min( static_cast< int >( resolution ) - 1, static_cast< int >( ceil( static_cast< double >( std::max( y[ 0 ], std::max( y[ 1 ], y[ 2 ] ) ) ) ) ) );
+      for( int j = y0; j <= y1; ++j )
+	{
+	  for( int i = x0; i <= x1; ++i )
+	    {
+	      // sample at pixel centres
+	      T sx = i + static_cast< T >( 0.5 ), sy = j + static_cast< T >( 0.5 );
+	      T w0 = ( x[ 2 ] - x[ 1 ] ) * ( sy - y[ 1 ] ) - ( y[ 2 ] - y[ 1 ] ) * ( sx - x[ 1 ] );
+	      T w1 = ( x[ 0 ] - x[ 2 ] ) * ( sy - y[ 2 ] ) - ( y[ 0 ] - y[ 2 ] ) * ( sx - x[ 2 ] );
+	      T w2 = ( x[ 1 ] - x[ 0 ] ) * ( sy - y[ 0 ] ) - ( y[ 1 ] - y[ 0 ] ) * ( sx - x[ 0 ] );
+	      if( w0 < 0 || w1 < 0 || w2 < 0 )
+		{
+		  continue;
+		}
+	      T z0 = ( w0 * z[ 0 ] + w1 * z[ 1 ] + w2 * z[ 2 ] ) / area;
+	      unsigned int k = j * resolution + i;
+	      if( !written[ k ] || z0 < depth[ k ] )
+		{
+		  covered += written[ k ] ? 0 : 1;
+		  written[ k ] = 1;
+		  depth[ k ] = z0;
+		  ++shaded;
+		}
+	    }
+	}
+    }
+}
+
+typedef Mesh< float > MeshF;
+typedef Mesh< double > MeshD;
@@ -0,0 +1,289 @@
+#pragma once
+
+#include <cmath>
+#include <vector>
+#include "Vector2.h"
+#include "Vector3.h"
+#include "Vector3SoA.h"
+
+//! per-vertex and per-face attributes of indexed triangle meshes
+/*!
+  Triangles are three consecutive entries of the index buffer.
+  Vertex attributes are gathered per vertex through a vertex to corner
+  adjacency ( corner = 3 * triangle + k ), so every output element is
+  written by one thread only and no atomics are needed. Summation order
+  follows the triangle order, so results do not depend on thread count.
+*/
+template< typename T = double >
+struct MeshAttribute
+{
+  enum Weight
+    {
+      AREA,
+      ANGLE
+    };
+
+  // static function
+  /*!
+    @brief calculate unit face normals ( counter-clockwise front, zero for degenerate triangles )
+    @param normal triangleCount entries
+  */
+  static Vector3SoA< T > &faceNormals( Vector3SoA< T > &normal, const Vector3< T > *position, const unsigned int *index, unsigned int triangleCount );
+  /*!
+    @brief calculate interior angles at the corners of triangles
+    @param angle 3 * triangleCount entries
+  */
+  static void cornerAngles( T *angle, const Vector3< T > *position, const unsigned int *index, unsigned int triangleCount );
+  /*!
+    @brief build corners of each vertex in compressed rows
+    @param offset vertexCount + 1 entries, corners of vertex v are corner[ offset[ v ] ] .. corner[ offset[ v + 1 ] - 1 ]
+    @param corner 3 * triangleCount entries, ascending within a vertex
+  */
+  static void vertexCorners( unsigned int *offset, unsigned int *corner, const unsigned int *index, unsigned int triangleCount, unsigned int vertexCount );
+  /*!
+    @brief calculate unit vertex normals weighted by face area or corner angle
+    @param normal vertexCount entries ( zero for unreferenced vertices )
+  */
+  static Vector3SoA< T > &vertexNormals( Vector3SoA< T > &normal, const Vector3< T > *position, unsigned int vertexCount, const unsigned int *index, unsigned int triangleCount, Weight weight = AREA );
+  /*!
+    @brief calculate unit vertex tangents from texture coordinates ( MikkTSpace style )
+    @param tangent vertexCount entries, orthogonal to normal
+    @param sign vertexCount entries, bitangent = sign * cross( normal, tangent )
+    @param normal unit vertex normals
+    Per-face tangents are projected onto the vertex normal, normalized and
+    weighted by corner angle. Vertices are not split at uv seams or at
+    mirrored faces : weld the mesh accordingly before calling.
+  */
+  static void tangents( Vector3SoA< T > &tangent, T *sign, const Vector3< T > *position, const Vector2< T > *uv, const Vector3SoA< T > &normal, unsigned int vertexCount, const unsigned int *index, unsigned int triangleCount );
+  /*!
+    @brief normalize vectors in place ( zero vectors stay zero )
+  */
+  static void normalize( Vector3SoA< T > &v, unsigned int n );
+};
+
+//
+template< typename T >
+Vector3SoA< T > &MeshAttribute< T >::faceNormals( Vector3SoA< T > &normal, const Vector3< T > *position, const unsigned int *index, unsigned int triangleCount )
+{
+#ifdef _OPENMP
+#pragma omp parallel for if( triangleCount > 65536 )
+#endif
+  for( int i = 0; i < static_cast< int >( triangleCount ); ++i )
+    {
+      const Vector3< T > &p0 = position[ index[ i * 3 ] ];
+      const Vector3< T > &p1 = position[ index[ i * 3 + 1 ] ];
+      const Vector3< T > &p2 = position[ index[ i * 3 + 2 ] ];
+      T ax = p1.x - p0.x, ay = p1.y - p0.y, az = p1.z - p0.z;
+      T bx = p2.x - p0.x, by = p2.y - p0.y, bz = p2.z - p0.z;
+      normal.x[ i ] = ay * bz - az * by;
+      normal.y[ i ] = az * bx - ax * bz;
+      normal.z[ i ] = ax * by - ay * bx;
+    }
+  normalize( normal, triangleCount );
+  return normal;
+}
+
+//
+template< typename T >
+void MeshAttribute< T >::cornerAngles( T *angle, const Vector3< T > *position, const unsigned int *index, unsigned int triangleCount )
+{
+#ifdef _OPENMP
+#pragma omp parallel for if( triangleCount > 65536 )
+#endif
+  for( int i = 0; i < static_cast< int >( triangleCount ); ++i )
+    {
+      for( int k = 0; k < 3; ++k )
+	{
+	  const Vector3< T > &p = position[ index[ i * 3 + k ] ];
+	  const Vector3< T > &a = position[ index[ i * 3 + ( k + 1 ) % 3 ] ];
+	  const Vector3< T > &b = position[ index[ i * 3 + ( k + 2 ) % 3 ] ];
+	  T ax = a.x - p.x, ay = a.y - p.y, az = a.z - p.z;
+	  T bx = b.x - p.x, by = b.y - p.y, bz = b.z - p.z;
+	  T cx = ay * bz - az * by, cy = az * bx - ax * bz, cz = ax * by - ay * bx;
+	  // atan2 stays accurate for angles near 0 and pi where acos does not
+	  angle[ i * 3 + k ] = static_cast< T >( atan2( sqrt( static_cast< double >( cx * cx + cy * cy + cz * cz ) ), static_cast< double >( ax * bx + ay * by + az * bz ) ) );
+	}
+    }
+}
+
+//
+template< typename T >
+void MeshAttribute< T >::vertexCorners( unsigned int *offset, unsigned int *corner, const unsigned int *index, unsigned int triangleCount, unsigned int vertexCount )
+{
+  // counting sort of corners by vertex : sequential, but a single streaming pass each
+  for( unsigned int v = 0; v <= vertexCount; ++v )
+    {
+      offset[ v ] = 0;
+    }
+  for( unsigned int c = 0; c < triangleCount * 3; ++c )
+    {
+      ++offset[ index[ c ] + 1 ];
+    }
+  for( unsigned int v = 0; v < vertexCount; ++v )
+    {
+      offset[ v + 1 ] += offset[ v ];
+    }
+  for( unsigned int c = 0; c < triangleCount * 3; ++c )
+    {
+      corner[ offset[ index[ c ] ]++ ] = c;
+    }
+  // fill advanced every offset to the start of the next vertex
+  for( unsigned int v = vertexCount; v > 0; --v )
+    {
+      offset[ v ] = offset[ v - 1 ];
+    }
+  offset[ 0 ] = 0;
+}
+
+//
+template< typename T >
+Vector3SoA< T > &MeshAttribute< T >::vertexNormals( Vector3SoA< T > &normal, const Vector3< T > *position, unsigned int vertexCount, const unsigned int *index, unsigned int triangleCount, Weight weight )
+{
+  std::vector< unsigned int > offset( vertexCount + 1 ), corner( triangleCount * 3 + 1 );
+  vertexCorners( &offset[ 0 ], &corner[ 0 ], index, triangleCount, vertexCount );
+
+  std::vector< T > fx( triangleCount + 1 ), fy( triangleCount + 1 ), fz( triangleCount + 1 ), angle;
+  Vector3SoA< T > face( &fx[ 0 ], &fy[ 0 ], &fz[ 0 ] );
+  if( weight == ANGLE )
+    {
+      faceNormals( face, position, index, triangleCount );
+      angle.resize( triangleCount * 3 + 1 );
+      cornerAngles( &angle[ 0 ], position, index, triangleCount );
+    }
+  else
+    {
+      // twice the area times the unit normal
+#ifdef _OPENMP
+#pragma omp parallel for if( triangleCount > 65536 )
+#endif
+      for( int i = 0; i < static_cast< int >( triangleCount ); ++i )
+	{
+	  const Vector3< T > &p0 = position[ index[ i * 3 ] ];
+	  const Vector3< T > &p1 = position[ index[ i * 3 + 1 ] ];
+	  const Vector3< T > &p2 = position[ index[ i * 3 + 2 ] ];
+	  T ax = p1.x - p0.x, ay = p1.y - p0.y, az = p1.z - p0.z;
+	  T bx = p2.x - p0.x, by = p2.y - p0.y, bz = p2.z - p0.z;
+	  fx[ i ] = ay * bz - az * by;
+	  fy[ i ] = az * bx - ax * bz;
+	  fz[ i ] = ax * by - ay * bx;
+	}
+    }
+
+#ifdef _OPENMP
+#pragma omp parallel for if( vertexCount > 65536 )
+#endif
+  for( int v = 0; v < static_cast< int >( vertexCount ); ++v )
+    {
+      T x = 0, y = 0, z = 0;
+      for( unsigned int j = offset[ v ]; j < offset[ v + 1 ]; ++j )
+	{
+	  unsigned int c = corner[ j ], f = c / 3;
+	  T w = weight == ANGLE ? angle[ c ] : 1;
+	  x += fx[ f ] * w;
+	  y += fy[ f ] * w;
+	  z += fz[ f ] * w;
+	}
+      normal.x[ v ] = x;
+      normal.y[ v ] = y;
+      normal.z[ v ] = z;
+    }
+  normalize( normal, vertexCount );
+  return normal;
+}
+
+//
+template< typename T >
+void MeshAttribute< T >::tangents( Vector3SoA< T > &tangent, T *sign, const Vector3< T > *position, const Vector2< T > *uv, const Vector3SoA< T > &normal, unsigned int vertexCount, const unsigned int *index, unsigned int triangleCount )
+{
+  std::vector< unsigned int > offset( vertexCount + 1 ), corner( triangleCount * 3 + 1 );
+  vertexCorners( &offset[ 0 ], &corner[ 0 ], index, triangleCount, vertexCount );
+
+  std::vector< T > angle( triangleCount * 3 + 1 );
+  cornerAngles( &angle[ 0 ], position, index, triangleCount );
+
+  // unit directions of increasing u ( s ) and v ( t ) per face, zero where uv is degenerate
+  std::vector< T > sx( triangleCount + 1 ), sy( triangleCount + 1 ), sz( triangleCount + 1 );
+  std::vector< T > tx( triangleCount + 1 ), ty( triangleCount + 1 ), tz( triangleCount + 1 );
+#ifdef _OPENMP
+#pragma omp parallel for if( triangleCount > 65536 )
+#endif
+  for( int i = 0; i < static_cast< int >( triangleCount ); ++i )
+    {
+      unsigned int i0 = index[ i * 3 ], i1 = index[ i * 3 + 1 ], i2 = index[ i * 3 + 2 ];
+      const Vector3< T > &p0 = position[ i0 ];
+      T ax = position[ i1 ].x - p0.x, ay = position[ i1 ].y - p0.y, az = position[ i1 ].z - p0.z;
+      T bx = position[ i2 ].x - p0.x, by = position[ i2 ].y - p0.y, bz = position[ i2 ].z - p0.z;
+      T au = uv[ i1 ].x - uv[ i0 ].x, av = uv[ i1 ].y - uv[ i0 ].y;
+      T bu = uv[ i2 ].x - uv[ i0 ].x, bv = uv[ i2 ].y - uv[ i0 ].y;
+      // only the sign of the uv area matters once directions are normalized
+      T r = au * bv - bu * av;
+      T o = r > 0 ? 1 : ( r < 0 ? -1 : 0 );
+      sx[ i ] = ( ax * bv - bx * av ) * o;
+      sy[ i ] = ( ay * bv - by * av ) * o;
+      sz[ i ] = ( az * bv - bz * av ) * o;
+      tx[ i ] = ( bx * au - ax * bu ) * o;
+      ty[ i ] = ( by * au - ay * bu ) * o;
+      tz[ i ] = ( bz * au - az * bu ) * o;
+    }
+
+#ifdef _OPENMP
+#pragma omp parallel for if( vertexCount > 65536 )
+#endif
+  for( int v = 0; v < static_cast< int >( vertexCount ); ++v )
+    {
+      T nx = normal.x[ v ], ny = normal.y[ v ], nz = normal.z[ v ];
+      T x = 0, y = 0, z = 0, bx = 0, by = 0, bz = 0;
+      for( unsigned int j = offset[ v ]; j < offset[ v + 1 ]; ++j )
+	{
+	  unsigned int c = corner[ j ], f = c / 3;
+	  T d = sx[ f ] * nx + sy[ f ] * ny + sz[ f ] * nz;
+	  T px = sx[ f ] - nx * d, py = sy[ f ] - ny * d, pz = sz[ f ] - nz * d;
+	  T l = static_cast< T >( sqrt( static_cast< double >( px * px + py * py + pz * pz ) ) );
+	  T w = l > 0 ? angle[ c ] / l : 0;
+	  x += px * w;
+	  y += py * w;
+	  z += pz * w;
+	  d = tx[ f ] * nx + ty[ f ] * ny + tz[ f ] * nz;
+	  px = tx[ f ] - nx * d;
+	  py = ty[ f ] - ny * d;
+	  pz = tz[ f ] - nz * d;
+	  l = static_cast< T >( sqrt( static_cast< double >( px * px + py * py + pz * pz ) ) );
+	  w = l > 0 ? angle[ c ] / l : 0;
+	  bx += px * w;
+	  by += py * w;
+	  bz += pz * w;
+	}
+      // Gram-Schmidt against the vertex normal
+      T d = x * nx + y * ny + z * nz;
+      x -= nx * d;
+      y -= ny * d;
+      z -= nz * d;
+      tangent.x[ v ] = x;
+      tangent.y[ v ] = y;
+      tangent.z[ v ] = z;
+      T h = ( ny * z - nz * y ) * bx + ( nz * x - nx * z ) * by + ( nx * y - ny * x ) * bz;
+      sign[ v ] = h < 0 ? -1 : 1;
+    }
+  normalize( tangent, vertexCount );
+}
+
+//
+template< typename T >
+void MeshAttribute< T >::normalize( Vector3SoA< T > &v, unsigned int n )
+{
+  T *x = v.x, *y = v.y, *z = v.z;
+#ifdef _OPENMP
+#pragma omp parallel for if( n > 65536 )
+#endif
+  for( int i = 0; i < static_cast< int >( n ); ++i )
+    {
+      T l = static_cast< T >( sqrt( x[ i ] * x[ i ] + y[ i ] * y[ i ] + z[ i ] * z[ i ] ) );
+      T f = l > 0 ? 1 / l : 0;
+      x[ i ] *= f;
+      y[ i ] *= f;
+      z[ i ] *= f;
+    }
+}
+
+typedef MeshAttribute< float > MeshAttributeF;
+typedef MeshAttribute< double > MeshAttributeD;
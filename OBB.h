@@ -0,0 +1,425 @@
+#pragma once
+
+#include <cmath>
+#include <limits>
+#include <vector>
+#include <algorithm>
+#include "Vector2.h"
+#include "Vector3.h"
+#include "Vector3SoA.h"
+#include "Matrix4.h"
+#include "Quaternion.h"
+#include "Polygon2.h"
+#include "AABB.h"
+#include "Reduce.h"
+
+//! oriented bounding box
+/*!
+  The box spans center +- extent along the rows of the rotation matrix of
+  orientation ( row vectors, as Matrix4::rotationQuaternion ).
+  Fits run over soa points in parallel chunks of FIT_CHUNK, merged in chunk
+  order so that results do not depend on thread count.
+*/
+template< typename T = double >
+struct OBB
+{
+  OBB< T >();
+  OBB< T >( const OBB< T > & );
+  OBB< T >( const Vector3< T > &center, const Vector3< T > &extent, const Quaternion< T > &orientation );
+
+  OBB< T > &operator = ( const OBB< T > & );
+
+  /*!
+    @brief get unit axes of box ( right-handed )
+  */
+  void axes( Vector3< T > *axis ) const;
+  T volume() const;
+  bool contains( const Vector3< T > &p ) const;
+
+  // static function
+  /*!
+    @brief fit box of points to given orthonormal axes
+  */
+  static OBB< T > &fromAxes( OBB< T > &o, const Vector3< T > *axis, const Vector3SoA< T > &v, unsigned int n );
+  /*!
+    @brief fit box of points to principal axes of their covariance
+  */
+  static OBB< T > &pca( OBB< T > &o, const Vector3SoA< T > &v, unsigned int n );
+  /*!
+    @brief tighten box by minimum area rectangles
+    Each axis in turn is kept while the other two are turned to the minimum
+    area rectangle ( rotating calipers ) of the points projected along it.
+    The smallest of the boxes is kept, so volume never grows.
+  */
+  static OBB< T > &refine( OBB< T > &o, const OBB< T > &b, const Vector3SoA< T > &v, unsigned int n, unsigned int iterations = 2 );
+  /*!
+    @brief fit box of points ( pca, then refine )
+  */
+  static OBB< T > &fromPoints( OBB< T > &o, const Vector3SoA< T > &v, unsigned int n );
+  /*!
+    @brief calculate eigenvectors of symmetric 3x3 matrix ( Jacobi )
+    @param axis unit eigenvectors, right-handed, by decreasing eigenvalue
+    @param value eigenvalues ( may be 0 )
+    @param c xx, yy, zz, xy, xz, yz
+  */
+  static void eigen( Vector3< T > *axis, T *value, const T *c );
+
+  // number of points that a thread scans before merging
+  static const unsigned int FIT_CHUNK = 65536;
+
+  Vector3< T > center;
+  //! half size along each axis
+  Vector3< T > extent;
+  Quaternion< T > orientation;
+
+private:
+  static bool minimumRectangle( Vector2< T > &dir, const Vector2< T > *hull, unsigned int n );
+};
+
+//
+template< typename T >
+inline OBB< T >::OBB() : center( 0, 0, 0 ), extent( 0, 0, 0 ), orientation( 0, 0, 0, 1 )
+{
+}
+
+//
+template< typename T >
+inline OBB< T >::OBB( const OBB< T > &b ) : center( b.center ), extent( b.extent ), orientation( b.orientation )
+{
+}
+
+//
+template< typename T >
+inline OBB< T >::OBB( const Vector3< T > &c, const Vector3< T > &e, const Quaternion< T > &q ) : center( c ), extent( e ), orientation( q )
+{
+}
+
+//
+template< typename T >
+inline OBB< T > &OBB< T >::operator = ( const OBB< T > &b )
+{
+  center = b.center;
+  extent = b.extent;
+  orientation = b.orientation;
+  return *this;
+}
+
+//
+template< typename T >
+inline void OBB< T >::axes( Vector3< T > *axis ) const
+{
+  Matrix4< T > m;
+  Matrix4< T >::rotationQuaternion( m, orientation );
+  axis[ 0 ] = Vector3< T >( m._11, m._12, m._13 );
+  axis[ 1 ] = Vector3< T >( m._21, m._22, m._23 );
+  axis[ 2 ] = Vector3< T >( m._31, m._32, m._33 );
+}
+
+//
+template< typename T >
+inline T OBB< T >::volume() const
+{
+  return 8 * extent.x * extent.y * extent.z;
+}
+
+//
+template< typename T >
+inline bool OBB< T >::contains( const Vector3< T > &p ) const
+{
+  Vector3< T > a[ 3 ];
+  axes( a );
+  Vector3< T > d = p - center;
+  return fabs( static_cast< double >( Vector3< T >::dot( d, a[ 0 ] ) ) ) <= extent.x
+    && fabs( static_cast< double >( Vector3< T >::dot( d, a[ 1 ] ) ) ) <= extent.y
+    && fabs( static_cast< double >( Vector3< T >::dot( d, a[ 2 ] ) ) ) <= extent.z;
+}
+
+//
+template< typename T >
+OBB< T > &OBB< T >::fromAxes( OBB< T > &o, const Vector3< T > *axis, const Vector3SoA< T > &v, unsigned int n )
+{
+  const unsigned int BLOCK = 256;
+  int chunks = static_cast< int >( ( n + FIT_CHUNK - 1 ) / FIT_CHUNK );
+  std::vector< AABB< T > > part( chunks );
+  const Vector3< T > a0 = axis[ 0 ], a1 = axis[ 1 ], a2 = axis[ 2 ];
+
+#ifdef _OPENMP
+#pragma omp parallel for if( chunks > 1 )
+#endif
+  for( int c = 0; c < chunks; ++c )
+    {
+      unsigned int begin = c * FIT_CHUNK;
+      unsigned int end = std::min( begin + FIT_CHUNK, n );
+      AABB< T > &b = part[ c ];
+      T p0[ BLOCK ], p1[ BLOCK ], p2[ BLOCK ];
+      for( unsigned int i = begin; i < end; i += BLOCK )
+	{
+	  unsigned int k = std::min( BLOCK, end - i );
+	  const T *x = v.x + i, *y = v.y + i, *z = v.z + i;
+	  for( unsigned int j = 0; j < k; ++j )
+	    {
+	      p0[ j ] = x[ j ] * a0.x + y[ j ] * a0.y + z[ j ] * a0.z;
+	      p1[ j ] = x[ j ] * a1.x + y[ j ] * a1.y + z[ j ] * a1.z;
+	      p2[ j ] = x[ j ] * a2.x + y[ j ] * a2.y + z[ j ] * a2.z;
+	    }
+	  AABB< T >::reduce( b.min.x, b.max.x, p0, k );
+	  AABB< T >::reduce( b.min.y, b.max.y, p1, k );
+	  AABB< T >::reduce( b.min.z, b.max.z, p2, k );
+	}
+    }
+
+  // box in the frame of the axes
+  AABB< T > b;
+  for( int c = 0; c < chunks; ++c )
+    {
+      b.extend( part[ c ] );
+    }
+  if( b.empty() )
+    {
+      b = AABB< T >( Vector3< T >( 0, 0, 0 ), Vector3< T >( 0, 0, 0 ) );
+    }
+  Vector3< T > m = b.center();
+  o.center = a0 * m.x + a1 * m.y + a2 * m.z;
+  o.extent = b.extent();
+  Matrix4< T > r( a0.x, a0.y, a0.z, 0,
+		  a1.x, a1.y, a1.z, 0,
+		  a2.x, a2.y, a2.z, 0,
+		  0, 0, 0, 1 );
+  Quaternion< T >::fromMatrix( o.orientation, r );
+  return o;
+}
+
+//
+template< typename T >
+void OBB< T >::eigen( Vector3< T > *axis, T *value, const T *c )
+{
+  double a[ 3 ][ 3 ] = { { c[ 0 ], c[ 3 ], c[ 4 ] }, { c[ 3 ], c[ 1 ], c[ 5 ] }, { c[ 4 ], c[ 5 ], c[ 2 ] } };
+  double q[ 3 ][ 3 ] = { { 1, 0, 0 }, { 0, 1, 0 }, { 0, 0, 1 } };
+  // cyclic Jacobi : each rotation zeroes one off-diagonal element
+  for( int sweep = 0; sweep < 32; ++sweep )
+    {
+      double off = a[ 0 ][ 1 ] * a[ 0 ][ 1 ] + a[ 0 ][ 2 ] * a[ 0 ][ 2 ] + a[ 1 ][ 2 ] * a[ 1 ][ 2 ];
+      double diag = a[ 0 ][ 0 ] * a[ 0 ][ 0 ] + a[ 1 ][ 1 ] * a[ 1 ][ 1 ] + a[ 2 ][ 2 ] * a[ 2 ][ 2 ];
+      if( off <= diag * 1e-30 || off == 0 )
+	{
+	  break;
+	}
+      for( int p = 0; p < 2; ++p )
+	{
+	  for( int r = p + 1; r < 3; ++r )
+	    {
+	      if( a[ p ][ r ] == 0 )
+		{
+		  continue;
+		}
+	      double theta = ( a[ r ][ r ] - a[ p ][ p ] ) / ( 2 * a[ p ][ r ] );
+	      double t = ( theta >= 0 ? 1 : -1 ) / ( fabs( theta ) + sqrt( theta * theta + 1 ) );
+	      double cs = 1 / sqrt( t * t + 1 ), sn = t * cs;
+	      for( int k = 0; k < 3; ++k )
+		{
+		  double akp = a[ k ][ p ], akr = a[ k ][ r ];
+		  a[ k ][ p ] = cs * akp - sn * akr;
+		  a[ k ][ r ] = sn * akp + cs * akr;
+		}
+	      for( int k = 0; k < 3; ++k )
+		{
+		  double apk = a[ p ][ k ], ark = a[ r ][ k ];
+		  a[ p ][ k ] = cs * apk - sn * ark;
+		  a[ r ][ k ] = sn * apk + cs * ark;
+		}
+	      for( int k = 0; k < 3; ++k )
+		{
+		  double qkp = q[ k ][ p ], qkr = q[ k ][ r ];
+		  q[ k ][ p ] = cs * qkp - sn * qkr;
+		  q[ k ][ r ] = sn * qkp + cs * qkr;
+		}
+	    }
+	}
+    }
+
+  int order[ 3 ] = { 0, 1, 2 };
+  for( int i = 0; i < 2; ++i )
+    {
+      for( int j = i + 1; j < 3; ++j )
+	{
+	  if( a[ order[ j ] ][ order[ j ] ] > a[ order[ i ] ][ order[ i ] ] )
+	    {
+	      std::swap( order[ i ], order[ j ] );
+	    }
+	}
+    }
+  for( int i = 0; i < 3; ++i )
+    {
+      int k = order[ i ];
+      value[ i ] = static_cast< T >( a[ k ][ k ] );
+      axis[ i ] = Vector3< T >( static_cast< T >( q[ 0 ][ k ] ), static_cast< T >( q[ 1 ][ k ] ), static_cast< T >( q[ 2 ][ k ] ) );
+    }
+  Vector3< T >::normalize( axis[ 0 ], axis[ 0 ] );
+  Vector3< T >::normalize( axis[ 1 ], axis[ 1 ] );
+  Vector3< T >::cross( axis[ 2 ], axis[ 0 ], axis[ 1 ] );
+}
+
+//
+template< typename T >
+OBB< T > &OBB< T >::pca( OBB< T > &o, const Vector3SoA< T > &v, unsigned int n )
+{
+  T cov[ 6 ];
+  Reduce< T >::covariance( cov, 0, v, n );
+  Vector3< T > axis[ 3 ];
+  T value[ 3 ];
+  eigen( axis, value, cov );
+  return fromAxes( o, axis, v, n );
+}
+
+//
+template< typename T >
+bool OBB< T >::minimumRectangle( Vector2< T > &dir, const Vector2< T > *hull, unsigned int n )
+{
+  if( n < 3 )
+    {
+      return false;
+    }
+  // rotating calipers over a counter-clockwise hull : for each edge the
+  // extreme points along it and away from it only move forward
+  unsigned int right = 0, top = 0, left = 0;
+  T best = std::numeric_limits< T >::max();
+  for( unsigned int i = 0; i < n; ++i )
+    {
+      const Vector2< T > &p = hull[ i ];
+      Vector2< T > e = hull[ ( i + 1 ) % n ] - p;
+      T l = Vector2< T >::length( e );
+      if( l <= 0 )
+	{
+	  continue;
+	}
+      e /= l;
+      Vector2< T > nrm( -e.y, e.x );
+      if( i == 0 )
+	{
+	  for( unsigned int k = 1; k < n; ++k )
+	    {
+	      Vector2< T > d = hull[ k ] - p;
+	      right = Vector2< T >::dot( d, e ) > Vector2< T >::dot( hull[ right ] - p, e ) ? k : right;
+	      top = Vector2< T >::dot( d, nrm ) > Vector2< T >::dot( hull[ top ] - p, nrm ) ? k : top;
+	      left = Vector2< T >::dot( d, e ) < Vector2< T >::dot( hull[ left ] - p, e ) ? k : left;
+	    }
+	}
+      else
+	{
+	  for( unsigned int k = 0; k < n && Vector2< T >::dot( hull[ ( right + 1 ) % n ] - p, e ) >= Vector2< T >::dot( hull[ right ] - p, e ); ++k )
+	    {
+	      right = ( right + 1 ) % n;
+	    }
+	  for( unsigned int k = 0; k < n && Vector2< T >::dot( hull[ ( top + 1 ) % n ] - p, nrm ) >= Vector2< T >::dot( hull[ top ] - p, nrm ); ++k )
+	    {
+	      top = ( top + 1 ) % n;
+	    }
+	  for( unsigned int k = 0; k < n && Vector2< T >::dot( hull[ ( left + 1 ) % n ] - p, e ) <= Vector2< T >::dot( hull[ left ] - p, e ); ++k )
+	    {
+	      left = ( left + 1 ) % n;
+	    }
+	}
+      T area = ( Vector2< T >::dot( hull[ right ] - p, e ) - Vector2< T >::dot( hull[ left ] - p, e ) ) * Vector2< T >::dot( hull[ top ] - p, nrm );
+      if( area < best )
+	{
+	  best = area;
+	  dir = e;
+	}
+    }
+  return best < std::numeric_limits< T >::max();
+}
+
+//
+template< typename T >
+OBB< T > &OBB< T >::refine( OBB< T > &o, const OBB< T > &b, const Vector3SoA< T > &v, unsigned int n, unsigned int iterations )
+{
+  OBB< T > best( b );
+  std::vector< Vector2< T > > p( n + 1 ), hull( n + 1 );
+  for( unsigned int it = 0; it < iterations; ++it )
+    {
+      OBB< T > start( best );
+      Vector3< T > a[ 3 ];
+      start.axes( a );
+      for( int k = 0; k < 3; ++k )
+	{
+	  const Vector3< T > u = a[ ( k + 1 ) % 3 ], w = a[ ( k + 2 ) % 3 ];
+#ifdef _OPENMP
+#pragma omp parallel for if( n > 65536 )
+#endif
+	  for( int i = 0; i < static_cast< int >( n ); ++i )
+	    {
+	      p[ i ].x = v.x[ i ] * u.x + v.y[ i ] * u.y + v.z[ i ] * u.z;
+	      p[ i ].y = v.x[ i ] * w.x + v.y[ i ] * w.y + v.z[ i ] * w.z;
+	    }
+	  // Akl-Toussaint : points strictly inside the quadrilateral of the
+	  // extremes along u and w cannot be on the hull
+	  unsigned int e[ 4 ] = { 0, 0, 0, 0 };
+	  for( unsigned int i = 1; i < n; ++i )
+	    {
+	      e[ 0 ] = p[ i ].y < p[ e[ 0 ] ].y ? i : e[ 0 ];
+	      e[ 1 ] = p[ i ].x > p[ e[ 1 ] ].x ? i : e[ 1 ];
+	      e[ 2 ] = p[ i ].y > p[ e[ 2 ] ].y ? i : e[ 2 ];
+	      e[ 3 ] = p[ i ].x < p[ e[ 3 ] ].x ? i : e[ 3 ];
+	    }
+	  unsigned int m = 0;
+	  for( unsigned int i = 0; i < n; ++i )
+	    {
+	      bool inside = true;
+	      for( int j = 0; j < 4; ++j )
+		{
+		  inside = inside && Vector2< T >::ccw( p[ e[ ( j + 1 ) % 4 ] ] - p[ e[ j ] ], p[ i ] - p[ e[ j ] ] ) > 0;
+		}
+	      if( !inside )
+		{
+		  p[ m++ ] = p[ i ];
+		}
+	    }
+	  unsigned int h = m ? Polygon2< T >::convexHull( &hull[ 0 ], &p[ 0 ], m ) : 0;
+	  Vector2< T > d;
+	  if( !minimumRectangle( d, &hull[ 0 ], h ) )
+	    {
+	      continue;
+	    }
+	  // turn u, w within their plane so that u follows the rectangle edge
+	  Vector3< T > axis[ 3 ];
+	  axis[ 0 ] = a[ k ];
+	  axis[ 1 ] = u * d.x + w * d.y;
+	  Vector3< T >::normalize( axis[ 1 ], axis[ 1 ] );
+	  Vector3< T >::cross( axis[ 2 ], axis[ 0 ], axis[ 1 ] );
+	  OBB< T > c;
+	  fromAxes( c, axis, v, n );
+	  if( c.volume() < best.volume() )
+	    {
+	      best = c;
+	    }
+	}
+      if( !( best.volume() < start.volume() ) )
+	{
+	  break;
+	}
+    }
+  o = best;
+  return o;
+}
+
+//
+template< typename T >
+OBB< T > &OBB< T >::fromPoints( OBB< T > &o, const Vector3SoA< T > &v, unsigned int n )
+{
+  OBB< T > b;
+  pca( b, v, n );
+  return refine( o, b, v, n );
+}
+
+/*!
+  output stream
+*/
+template< typename T >
+std::ostream &operator<<( std::ostream &os, const OBB< T > &b )
+{
+  os << b.center << ", " << b.extent << ", " << b.orientation;
+  return os;
+}
+
+typedef OBB< float > OBBF;
+typedef OBB< double > OBBD;
@@ -1,9 +1,12 @@
 #pragma once
 
 #include <cmath>
+#include <limits>
+#include <algorithm>
 
 template< typename T > struct Vector3;
 template< typename T > struct Vector4;
+template< typename T > struct Vector3SoA;
 
 //! Plane
 template< typename T = double >
@@ -42,6 +45,11 @@ struct Plane
     @brief calculate intersection between ray and plane
   */
   static bool intersectLine( Vector3< T > &pos, const Plane< T > &plane, const Vector3< T > &start, const Vector3< T > &dir, T *dist = 0 );
+  /*!
+    @brief calculate intersections between rays and plane
+    @param hit 1 if ray hits plane within [ tmin, tmax ], otherwise 0 ( pos is start )
+  */
+  static void intersectLine( unsigned char *hit, Vector3SoA< T > &pos, const Plane< T > &plane, const Vector3SoA< T > &start, const Vector3SoA< T > &dir, unsigned int n, T *dist = 0, T tmin = -std::numeric_limits< T >::max(), T tmax = std::numeric_limits< T >::max() );
   /*!
     @brief calucalate inner product
   */
@@ -54,6 +62,30 @@ struct Plane
     @brief calucalate inner product
   */
   static T dotNormal( const Plane< T > &plane, const Vector3< T > &v );
+  /*!
+    @brief calculate signed distances of points
+  */
+  static void dot( T *dist, const Plane< T > &plane, const Vector3< T > *v, unsigned int n );
+  /*!
+    @brief classify points as FRONT, BACK or ON
+  */
+  static void classify( unsigned char *side, const Plane< T > &plane, const Vector3< T > *v, unsigned int n, T epsilon = 0 );
+  /*!
+    @brief classify points against planes
+    @param front bit p % 32 of word p / 32 is set if the point is in front of planes[ p ]
+    @param back bit p % 32 of word p / 32 is set if the point is behind planes[ p ]
+
+    Each point has one word in front and back for up to 32 planes and
+    ( planeCount + 31 ) / 32 consecutive words beyond.
+  */
+  static void classify( unsigned int *front, unsigned int *back, const Plane< T > *planes, unsigned int planeCount, const Vector3< T > *v, unsigned int n, T epsilon = 0 );
+
+  enum Side
+    {
+      ON = 0,
+      FRONT = 1,
+      BACK = 2
+    };
   
   union
   {
@@ -165,6 +197,7 @@ inline bool Plane< T >::operator !=( const Plane< T > &p ) const
 }
 
 #include "Vector3.h"
+#include "Vector3SoA.h"
 
 
 //
@@ -213,6 +246,67 @@ bool Plane< T >::intersectLine( Vector3< T > &pos, const Plane< T > &plane, cons
   return true;
 }
 
+//
+template< typename T >
+void Plane< T >::intersectLine( unsigned char *hit, Vector3SoA< T > &pos, const Plane< T > &plane, const Vector3SoA< T > &org, const Vector3SoA< T > &dir, unsigned int n, T *dist, T tmin, T tmax )
+{
+  const T a = plane.a, b = plane.b, c = plane.c, d = plane.d;
+  const T *ox = org.x, *oy = org.y, *oz = org.z;
+  const T *dx = dir.x, *dy = dir.y, *dz = dir.z;
+  T *px = pos.x, *py = pos.y, *pz = pos.z;
+  const int B = 256;
+  int blocks = static_cast< int >( ( n + B - 1 ) / B );
+
+#ifdef _OPENMP
+#pragma omp parallel for if( n > 65536 )
+#endif
+  for( int blk = 0; blk < blocks; ++blk )
+    {
+      int begin = blk * B;
+      int m = std::min( B, static_cast< int >( n ) - begin );
+
+      // branch free and through local buffers so that every loop vectorizes :
+      // parallel rays are masked out instead of skipped
+      T t[ B ];
+      unsigned char h[ B ];
+      for( int k = 0; k < m; ++k )
+	{
+	  int i = begin + k;
+	  T cs = a * dx[ i ] + b * dy[ i ] + c * dz[ i ];
+	  T ds = a * ox[ i ] + b * oy[ i ] + c * oz[ i ] + d;
+	  bool parallel = ( cs == 0 );
+	  T s = -ds / ( parallel ? 1 : cs );
+	  bool in = !parallel && s >= tmin && s <= tmax;
+	  t[ k ] = in ? s : 0;
+	  h[ k ] = in;
+	}
+
+      for( int k = 0; k < m; ++k )
+	{
+	  px[ begin + k ] = ox[ begin + k ] + dx[ begin + k ] * t[ k ];
+	}
+      for( int k = 0; k < m; ++k )
+	{
+	  py[ begin + k ] = oy[ begin + k ] + dy[ begin + k ] * t[ k ];
+	}
+      for( int k = 0; k < m; ++k )
+	{
+	  pz[ begin + k ] = oz[ begin + k ] + dz[ begin + k ] * t[ k ];
+	}
+      for( int k = 0; k < m; ++k )
+	{
+	  hit[ begin + k ] = h[ k ];
+	}
+      if( dist )
+	{
+	  for( int k = 0; k < m; ++k )
+	    {
+	      dist[ begin + k ] = t[ k ];
+	    }
+	}
+    }
+}
+
 //
 template< typename T >
 T Plane< T >::dot( const Plane< T > &plane, const Vector4< T > &v )
@@ -234,6 +328,63 @@ T Plane< T >::dotNormal( const Plane< T > &plane, const Vector3< T > &v )
   return plane.a * v.x + plane.b * v.y + plane.c * v.z;
 }
 
+//
+template< typename T >
+void Plane< T >::dot( T *dist, const Plane< T > &plane, const Vector3< T > *v, unsigned int n )
+{
+  const T a = plane.a, b = plane.b, c = plane.c, d = plane.d;
+#ifdef _OPENMP
+#pragma omp parallel for if( n > 65536 )
+#endif
+  for( int i = 0; i < static_cast< int >( n ); ++i )
+    {
+      dist[ i ] = a * v[ i ].x + b * v[ i ].y + c * v[ i ].z + d;
+    }
+}
+
+//
+template< typename T >
+void Plane< T >::classify( unsigned char *side, const Plane< T > &plane, const Vector3< T > *v, unsigned int n, T epsilon )
+{
+  const T a = plane.a, b = plane.b, c = plane.c, d = plane.d;
+#ifdef _OPENMP
+#pragma omp parallel for if( n > 65536 )
+#endif
+  for( int i = 0; i < static_cast< int >( n ); ++i )
+    {
+      T t = a * v[ i ].x + b * v[ i ].y + c * v[ i ].z + d;
+      side[ i ] = static_cast< unsigned char >( ( t > epsilon ) * FRONT + ( t < -epsilon ) * BACK );
+    }
+}
+
+//
+template< typename T >
+void Plane< T >::classify( unsigned int *front, unsigned int *back, const Plane< T > *planes, unsigned int planeCount, const Vector3< T > *v, unsigned int n, T epsilon )
+{
+  const unsigned int words = planeCount > 32 ? ( planeCount + 31 ) / 32 : 1;
+  for( unsigned int i = 0; i < n * words; ++i )
+    {
+      front[ i ] = back[ i ] = 0;
+    }
+
+  // planes outside so that the point loop keeps the plane in registers
+  for( unsigned int p = 0; p < planeCount; ++p )
+    {
+      const T a = planes[ p ].a, b = planes[ p ].b, c = planes[ p ].c, d = planes[ p ].d;
+      unsigned int *f = front + p / 32, *k = back + p / 32;
+      const unsigned int bit = p % 32;
+#ifdef _OPENMP
+#pragma omp parallel for if( n > 65536 )
+#endif
+      for( int i = 0; i < static_cast< int >( n ); ++i )
+	{
+	  T t = a * v[ i ].x + b * v[ i ].y + c * v[ i ].z + d;
+	  f[ i * words ] |= static_cast< unsigned int >( t > epsilon ) << bit;
+	  k[ i * words ] |= static_cast< unsigned int >( t < -epsilon ) << bit;
+	}
+    }
+}
+
 /*!
   output stream
 */
@@ -0,0 +1,253 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include "Vector2.h"
+
+//! 2D polygon algorithms over arrays of Vector2
+template< typename T = double >
+struct Polygon2
+{
+  // static function
+  /*!
+    @brief calculate convex hull (monotone chain)
+    @return number of hull vertices written to hull (counter-clockwise)
+  */
+  static unsigned int convexHull( Vector2< T > *hull, const Vector2< T > *v, unsigned int n );
+  /*!
+    @brief calculate signed area (positive for counter-clockwise polygon)
+  */
+  static T area( const Vector2< T > *poly, unsigned int n );
+  /*!
+    @brief calculate centroid of polygon
+  */
+  static Vector2< T > &centroid( Vector2< T > &c, const Vector2< T > *poly, unsigned int n );
+  /*!
+    @brief test whether point is inside polygon (crossing number)
+  */
+  static bool contains( const Vector2< T > *poly, unsigned int n, const Vector2< T > &p );
+  /*!
+    @brief test whether points are inside polygon (crossing number)
+    @param inside 1 if points[ i ] is inside, otherwise 0
+  */
+  static void contains( unsigned char *inside, const Vector2< T > *points, unsigned int count, const Vector2< T > *poly, unsigned int n );
+
+  // number of points that a thread computes the hull of before merging
+  static const unsigned int HULL_CHUNK = 65536;
+  // number of points tested against all edges at once
+  static const unsigned int CONTAINS_BLOCK = 256;
+
+private:
+  static bool less( const Vector2< T > &v1, const Vector2< T > &v2 );
+  static unsigned int monotoneChain( Vector2< T > *hull, std::vector< Vector2< T > > &v );
+};
+
+//
+template< typename T >
+inline bool Polygon2< T >::less( const Vector2< T > &v1, const Vector2< T > &v2 )
+{
+  return ( v1.x < v2.x || ( v1.x == v2.x && v1.y < v2.y ) );
+}
+
+//
+template< typename T >
+unsigned int Polygon2< T >::monotoneChain( Vector2< T > *hull, std::vector< Vector2< T > > &v )
+{
+  std::sort( v.begin(), v.end(), less );
+
+  unsigned int n = static_cast< unsigned int >( v.size() );
+  if( n < 3 )
+    {
+      for( unsigned int i = 0; i < n; ++i )
+	{
+	  hull[ i ] = v[ i ];
+	}
+      return n;
+    }
+
+  std::vector< Vector2< T > > h( 2 * n );
+  unsigned int k = 0;
+
+  // lower hull
+  for( unsigned int i = 0; i < n; ++i )
+    {
+      while( k >= 2 && Vector2< T >::ccw( h[ k - 1 ] - h[ k - 2 ], v[ i ] - h[ k - 2 ] ) <= 0 )
+	{
+	  --k;
+	}
+      h[ k++ ] = v[ i ];
+    }
+
+  // upper hull
+  for( unsigned int i = n - 1, t = k + 1; i > 0; --i )
+    {
+      while( k >= t && Vector2< T >::ccw( h[ k - 1 ] - h[ k - 2 ], v[ i - 1 ] - h[ k - 2 ] ) <= 0 )
+	{
+	  --k;
+	}
+      h[ k++ ] = v[ i - 1 ];
+    }
+
+  // last point is equal to the first one
+  --k;
+  for( unsigned int i = 0; i < k; ++i )
+    {
+      hull[ i ] = h[ i ];
+    }
+  return k;
+}
+
+//
+template< typename T >
+unsigned int Polygon2< T >::convexHull( Vector2< T > *hull, const Vector2< T > *v, unsigned int n )
+{
+  if( n <= HULL_CHUNK )
+    {
+      std::vector< Vector2< T > > t( v, v + n );
+      return monotoneChain( hull, t );
+    }
+
+  // the hull of the union is the hull of the chunk hulls
+  int chunks = static_cast< int >( ( n + HULL_CHUNK - 1 ) / HULL_CHUNK );
+  std::vector< std::vector< Vector2< T > > > part( chunks );
+
+#ifdef _OPENMP
+#pragma omp parallel for schedule( dynamic )
+#endif
+  for( int c = 0; c < chunks; ++c )
+    {
+      unsigned int begin = c * HULL_CHUNK;
+      unsigned int end = std::min( begin + HULL_CHUNK, n );
+      std::vector< Vector2< T > > t( v + begin, v + end );
+      part[ c ].resize( end - begin );
+      part[ c ].resize( monotoneChain( &part[ c ][ 0 ], t ) );
+    }
+
+  std::vector< Vector2< T > > t;
+  for( int c = 0; c < chunks; ++c )
+    {
+      t.insert( t.end(), part[ c ].begin(), part[ c ].end() );
+    }
+  return monotoneChain( hull, t );
+}
+
+//
+template< typename T >
+T Polygon2< T >::area( const Vector2< T > *poly, unsigned int n )
+{
+  if( n < 3 )
+    {
+      return 0;
+    }
+
+  T s = Vector2< T >::ccw( poly[ n - 1 ], poly[ 0 ] );
+  for( unsigned int i = 1; i < n; ++i )
+    {
+      s += Vector2< T >::ccw( poly[ i - 1 ], poly[ i ] );
+    }
+  return s / 2;
+}
+
+//
+template< typename T >
+Vector2< T > &Polygon2< T >::centroid( Vector2< T > &c, const Vector2< T > *poly, unsigned int n )
+{
+  if( n == 0 )
+    {
+      c = Vector2< T >();
+      return c;
+    }
+
+  T s = 0, cx = 0, cy = 0;
+  for( unsigned int i = 0, j = n - 1; i < n; j = i++ )
+    {
+      T a = Vector2< T >::ccw( poly[ j ], poly[ i ] );
+      s += a;
+      cx += ( poly[ j ].x + poly[ i ].x ) * a;
+      cy += ( poly[ j ].y + poly[ i ].y ) * a;
+    }
+
+  if( s == 0 )
+    {
+      // degenerate polygon : use average of vertices
+      Vector2< T > t;
+      for( unsigned int i = 0; i < n; ++i )
+	{
+	  t += poly[ i ];
+	}
+      c = t / static_cast< T >( n );
+      return c;
+    }
+
+  c = Vector2< T >( cx / ( 3 * s ), cy / ( 3 * s ) );
+  return c;
+}
+
+//
+template< typename T >
+bool Polygon2< T >::contains( const Vector2< T > *poly, unsigned int n, const Vector2< T > &p )
+{
+  bool inside = false;
+  for( unsigned int i = 0, j = n - 1; i < n; j = i++ )
+    {
+      const Vector2< T > &a = poly[ j ];
+      const Vector2< T > &b = poly[ i ];
+      T d = ( b.x - a.x ) * ( p.y - a.y ) - ( p.x - a.x ) * ( b.y - a.y );
+      if( ( ( a.y > p.y ) != ( b.y > p.y ) ) && ( ( d > 0 ) == ( b.y > a.y ) ) )
+	{
+	  inside = !inside;
+	}
+    }
+  return inside;
+}
+
+//
+template< typename T >
+void Polygon2< T >::contains( unsigned char *inside, const Vector2< T > *points, unsigned int count, const Vector2< T > *poly, unsigned int n )
+{
+  int blocks = static_cast< int >( ( count + CONTAINS_BLOCK - 1 ) / CONTAINS_BLOCK );
+
+#ifdef _OPENMP
+#pragma omp parallel for
+#endif
+  for( int b = 0; b < blocks; ++b )
+    {
+      unsigned int begin = b * CONTAINS_BLOCK;
+      unsigned int end = std::min( begin + CONTAINS_BLOCK, count );
+
+      T px[ CONTAINS_BLOCK ], py[ CONTAINS_BLOCK ];
+      unsigned char c[ CONTAINS_BLOCK ];
+      unsigned int m = end - begin;
+      for( unsigned int k = 0; k < m; ++k )
+	{
+	  px[ k ] = points[ begin + k ].x;
+	  py[ k ] = points[ begin + k ].y;
+	  c[ k ] = 0;
+	}
+
+      // edges outside, points inside : branch free body vectorizes over points
+      for( unsigned int i = 0, j = n - 1; i < n; j = i++ )
+	{
+	  T ax = poly[ j ].x, ay = poly[ j ].y;
+	  T ex = poly[ i ].x - ax, ey = poly[ i ].y - ay;
+	  T by = poly[ i ].y;
+	  unsigned char up = ( by > ay );
+	  for( unsigned int k = 0; k < m; ++k )
+	    {
+	      T d = ex * ( py[ k ] - ay ) - ( px[ k ] - ax ) * ey;
+	      unsigned char straddle = ( ay > py[ k ] ) ^ ( by > py[ k ] );
+	      unsigned char side = ( d > 0 ) ^ up ^ 1;
+	      c[ k ] ^= straddle & side;
+	    }
+	}
+
+      for( unsigned int k = 0; k < m; ++k )
+	{
+	  inside[ begin + k ] = c[ k ];
+	}
+    }
+}
+
+typedef Polygon2< int > Polygon2I;
+typedef Polygon2< float > Polygon2F;
+typedef Polygon2< double > Polygon2D;
@@ -0,0 +1,330 @@
+#pragma once
+
+#include <cmath>
+#include "Vector3.h"
+#include "Matrix4.h"
+
+//! accumulation type of Precise
+/*!
+  float is accumulated in double. double is accumulated in long double,
+  which is the 80-bit extended type on x86 compilers that support it
+  and plain double otherwise ( compensated algorithms still apply ).
+*/
+template< typename T >
+struct PreciseTraits
+{
+  typedef T Accum;
+};
+
+template<>
+struct PreciseTraits< float >
+{
+  typedef double Accum;
+};
+
+template<>
+struct PreciseTraits< double >
+{
+  typedef long double Accum;
+};
+
+//! accuracy preserving kernels for float / double storage
+/*!
+  Results are rounded to T only once at the end, so data can stay in
+  T while keeping the accuracy of the accumulation type.
+*/
+template< typename T = float >
+struct Precise
+{
+  typedef typename PreciseTraits< T >::Accum Accum;
+
+  // static function
+  /*!
+    @brief error free product ( a * b = p + e )
+  */
+  static void twoProduct( Accum &p, Accum &e, Accum a, Accum b );
+  /*!
+    @brief error free sum ( a + b = s + e )
+  */
+  static void twoSum( Accum &s, Accum &e, Accum a, Accum b );
+  /*!
+    @brief calculate a * b - c * d with one rounding error (Kahan)
+  */
+  static T diffOfProducts( T a, T b, T c, T d );
+  /*!
+    @brief calculate sum of array (pairwise)
+  */
+  static T sum( const T *v, unsigned int n );
+  /*!
+    @brief calculate inner product of arrays (compensated)
+  */
+  static T dot( const T *v1, const T *v2, unsigned int n );
+  /*!
+    @brief calculate inner product
+  */
+  static T dot( const Vector3< T > &v1, const Vector3< T > &v2 );
+  /*!
+    @brief calculate inner products of arrays of vectors
+  */
+  static void dot( T *out, const Vector3< T > *v1, const Vector3< T > *v2, unsigned int n );
+  /*!
+    @brief calculate length
+  */
+  static T length( const Vector3< T > &v );
+  /*!
+    @brief calculate lengths of array of vectors
+  */
+  static void length( T *out, const Vector3< T > *v, unsigned int n );
+  /*!
+    @brief normalize vector
+  */
+  static Vector3< T > &normalize( Vector3< T > &v, const Vector3< T > &v0 );
+  /*!
+    @brief calculate sum of array of vectors (pairwise)
+  */
+  static Vector3< T > &sum( Vector3< T > &s, const Vector3< T > *v, unsigned int n );
+  /*!
+    @brief calculate determinant
+  */
+  static T determinant( const Matrix4< T > &m );
+  /*!
+    @brief calculate inverse matrix
+  */
+  static Matrix4< T > &inverse( Matrix4< T > &m, const Matrix4< T > &m0, T *det = 0 );
+
+  // number of elements summed sequentially at the leaves of pairwise summation
+  static const unsigned int PAIRWISE_BLOCK = 64;
+
+private:
+  static Accum sumAccum( const T *v, unsigned int n );
+  static void sumAccum( Accum s[ 3 ], const Vector3< T > *v, unsigned int n );
+  static Matrix4< Accum > widen( const Matrix4< T > &m );
+};
+
+//
+inline float preciseFma( float a, float b, float c )
+{
+  return fmaf( a, b, c );
+}
+
+//
+inline double preciseFma( double a, double b, double c )
+{
+  return fma( a, b, c );
+}
+
+//
+inline long double preciseFma( long double a, long double b, long double c )
+{
+  return fmal( a, b, c );
+}
+
+//
+template< typename T >
+inline void Precise< T >::twoProduct( Accum &p, Accum &e, Accum a, Accum b )
+{
+  p = a * b;
+  e = preciseFma( a, b, -p );
+}
+
+//
+template< typename T >
+inline void Precise< T >::twoSum( Accum &s, Accum &e, Accum a, Accum b )
+{
+  s = a + b;
+  Accum z = s - a;
+  e = ( a - ( s - z ) ) + ( b - z );
+}
+
+//
+template< typename T >
+inline T Precise< T >::diffOfProducts( T a, T b, T c, T d )
+{
+  T w = c * d;
+  T e = preciseFma( -c, d, w );
+  T f = preciseFma( a, b, -w );
+  return f + e;
+}
+
+//
+template< typename T >
+typename Precise< T >::Accum Precise< T >::sumAccum( const T *v, unsigned int n )
+{
+  if( n <= PAIRWISE_BLOCK )
+    {
+      Accum s = 0;
+      for( unsigned int i = 0; i < n; ++i )
+	{
+	  s += static_cast< Accum >( v[ i ] );
+	}
+      return s;
+    }
+
+  unsigned int h = n / 2;
+  return sumAccum( v, h ) + sumAccum( v + h, n - h );
+}
+
+//
+template< typename T >
+void Precise< T >::sumAccum( Accum s[ 3 ], const Vector3< T > *v, unsigned int n )
+{
+  if( n <= PAIRWISE_BLOCK )
+    {
+      s[ 0 ] = s[ 1 ] = s[ 2 ] = 0;
+      for( unsigned int i = 0; i < n; ++i )
+	{
+	  s[ 0 ] += static_cast< Accum >( v[ i ].x );
+	  s[ 1 ] += static_cast< Accum >( v[ i ].y );
+	  s[ 2 ] += static_cast< Accum >( v[ i ].z );
+	}
+      return;
+    }
+
+  unsigned int h = n / 2;
+  Accum t[ 3 ];
+  sumAccum( s, v, h );
+  sumAccum( t, v + h, n - h );
+  s[ 0 ] += t[ 0 ];
+  s[ 1 ] += t[ 1 ];
+  s[ 2 ] += t[ 2 ];
+}
+
+//
+template< typename T >
+T Precise< T >::sum( const T *v, unsigned int n )
+{
+  return static_cast< T >( sumAccum( v, n ) );
+}
+
+//
+template< typename T >
+T Precise< T >::dot( const T *v1, const T *v2, unsigned int n )
+{
+  // Dot2 (Ogita, Rump and Oishi)
+  Accum p = 0, s = 0;
+  for( unsigned int i = 0; i < n; ++i )
+    {
+      Accum h, r, q;
+      twoProduct( h, r, v1[ i ], v2[ i ] );
+      twoSum( p, q, p, h );
+      s += q + r;
+    }
+  return static_cast< T >( p + s );
+}
+
+//
+template< typename T >
+inline T Precise< T >::dot( const Vector3< T > &v1, const Vector3< T > &v2 )
+{
+  return dot( v1.v, v2.v, 3 );
+}
+
+//
+template< typename T >
+void Precise< T >::dot( T *out, const Vector3< T > *v1, const Vector3< T > *v2, unsigned int n )
+{
+#ifdef _OPENMP
+#pragma omp parallel for if( n > 65536 )
+#endif
+  for( int i = 0; i < static_cast< int >( n ); ++i )
+    {
+      Accum x = static_cast< Accum >( v1[ i ].x ) * v2[ i ].x;
+      Accum y = static_cast< Accum >( v1[ i ].y ) * v2[ i ].y;
+      Accum z = static_cast< Accum >( v1[ i ].z ) * v2[ i ].z;
+      out[ i ] = static_cast< T >( x + y + z );
+    }
+}
+
+//
+template< typename T >
+inline T Precise< T >::length( const Vector3< T > &v )
+{
+  Accum x = v.x, y = v.y, z = v.z;
+  return static_cast< T >( std::sqrt( x * x + y * y + z * z ) );
+}
+
+//
+template< typename T >
+void Precise< T >::length( T *out, const Vector3< T > *v, unsigned int n )
+{
+#ifdef _OPENMP
+#pragma omp parallel for if( n > 65536 )
+#endif
+  for( int i = 0; i < static_cast< int >( n ); ++i )
+    {
+      Accum x = v[ i ].x, y = v[ i ].y, z = v[ i ].z;
+      out[ i ] = static_cast< T >( std::sqrt( x * x + y * y + z * z ) );
+    }
+}
+
+//
+template< typename T >
+Vector3< T > &Precise< T >::normalize( Vector3< T > &v, const Vector3< T > &v0 )
+{
+  Accum x = v0.x, y = v0.y, z = v0.z;
+  Accum l = std::sqrt( x * x + y * y + z * z );
+  if( l == 0 )
+    {
+      v = Vector3< T >();
+      return v;
+    }
+
+  v = Vector3< T >( static_cast< T >( x / l ), static_cast< T >( y / l ), static_cast< T >( z / l ) );
+  return v;
+}
+
+//
+template< typename T >
+Vector3< T > &Precise< T >::sum( Vector3< T > &s, const Vector3< T > *v, unsigned int n )
+{
+  if( n == 0 )
+    {
+      s = Vector3< T >();
+      return s;
+    }
+
+  Accum a[ 3 ];
+  sumAccum( a, v, n );
+  s = Vector3< T >( static_cast< T >( a[ 0 ] ), static_cast< T >( a[ 1 ] ), static_cast< T >( a[ 2 ] ) );
+  return s;
+}
+
+//
+template< typename T >
+inline Matrix4< typename Precise< T >::Accum > Precise< T >::widen( const Matrix4< T > &m )
+{
+  Matrix4< Accum > t;
+  for( int i = 0; i < 16; ++i )
+    {
+      t.m[ i ] = m.m[ i ];
+    }
+  return t;
+}
+
+//
+template< typename T >
+T Precise< T >::determinant( const Matrix4< T > &m )
+{
+  return static_cast< T >( Matrix4< Accum >::determinant( widen( m ) ) );
+}
+
+//
+template< typename T >
+Matrix4< T > &Precise< T >::inverse( Matrix4< T > &m, const Matrix4< T > &m0, T *det )
+{
+  Matrix4< Accum > t;
+  Accum d;
+  Matrix4< Accum >::inverse( t, widen( m0 ), &d );
+
+  if( det ) *det = static_cast< T >( d );
+  if( d == 0 ) return m;
+
+  for( int i = 0; i < 16; ++i )
+    {
+      m.m[ i ] = static_cast< T >( t.m[ i ] );
+    }
+  return m;
+}
+
+typedef Precise< float > PreciseF;
+typedef Precise< double > PreciseD;
@@ -0,0 +1,479 @@
+#pragma once
+
+#include <cmath>
+#include <algorithm>
+#include "Vector3.h"
+#include "Quaternion.h"
+#include "Dispatch.h"
+
+//! compact encodings of unit quaternions, unit vectors and positions
+/*!
+  Maximum errors ( per component unless noted ) :
+  - quaternion 32 bits ( smallest three, 3 x 10 bits ) : 6.92e-4 on the
+    stored components, 1.9e-3 on the reconstructed largest one
+  - quaternion 48 bits ( smallest three, 3 x 15 bits ) : 2.16e-5 stored,
+    5.8e-5 reconstructed
+  - unit vector 32 bits ( octahedral, 2 x 16 bits ) : 6.5e-5 rad
+  - position 48 bits ( 3 x 16 bits in [ min, max ] ) : ( max - min ) / 131070
+  Codecs are written with selects only, so the batch versions vectorize
+  across elements at -O3 ; the octahedral batches gather the vectors into
+  local soa blocks of CODE_BLOCK ( they carry a vptr ) and the batch
+  decoders take square roots in T between two passes by DispatchRoot.
+  Batches give the same codes and values as the single versions.
+*/
+template< typename T = float >
+struct Quantize
+{
+  // static function
+  /*!
+    @brief encode unit quaternion to 32 bits (smallest three)
+  */
+  static unsigned int encodeQuaternion32( const Quaternion< T > &q );
+  /*!
+    @brief decode unit quaternion from 32 bits
+  */
+  static Quaternion< T > &decodeQuaternion32( Quaternion< T > &q, unsigned int c );
+  /*!
+    @brief encode unit quaternion to 48 bits (smallest three, in the low bits)
+  */
+  static unsigned long long encodeQuaternion48( const Quaternion< T > &q );
+  /*!
+    @brief decode unit quaternion from 48 bits
+  */
+  static Quaternion< T > &decodeQuaternion48( Quaternion< T > &q, unsigned long long c );
+  /*!
+    @brief encode unit vector to 32 bits (octahedral)
+  */
+  static unsigned int encodeOctahedral( const Vector3< T > &v );
+  /*!
+    @brief decode unit vector from 32 bits
+  */
+  static Vector3< T > &decodeOctahedral( Vector3< T > &v, unsigned int c );
+  /*!
+    @brief encode position to 3 x 16 bits in range [ min, max ]
+
+    Components with an empty range ( max <= min ) encode to 0 and decode to min.
+  */
+  static void encodePosition( unsigned short *c, const Vector3< T > &v, const Vector3< T > &min, const Vector3< T > &max );
+  /*!
+    @brief decode position from 3 x 16 bits
+  */
+  static Vector3< T > &decodePosition( Vector3< T > &v, const unsigned short *c, const Vector3< T > &min, const Vector3< T > &max );
+
+  /*!
+    @brief encode unit quaternions to 32 bits
+  */
+  static void encodeQuaternion32( unsigned int *c, const Quaternion< T > *q, unsigned int n );
+  /*!
+    @brief decode unit quaternions from 32 bits
+  */
+  static void decodeQuaternion32( Quaternion< T > *q, const unsigned int *c, unsigned int n );
+  /*!
+    @brief encode unit quaternions to 48 bits
+  */
+  static void encodeQuaternion48( unsigned long long *c, const Quaternion< T > *q, unsigned int n );
+  /*!
+    @brief decode unit quaternions from 48 bits
+  */
+  static void decodeQuaternion48( Quaternion< T > *q, const unsigned long long *c, unsigned int n );
+  /*!
+    @brief encode unit vectors to 32 bits
+  */
+  static void encodeOctahedral( unsigned int *c, const Vector3< T > *v, unsigned int n );
+  /*!
+    @brief decode unit vectors from 32 bits
+  */
+  static void decodeOctahedral( Vector3< T > *v, const unsigned int *c, unsigned int n );
+  /*!
+    @brief encode positions to 3 x 16 bits each ( empty ranges as the single version )
+  */
+  static void encodePosition( unsigned short *c, const Vector3< T > *v, unsigned int n, const Vector3< T > &min, const Vector3< T > &max );
+  /*!
+    @brief decode positions from 3 x 16 bits each
+  */
+  static void decodePosition( Vector3< T > *v, const unsigned short *c, unsigned int n, const Vector3< T > &min, const Vector3< T > &max );
+
+  // elements per block in the blocked batch codecs
+  static const unsigned int CODE_BLOCK = 256;
+
+private:
+#if defined( __AVX512F__ ) && defined( __AVX512VL__ ) && defined( __AVX512DQ__ )
+  typedef DispatchRoot< T, Cpu::AVX512 > Root;
+#elif defined( __AVX2__ ) && defined( __FMA__ )
+  typedef DispatchRoot< T, Cpu::AVX2 > Root;
+#elif defined( __SSE4_2__ )
+  typedef DispatchRoot< T, Cpu::SSE42 > Root;
+#else
+  typedef DispatchRoot< T, Cpu::SCALAR > Root;
+#endif
+
+  static MATH_DISPATCH_INLINE unsigned int toUnsigned( T x, T lo, T hi, unsigned int bits );
+  static MATH_DISPATCH_INLINE T fromUnsigned( unsigned int u, T lo, T hi, unsigned int bits );
+  static MATH_DISPATCH_INLINE unsigned long long smallestThree( const Quaternion< T > &q, unsigned int bits );
+  static MATH_DISPATCH_INLINE unsigned int kept( T &x, T &y, T &z, T &w, T &s, unsigned long long c, unsigned int bits );
+  static Quaternion< T > &largest( Quaternion< T > &q, unsigned long long c, unsigned int bits );
+  static MATH_DISPATCH_INLINE unsigned int fold( T x, T y, T z );
+  static MATH_DISPATCH_INLINE void unfold( T &x, T &y, T &z, unsigned int c );
+  template< typename C >
+  static void largest( Quaternion< T > *q, const C *c, unsigned int n, unsigned int bits );
+};
+
+//
+template< typename T >
+inline unsigned int Quantize< T >::toUnsigned( T x, T lo, T hi, unsigned int bits )
+{
+  // an empty range would give 0 / 0 ; the clamp also maps NaN to 0
+  T m = static_cast< T >( ( 1u << bits ) - 1 );
+  T t = hi > lo ? ( x - lo ) / ( hi - lo ) * m + static_cast< T >( 0.5 ) : 0;
+  t = t > 0 ? ( t < m ? t : m ) : 0;
+  // through int, which converts in packed form ( t < 2^16 )
+  return static_cast< unsigned int >( static_cast< int >( t ) );
+}
+
+//
+template< typename T >
+inline T Quantize< T >::fromUnsigned( unsigned int u, T lo, T hi, unsigned int bits )
+{
+  T m = static_cast< T >( ( 1u << bits ) - 1 );
+  return lo + ( hi - lo ) * ( static_cast< T >( static_cast< int >( u ) ) / m );
+}
+
+//
+template< typename T >
+inline unsigned long long Quantize< T >::smallestThree( const Quaternion< T > &q, unsigned int bits )
+{
+  // drop the largest component ( the first of equal ones ), its sign is made
+  // positive by q ~ -q ; k is counted from equality tests against the maximum,
+  // GCC threads ordered tests on the components into branches
+  T a0 = fabs( q.v[ 0 ] ), a1 = fabs( q.v[ 1 ] ), a2 = fabs( q.v[ 2 ] ), a3 = fabs( q.v[ 3 ] );
+  T m01 = a1 > a0 ? a1 : a0, m23 = a3 > a2 ? a3 : a2;
+  T m = m23 > m01 ? m23 : m01;
+  unsigned int k = ( a0 != m ) * ( 1 + ( a1 != m ) * ( 1 + ( a2 != m ) ) );
+  T l = k == 0 ? q.v[ 0 ] : ( k == 1 ? q.v[ 1 ] : ( k == 2 ? q.v[ 2 ] : q.v[ 3 ] ) );
+  T s = l < 0 ? -1 : 1;
+  const T r = static_cast< T >( 0.70710678118654752440 );
+
+  unsigned long long u[ 4 ];
+  for( unsigned int i = 0; i < 4; ++i )
+    {
+      u[ i ] = toUnsigned( q.v[ i ] * s, -r, r, bits );
+    }
+  // the kept components in order, lowest index in the highest bits
+  unsigned long long c = k;
+  c = ( c << bits ) | ( k > 0 ? u[ 0 ] : u[ 1 ] );
+  c = ( c << bits ) | ( k > 1 ? u[ 1 ] : u[ 2 ] );
+  c = ( c << bits ) | ( k > 2 ? u[ 2 ] : u[ 3 ] );
+  return c;
+}
+
+//
+template< typename T >
+inline unsigned int Quantize< T >::kept( T &x, T &y, T &z, T &w, T &s, unsigned long long c, unsigned int bits )
+{
+  // the left out component k is set to 0 and its square returned in s
+  const T r = static_cast< T >( 0.70710678118654752440 );
+  const unsigned long long mask = ( 1ull << bits ) - 1;
+  unsigned int k = static_cast< unsigned int >( c >> ( 3 * bits ) ) & 3;
+  T a = fromUnsigned( static_cast< unsigned int >( ( c >> ( 2 * bits ) ) & mask ), -r, r, bits );
+  T b = fromUnsigned( static_cast< unsigned int >( ( c >> bits ) & mask ), -r, r, bits );
+  T d = fromUnsigned( static_cast< unsigned int >( c & mask ), -r, r, bits );
+
+  x = k == 0 ? 0 : a;
+  y = k == 1 ? 0 : ( k == 0 ? a : b );
+  z = k == 2 ? 0 : ( k == 3 ? d : b );
+  w = k == 3 ? 0 : d;
+  s = 1 - ( d * d + b * b + a * a );
+  s = s > 0 ? s : 0;
+  return k;
+}
+
+//
+template< typename T >
+Quaternion< T > &Quantize< T >::largest( Quaternion< T > &q, unsigned long long c, unsigned int bits )
+{
+  T s;
+  unsigned int k = kept( q.x, q.y, q.z, q.w, s, c, bits );
+  q.v[ k ] = static_cast< T >( sqrt( static_cast< double >( s ) ) );
+  return q;
+}
+
+//
+template< typename T >
+template< typename C >
+void Quantize< T >::largest( Quaternion< T > *q, const C *c, unsigned int n, unsigned int bits )
+{
+  int blocks = static_cast< int >( ( n + CODE_BLOCK - 1 ) / CODE_BLOCK );
+
+#ifdef _OPENMP
+#pragma omp parallel for if( n > 65536 )
+#endif
+  for( int b = 0; b < blocks; ++b )
+    {
+      unsigned int begin = b * CODE_BLOCK;
+      unsigned int k = std::min( begin + CODE_BLOCK, n ) - begin;
+      Quaternion< T > *o = q + begin;
+      const C *e = c + begin;
+      T x[ CODE_BLOCK ], y[ CODE_BLOCK ], z[ CODE_BLOCK ], w[ CODE_BLOCK ], s[ CODE_BLOCK ];
+      for( unsigned int i = 0; i < k; ++i )
+	{
+	  kept( x[ i ], y[ i ], z[ i ], w[ i ], s[ i ], e[ i ], bits );
+	}
+      Root::run( s, k );
+      for( unsigned int i = 0; i < k; ++i )
+	{
+	  // the left out component is 0, add the root weighted 1 there and 0 elsewhere ;
+	  // the weights are exact for t in 0 .. 3, selects on t would be threaded
+	  // into branches as their tests exclude each other
+	  T t = static_cast< T >( static_cast< int >( e[ i ] >> ( 3 * bits ) ) & 3 );
+	  o[ i ].x = x[ i ] + ( 1 - t ) * ( 2 - t ) * ( 3 - t ) / 6 * s[ i ];
+	  o[ i ].y = y[ i ] + t * ( 2 - t ) * ( 3 - t ) / 2 * s[ i ];
+	  o[ i ].z = z[ i ] + t * ( t - 1 ) * ( 3 - t ) / 2 * s[ i ];
+	  o[ i ].w = w[ i ] + t * ( t - 1 ) * ( t - 2 ) / 6 * s[ i ];
+	}
+    }
+}
+
+//
+template< typename T >
+inline unsigned int Quantize< T >::encodeQuaternion32( const Quaternion< T > &q )
+{
+  return static_cast< unsigned int >( smallestThree( q, 10 ) );
+}
+
+//
+template< typename T >
+inline Quaternion< T > &Quantize< T >::decodeQuaternion32( Quaternion< T > &q, unsigned int c )
+{
+  return largest( q, c, 10 );
+}
+
+//
+template< typename T >
+inline unsigned long long Quantize< T >::encodeQuaternion48( const Quaternion< T > &q )
+{
+  return smallestThree( q, 15 );
+}
+
+//
+template< typename T >
+inline Quaternion< T > &Quantize< T >::decodeQuaternion48( Quaternion< T > &q, unsigned long long c )
+{
+  return largest( q, c, 15 );
+}
+
+//
+template< typename T >
+inline unsigned int Quantize< T >::fold( T x, T y, T z )
+{
+  // project onto the octahedron |x| + |y| + |z| = 1 and fold the lower half ;
+  // a zero vector divides by 1, added rather than selected as GCC turns a
+  // select into a branch around the division
+  T l = fabs( x ) + fabs( y ) + fabs( z );
+  l += l == 0 ? 1 : 0;
+  T px = x / l, py = y / l, pz = z / l;
+  // the lower half moves |z| outwards in x and y, as unfold moves it back ;
+  // a folded value used in one select arm alone would be moved into a branch
+  T t = -pz > 0 ? -pz : 0;
+  px += px >= 0 ? t : -t;
+  py += py >= 0 ? t : -t;
+  return ( toUnsigned( px, -1, 1, 16 ) << 16 ) | toUnsigned( py, -1, 1, 16 );
+}
+
+//
+template< typename T >
+inline unsigned int Quantize< T >::encodeOctahedral( const Vector3< T > &v )
+{
+  return fold( v.x, v.y, v.z );
+}
+
+//
+template< typename T >
+inline void Quantize< T >::unfold( T &x, T &y, T &z, unsigned int c )
+{
+  x = fromUnsigned( c >> 16, -1, 1, 16 );
+  y = fromUnsigned( c & 0xffff, -1, 1, 16 );
+  z = 1 - fabs( x ) - fabs( y );
+  T t = z < 0 ? -z : 0;
+  x += x >= 0 ? -t : t;
+  y += y >= 0 ? -t : t;
+}
+
+//
+template< typename T >
+inline Vector3< T > &Quantize< T >::decodeOctahedral( Vector3< T > &v, unsigned int c )
+{
+  T x, y, z;
+  unfold( x, y, z, c );
+  Vector3< T >::normalize( v, Vector3< T >( x, y, z ) );
+  return v;
+}
+
+//
+template< typename T >
+inline void Quantize< T >::encodePosition( unsigned short *c, const Vector3< T > &v, const Vector3< T > &min, const Vector3< T > &max )
+{
+  c[ 0 ] = static_cast< unsigned short >( toUnsigned( v.x, min.x, max.x, 16 ) );
+  c[ 1 ] = static_cast< unsigned short >( toUnsigned( v.y, min.y, max.y, 16 ) );
+  c[ 2 ] = static_cast< unsigned short >( toUnsigned( v.z, min.z, max.z, 16 ) );
+}
+
+//
+template< typename T >
+inline Vector3< T > &Quantize< T >::decodePosition( Vector3< T > &v, const unsigned short *c, const Vector3< T > &min, const Vector3< T > &max )
+{
+  v = Vector3< T >( fromUnsigned( c[ 0 ], min.x, max.x, 16 ),
+		    fromUnsigned( c[ 1 ], min.y, max.y, 16 ),
+		    fromUnsigned( c[ 2 ], min.z, max.z, 16 ) );
+  return v;
+}
+
+//
+template< typename T >
+void Quantize< T >::encodeQuaternion32( unsigned int *c, const Quaternion< T > *q, unsigned int n )
+{
+#ifdef _OPENMP
+#pragma omp parallel for if( n > 65536 )
+#endif
+  for( int i = 0; i < static_cast< int >( n ); ++i )
+    {
+      c[ i ] = encodeQuaternion32( q[ i ] );
+    }
+}
+
+//
+template< typename T >
+void Quantize< T >::decodeQuaternion32( Quaternion< T > *q, const unsigned int *c, unsigned int n )
+{
+  largest( q, c, n, 10 );
+}
+
+//
+template< typename T >
+void Quantize< T >::encodeQuaternion48( unsigned long long *c, const Quaternion< T > *q, unsigned int n )
+{
+#ifdef _OPENMP
+#pragma omp parallel for if( n > 65536 )
+#endif
+  for( int i = 0; i < static_cast< int >( n ); ++i )
+    {
+      c[ i ] = encodeQuaternion48( q[ i ] );
+    }
+}
+
+//
+template< typename T >
+void Quantize< T >::decodeQuaternion48( Quaternion< T > *q, const unsigned long long *c, unsigned int n )
+{
+  largest( q, c, n, 15 );
+}
+
+//
+template< typename T >
+void Quantize< T >::encodeOctahedral( unsigned int *c, const Vector3< T > *v, unsigned int n )
+{
+  int blocks = static_cast< int >( ( n + CODE_BLOCK - 1 ) / CODE_BLOCK );
+
+#ifdef _OPENMP
+#pragma omp parallel for if( n > 65536 )
+#endif
+  for( int b = 0; b < blocks; ++b )
+    {
+      unsigned int begin = b * CODE_BLOCK;
+      unsigned int k = std::min( begin + CODE_BLOCK, n ) - begin;
+      // gather into local soa blocks : the vectors carry a vptr, so only the middle loop is wide
+      T x[ CODE_BLOCK ], y[ CODE_BLOCK ], z[ CODE_BLOCK ];
+      for( unsigned int i = 0; i < k; ++i )
+	{
+	  x[ i ] = v[ begin + i ].x;
+	  y[ i ] = v[ begin + i ].y;
+	  z[ i ] = v[ begin + i ].z;
+	}
+      unsigned int *o = c + begin;
+      for( unsigned int i = 0; i < k; ++i )
+	{
+	  o[ i ] = fold( x[ i ], y[ i ], z[ i ] );
+	}
+    }
+}
+
+//
+template< typename T >
+void Quantize< T >::decodeOctahedral( Vector3< T > *v, const unsigned int *c, unsigned int n )
+{
+  int blocks = static_cast< int >( ( n + CODE_BLOCK - 1 ) / CODE_BLOCK );
+
+#ifdef _OPENMP
+#pragma omp parallel for if( n > 65536 )
+#endif
+  for( int b = 0; b < blocks; ++b )
+    {
+      unsigned int begin = b * CODE_BLOCK;
+      unsigned int k = std::min( begin + CODE_BLOCK, n ) - begin;
+      const unsigned int *e = c + begin;
+      T x[ CODE_BLOCK ], y[ CODE_BLOCK ], z[ CODE_BLOCK ], l[ CODE_BLOCK ];
+      for( unsigned int i = 0; i < k; ++i )
+	{
+	  unfold( x[ i ], y[ i ], z[ i ], e[ i ] );
+	  l[ i ] = x[ i ] * x[ i ] + y[ i ] * y[ i ] + z[ i ] * z[ i ];
+	}
+      Root::run( l, k );
+      // the folded vector never has length 0, normalize needs no test
+      for( unsigned int i = 0; i < k; ++i )
+	{
+	  x[ i ] /= l[ i ];
+	  y[ i ] /= l[ i ];
+	  z[ i ] /= l[ i ];
+	}
+      for( unsigned int i = 0; i < k; ++i )
+	{
+	  v[ begin + i ].x = x[ i ];
+	  v[ begin + i ].y = y[ i ];
+	  v[ begin + i ].z = z[ i ];
+	}
+    }
+}
+
+//
+template< typename T >
+void Quantize< T >::encodePosition( unsigned short *c, const Vector3< T > *v, unsigned int n, const Vector3< T > &min, const Vector3< T > &max )
+{
+  // scale factors are hoisted so the loop body is multiply-add and clamp only ;
+  // an empty range scales by 0 as in toUnsigned
+  const T m = 65535;
+  const T sx = max.x > min.x ? m / ( max.x - min.x ) : 0;
+  const T sy = max.y > min.y ? m / ( max.y - min.y ) : 0;
+  const T sz = max.z > min.z ? m / ( max.z - min.z ) : 0;
+  const T h = static_cast< T >( 0.5 );
+#ifdef _OPENMP
+#pragma omp parallel for if( n > 65536 )
+#endif
+  for( int i = 0; i < static_cast< int >( n ); ++i )
+    {
+      T x = ( v[ i ].x - min.x ) * sx + h;
+      T y = ( v[ i ].y - min.y ) * sy + h;
+      T z = ( v[ i ].z - min.z ) * sz + h;
+      c[ i * 3 ] = static_cast< unsigned short >( x > 0 ? ( x < m ? x : m ) : 0 );
+      c[ i * 3 + 1 ] = static_cast< unsigned short >( y > 0 ? ( y < m ? y : m ) : 0 );
+      c[ i * 3 + 2 ] = static_cast< unsigned short >( z > 0 ? ( z < m ? z : m ) : 0 );
+    }
+}
+
+//
+template< typename T >
+void Quantize< T >::decodePosition( Vector3< T > *v, const unsigned short *c, unsigned int n, const Vector3< T > &min, const Vector3< T > &max )
+{
+  const T m = 65535;
+  const T sx = ( max.x - min.x ) / m, sy = ( max.y - min.y ) / m, sz = ( max.z - min.z ) / m;
+#ifdef _OPENMP
+#pragma omp parallel for if( n > 65536 )
+#endif
+  for( int i = 0; i < static_cast< int >( n ); ++i )
+    {
+      v[ i ].x = min.x + c[ i * 3 ] * sx;
+      v[ i ].y = min.y + c[ i * 3 + 1 ] * sy;
+      v[ i ].z = min.z + c[ i * 3 + 2 ] * sz;
+    }
+}
+
+typedef Quantize< float > QuantizeF;
+typedef Quantize< double > QuantizeD;
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cmath>
+#include "Instrument.h"
 
 template< typename T > struct Vector3;
 template< typename T > struct Matrix4;
@@ -70,11 +71,22 @@ struct Quaternion
     @brief convert to matrix
   */
   static Matrix4< T >		&toMatrix( Matrix4< T > &m, const Quaternion< T > &q );
+  /*!
+    @brief convert from rotation matrix (Shepperd's method)
+  */
+  static Quaternion< T >	&fromMatrix( Quaternion< T > &q, const Matrix4< T > &m );
+  /*!
+    @brief convert from rotation matrices (branch free)
+  */
+  static void fromMatrix( Quaternion< T > *q, const Matrix4< T > *m, unsigned int n );
   /*!
     @brief linear interpolation
   */
   template< typename T2 >
   static Quaternion< T > slerp( Quaternion< T > &q, const Quaternion< T > &q1, const Quaternion< T > &q2, T2 t );
+
+  // number of matrices that the batch fromMatrix converts at once
+  static const unsigned int FROM_MATRIX_BLOCK = 256;
    
 
   union
@@ -383,12 +395,130 @@ Matrix4< T > &Quaternion< T >::toMatrix( Matrix4< T > &m, const Quaternion< T >
   return m;
 }
 
-template< typename T, typename T2 >
-static Quaternion< T > slerp( Quaternion< T > &q, const Quaternion< T > &q1, const Quaternion< T > &q2, T2 t )
+template< typename T >
+Quaternion< T > &Quaternion< T >::fromMatrix( Quaternion< T > &q, const Matrix4< T > &m )
+{
+  // take the largest of 4w^2, 4x^2, 4y^2, 4z^2 as divisor for stability
+  T t = m._11 + m._22 + m._33;
+  if( t > 0 )
+    {
+      T s = static_cast< T >( sqrt( static_cast< double >( t + 1 ) ) ) * 2;
+      q.w = s / 4;
+      q.x = ( m._23 - m._32 ) / s;
+      q.y = ( m._31 - m._13 ) / s;
+      q.z = ( m._12 - m._21 ) / s;
+    }
+  else if( m._11 >= m._22 && m._11 >= m._33 )
+    {
+      T s = static_cast< T >( sqrt( static_cast< double >( 1 + m._11 - m._22 - m._33 ) ) ) * 2;
+      q.w = ( m._23 - m._32 ) / s;
+      q.x = s / 4;
+      q.y = ( m._12 + m._21 ) / s;
+      q.z = ( m._31 + m._13 ) / s;
+    }
+  else if( m._22 >= m._33 )
+    {
+      T s = static_cast< T >( sqrt( static_cast< double >( 1 + m._22 - m._11 - m._33 ) ) ) * 2;
+      q.w = ( m._31 - m._13 ) / s;
+      q.x = ( m._12 + m._21 ) / s;
+      q.y = s / 4;
+      q.z = ( m._23 + m._32 ) / s;
+    }
+  else
+    {
+      T s = static_cast< T >( sqrt( static_cast< double >( 1 + m._33 - m._11 - m._22 ) ) ) * 2;
+      q.w = ( m._12 - m._21 ) / s;
+      q.x = ( m._31 + m._13 ) / s;
+      q.y = ( m._23 + m._32 ) / s;
+      q.z = s / 4;
+    }
+
+  // keep w >= 0 so that the result does not depend on the branch taken
+  if( q.w < 0 )
+    {
+      q = -q;
+    }
+  return q;
+}
+
+template< typename T >
+void Quaternion< T >::fromMatrix( Quaternion< T > *q, const Matrix4< T > *m, unsigned int n )
+{
+  // Shepperd's method as in the scalar version, with the branches turned into
+  // selects : the largest of 4w^2, 4x^2, 4y^2, 4z^2 gives the divisor and the
+  // other three components come from the off-diagonal sums and differences.
+  // every value is computed before it is selected, and the square roots of a
+  // block run in their own loop, so the other two loops vectorize across
+  // matrices even where sqrt has to set errno
+  int blocks = static_cast< int >( ( n + FROM_MATRIX_BLOCK - 1 ) / FROM_MATRIX_BLOCK );
+#ifdef _OPENMP
+#pragma omp parallel for if( n > 16384 )
+#endif
+  for( int b = 0; b < blocks; ++b )
+    {
+      unsigned int begin = b * FROM_MATRIX_BLOCK;
+      unsigned int count = ( begin + FROM_MATRIX_BLOCK < n ? begin + FROM_MATRIX_BLOCK : n ) - begin;
+      const Matrix4< T > *a = &m[ begin ];
+      Quaternion< T > *o = &q[ begin ];
+      T s[ FROM_MATRIX_BLOCK ];
+      for( unsigned int i = 0; i < count; ++i )
+	{
+	  T w2 = 1 + a[ i ]._11 + a[ i ]._22 + a[ i ]._33;
+	  T x2 = 1 + a[ i ]._11 - a[ i ]._22 - a[ i ]._33;
+	  T y2 = 1 - a[ i ]._11 + a[ i ]._22 - a[ i ]._33;
+	  T z2 = 1 - a[ i ]._11 - a[ i ]._22 + a[ i ]._33;
+	  T d = w2 > x2 ? w2 : x2;
+	  d = d > y2 ? d : y2;
+	  d = d > z2 ? d : z2;
+	  s[ i ] = d > 0 ? d : 0;
+	}
+      for( unsigned int i = 0; i < count; ++i )
+	{
+	  s[ i ] = static_cast< T >( sqrt( static_cast< double >( s[ i ] ) ) ) * 2;
+	}
+      for( unsigned int i = 0; i < count; ++i )
+	{
+	  T w2 = 1 + a[ i ]._11 + a[ i ]._22 + a[ i ]._33;
+	  T x2 = 1 + a[ i ]._11 - a[ i ]._22 - a[ i ]._33;
+	  T y2 = 1 - a[ i ]._11 + a[ i ]._22 - a[ i ]._33;
+	  T z2 = 1 - a[ i ]._11 - a[ i ]._22 + a[ i ]._33;
+	  bool bw = ( w2 >= x2 ) & ( w2 >= y2 ) & ( w2 >= z2 );
+	  bool bx = !bw & ( x2 >= y2 ) & ( x2 >= z2 );
+	  bool by = !bw & !bx & ( y2 >= z2 );
+	  bool bz = !bw & !bx & !by;
+	  T r = 1 / ( s[ i ] > 0 ? s[ i ] : 1 );
+
+	  // 4wx, 4wy, 4wz, 4xy, 4xz, 4yz
+	  T wx = a[ i ]._23 - a[ i ]._32, wy = a[ i ]._31 - a[ i ]._13, wz = a[ i ]._12 - a[ i ]._21;
+	  T xy = a[ i ]._12 + a[ i ]._21, xz = a[ i ]._31 + a[ i ]._13, yz = a[ i ]._23 + a[ i ]._32;
+	  T h = s[ i ] / 4;
+	  T pw = ( bx ? wx : by ? wy : wz ) * r;
+	  T px = ( bw ? wx : by ? xy : xz ) * r;
+	  T py = ( bw ? wy : bx ? xy : yz ) * r;
+	  T pz = ( bw ? wz : bx ? xz : yz ) * r;
+	  T w = bw ? h : pw;
+	  T x = bx ? h : px;
+	  T y = by ? h : py;
+	  T z = bz ? h : pz;
+
+	  // keep w >= 0 as the scalar version does
+	  T sign = w < 0 ? -1 : 1;
+	  o[ i ].x = x * sign;
+	  o[ i ].y = y * sign;
+	  o[ i ].z = z * sign;
+	  o[ i ].w = w * sign;
+	}
+    }
+}
+
+template< typename T >
+template< typename T2 >
+Quaternion< T > Quaternion< T >::slerp( Quaternion< T > &q, const Quaternion< T > &q1, const Quaternion< T > &q2, T2 t )
 {
+  MATH_INSTRUMENT_SCOPE( Instrument::QUATERNION_SLERP, 1 );
   double a = static_cast< double >( q1.x * q2.x + q1.y * q2.y + q1.z * q2.z + q1.w * q2.w );
   double b = 1.0 - a * a;
-  if( b == 0.0 )
+  if( b <= 0.0 )
     {
       q = q1;
     }
@@ -407,6 +537,12 @@ static Quaternion< T > slerp( Quaternion< T > &q, const Quaternion< T > &q1, con
   return q;
 }
 
+template< typename T, typename T2 >
+static Quaternion< T > slerp( Quaternion< T > &q, const Quaternion< T > &q1, const Quaternion< T > &q2, T2 t )
+{
+  return Quaternion< T >::slerp( q, q1, q2, t );
+}
+
 /*!
   output stream
 */
@@ -0,0 +1,303 @@
+#pragma once
+
+#include <cmath>
+#include <limits>
+#include <vector>
+#include <algorithm>
+#include "Vector3.h"
+#include "Vector3SoA.h"
+#include "AABB.h"
+
+//! batched ray queries against axis-aligned boxes
+/*!
+  Slab tests take inverse directions ( see inverse ) and run branch-free
+  across boxes or rays, so they vectorize to the widest unit available
+  ( 4, 8 or 16 lanes of float ). Each slab uses the near and far planes
+  chosen by the sign of the inverse direction, so empty boxes ( min > max )
+  never hit. A direction component of 0 gives an infinite inverse ; when the
+  origin lies on that slab's plane the product is NaN, which is ignored,
+  counting the plane as inside. Far distances are widened by a few ulp
+  ( Ize ) so that rounding does not lose hits on box edges.
+*/
+template< typename T = double >
+struct Ray
+{
+  // static function
+  /*!
+    @brief calculate inverse directions ( 1 / 0 is infinite with the sign of the zero )
+  */
+  static Vector3SoA< T > &inverse( Vector3SoA< T > &inv, const Vector3SoA< T > &dir, unsigned int n );
+  /*!
+    @brief intersect one ray with boxes
+    @param hit 1 if [ tmin, tmax ] of ray overlaps box, otherwise 0
+    @param tnear entry distance clamped to tmin ( may be null )
+  */
+  static void intersectBoxes( unsigned char *hit, T *tnear, const Vector3< T > &org, const Vector3< T > &inv, const Vector3SoA< T > &boxMin, const Vector3SoA< T > &boxMax, unsigned int n, T tmin = 0, T tmax = std::numeric_limits< T >::max() );
+  /*!
+    @brief intersect rays with one box
+    @param hit 1 if [ tmin, tmax ] of ray overlaps box, otherwise 0
+    @param tnear entry distance clamped to tmin ( may be null )
+  */
+  static void intersectRays( unsigned char *hit, T *tnear, const AABB< T > &box, const Vector3SoA< T > &org, const Vector3SoA< T > &inv, unsigned int n, T tmin = 0, T tmax = std::numeric_limits< T >::max() );
+  /*!
+    @brief get direction octant ( bit 0, 1, 2 set for negative x, y, z )
+  */
+  static unsigned int octant( const Vector3< T > &dir );
+  /*!
+    @brief sort rays for coherent traversal
+    @param order n entries, indices of rays grouped by direction octant, then in Morton order of origin
+  */
+  static void sort( unsigned int *order, const Vector3SoA< T > &org, const Vector3SoA< T > &dir, unsigned int n );
+  /*!
+    @brief sort rays for coherent traversal
+  */
+  static void sort( unsigned int *order, const Vector3< T > *org, const Vector3< T > *dir, unsigned int n );
+  /*!
+    @brief gather vectors in given order ( o must not alias v )
+  */
+  static Vector3SoA< T > &permute( Vector3SoA< T > &o, const Vector3SoA< T > &v, const unsigned int *order, unsigned int n );
+
+  // rays or boxes tested per block in the batch loops
+  static const unsigned int SLAB_BLOCK = 256;
+  // bits per axis of the Morton code of origins
+  static const unsigned int MORTON_BITS = 10;
+
+private:
+  static unsigned int spread( unsigned int v );
+};
+
+//
+template< typename T >
+Vector3SoA< T > &Ray< T >::inverse( Vector3SoA< T > &inv, const Vector3SoA< T > &dir, unsigned int n )
+{
+#ifdef _OPENMP
+#pragma omp parallel for if( n > 65536 )
+#endif
+  for( int i = 0; i < static_cast< int >( n ); ++i )
+    {
+      inv.x[ i ] = 1 / dir.x[ i ];
+      inv.y[ i ] = 1 / dir.y[ i ];
+      inv.z[ i ] = 1 / dir.z[ i ];
+    }
+  return inv;
+}
+
+//
+template< typename T >
+void Ray< T >::intersectBoxes( unsigned char *hit, T *tnear, const Vector3< T > &org, const Vector3< T > &inv, const Vector3SoA< T > &boxMin, const Vector3SoA< T > &boxMax, unsigned int n, T tmin, T tmax )
+{
+  // scaling rather than adding an ulp keeps infinite distances infinite
+  const T wide = 1 + 4 * std::numeric_limits< T >::epsilon(), narrow = 1 - 4 * std::numeric_limits< T >::epsilon();
+  // the ray's signs pick the near and far plane arrays once for all boxes
+  const T *nx = inv.x >= 0 ? boxMin.x : boxMax.x, *fx = inv.x >= 0 ? boxMax.x : boxMin.x;
+  const T *ny = inv.y >= 0 ? boxMin.y : boxMax.y, *fy = inv.y >= 0 ? boxMax.y : boxMin.y;
+  const T *nz = inv.z >= 0 ? boxMin.z : boxMax.z, *fz = inv.z >= 0 ? boxMax.z : boxMin.z;
+  const T ox = org.x, oy = org.y, oz = org.z, ix = inv.x, iy = inv.y, iz = inv.z;
+  int blocks = static_cast< int >( ( n + SLAB_BLOCK - 1 ) / SLAB_BLOCK );
+
+#ifdef _OPENMP
+#pragma omp parallel for if( n > 65536 )
+#endif
+  for( int b = 0; b < blocks; ++b )
+    {
+      unsigned int begin = b * SLAB_BLOCK;
+      unsigned int k = std::min( begin + SLAB_BLOCK, n ) - begin;
+      T t0[ SLAB_BLOCK ];
+      unsigned char h[ SLAB_BLOCK ];
+      for( unsigned int i = 0; i < k; ++i )
+	{
+	  unsigned int j = begin + i;
+	  T a, f, lo = tmin, hi = tmax;
+	  // NaN fails both comparisons and leaves the interval unchanged
+	  a = ( nx[ j ] - ox ) * ix;
+	  f = ( fx[ j ] - ox ) * ix;
+	  f *= f < 0 ? narrow : wide;
+	  lo = a > lo ? a : lo;
+	  hi = f < hi ? f : hi;
+	  a = ( ny[ j ] - oy ) * iy;
+	  f = ( fy[ j ] - oy ) * iy;
+	  f *= f < 0 ? narrow : wide;
+	  lo = a > lo ? a : lo;
+	  hi = f < hi ? f : hi;
+	  a = ( nz[ j ] - oz ) * iz;
+	  f = ( fz[ j ] - oz ) * iz;
+	  f *= f < 0 ? narrow : wide;
+	  lo = a > lo ? a : lo;
+	  hi = f < hi ? f : hi;
+	  t0[ i ] = lo;
+	  h[ i ] = lo <= hi;
+	}
+      std::copy( h, h + k, hit + begin );
+      if( tnear )
+	{
+	  std::copy( t0, t0 + k, tnear + begin );
+	}
+    }
+}
+
+//
+template< typename T >
+void Ray< T >::intersectRays( unsigned char *hit, T *tnear, const AABB< T > &box, const Vector3SoA< T > &org, const Vector3SoA< T > &inv, unsigned int n, T tmin, T tmax )
+{
+  // scaling rather than adding an ulp keeps infinite distances infinite
+  const T wide = 1 + 4 * std::numeric_limits< T >::epsilon(), narrow = 1 - 4 * std::numeric_limits< T >::epsilon();
+  const T lx = box.min.x, ly = box.min.y, lz = box.min.z;
+  const T ux = box.max.x, uy = box.max.y, uz = box.max.z;
+  int blocks = static_cast< int >( ( n + SLAB_BLOCK - 1 ) / SLAB_BLOCK );
+
+#ifdef _OPENMP
+#pragma omp parallel for if( n > 65536 )
+#endif
+  for( int b = 0; b < blocks; ++b )
+    {
+      unsigned int begin = b * SLAB_BLOCK;
+      unsigned int k = std::min( begin + SLAB_BLOCK, n ) - begin;
+      const T *ox = org.x + begin, *oy = org.y + begin, *oz = org.z + begin;
+      const T *ix = inv.x + begin, *iy = inv.y + begin, *iz = inv.z + begin;
+      T t0[ SLAB_BLOCK ];
+      unsigned char h[ SLAB_BLOCK ];
+      for( unsigned int i = 0; i < k; ++i )
+	{
+	  T a, f, lo = tmin, hi = tmax;
+	  a = ( ( ix[ i ] >= 0 ? lx : ux ) - ox[ i ] ) * ix[ i ];
+	  f = ( ( ix[ i ] >= 0 ? ux : lx ) - ox[ i ] ) * ix[ i ];
+	  f *= f < 0 ? narrow : wide;
+	  lo = a > lo ? a : lo;
+	  hi = f < hi ? f : hi;
+	  a = ( ( iy[ i ] >= 0 ? ly : uy ) - oy[ i ] ) * iy[ i ];
+	  f = ( ( iy[ i ] >= 0 ? uy : ly ) - oy[ i ] ) * iy[ i ];
+	  f *= f < 0 ? narrow : wide;
+	  lo = a > lo ? a : lo;
+	  hi = f < hi ? f : hi;
+	  a = ( ( iz[ i ] >= 0 ? lz : uz ) - oz[ i ] ) * iz[ i ];
+	  f = ( ( iz[ i ] >= 0 ? uz : lz ) - oz[ i ] ) * iz[ i ];
+	  f *= f < 0 ? narrow : wide;
+	  lo = a > lo ? a : lo;
+	  hi = f < hi ? f : hi;
+	  t0[ i ] = lo;
+	  h[ i ] = lo <= hi;
+	}
+      std::copy( h, h + k, hit + begin );
+      if( tnear )
+	{
+	  std::copy( t0, t0 + k, tnear + begin );
+	}
+    }
+}
+
+//
+template< typename T >
+inline unsigned int Ray< T >::octant( const Vector3< T > &dir )
+{
+  // sign of the inverse so that -0 groups with its infinite inverse
+  return ( 1 / dir.x < 0 ? 1 : 0 ) | ( 1 / dir.y < 0 ? 2 : 0 ) | ( 1 / dir.z < 0 ? 4 : 0 );
+}
+
+//
+template< typename T >
+inline unsigned int Ray< T >::spread( unsigned int v )
+{
+  // insert two zero bits between each of the low 10 bits
+  v &= 0x3ff;
+  v = ( v | ( v << 16 ) ) & 0x030000ff;
+  v = ( v | ( v << 8 ) ) & 0x0300f00f;
+  v = ( v | ( v << 4 ) ) & 0x030c30c3;
+  v = ( v | ( v << 2 ) ) & 0x09249249;
+  return v;
+}
+
+//
+template< typename T >
+void Ray< T >::sort( unsigned int *order, const Vector3SoA< T > &org, const Vector3SoA< T > &dir, unsigned int n )
+{
+  AABB< T > bounds;
+  AABB< T >::fromPoints( bounds, org, n );
+  const T cells = static_cast< T >( ( 1 << MORTON_BITS ) - 1 );
+  Vector3< T > size = bounds.size();
+  const T sx = size.x > 0 ? cells / size.x : 0;
+  const T sy = size.y > 0 ? cells / size.y : 0;
+  const T sz = size.z > 0 ? cells / size.z : 0;
+
+  // octant above the 30 bit Morton code
+  std::vector< unsigned long long > key( n + 1 ), k2( n + 1 );
+  std::vector< unsigned int > o2( n + 1 );
+#ifdef _OPENMP
+#pragma omp parallel for if( n > 65536 )
+#endif
+  for( int i = 0; i < static_cast< int >( n ); ++i )
+    {
+      T fx = ( org.x[ i ] - bounds.min.x ) * sx, fy = ( org.y[ i ] - bounds.min.y ) * sy, fz = ( org.z[ i ] - bounds.min.z ) * sz;
+      // NaN origins land in cell 0
+      unsigned int cx = fx > 0 ? static_cast< unsigned int >( std::min( fx, cells ) ) : 0;
+      unsigned int cy = fy > 0 ? static_cast< unsigned int >( std::min( fy, cells ) ) : 0;
+      unsigned int cz = fz > 0 ? static_cast< unsigned int >( std::min( fz, cells ) ) : 0;
+      unsigned long long oct = octant( Vector3< T >( dir.x[ i ], dir.y[ i ], dir.z[ i ] ) );
+      key[ i ] = ( oct << ( 3 * MORTON_BITS ) ) | ( spread( cx ) | ( spread( cy ) << 1 ) | ( spread( cz ) << 2 ) );
+      order[ i ] = i;
+    }
+
+  // stable LSD radix sort, 11 bits per pass over the 33 bit keys
+  const unsigned int RADIX = 11, BUCKETS = 1 << RADIX;
+  unsigned long long *ka = &key[ 0 ], *kb = &k2[ 0 ];
+  unsigned int *oa = order, *ob = &o2[ 0 ];
+  std::vector< unsigned int > count( BUCKETS );
+  for( unsigned int shift = 0; shift < 3 * MORTON_BITS + 3; shift += RADIX )
+    {
+      std::fill( count.begin(), count.end(), 0 );
+      for( unsigned int i = 0; i < n; ++i )
+	{
+	  ++count[ ( ka[ i ] >> shift ) & ( BUCKETS - 1 ) ];
+	}
+      unsigned int sum = 0;
+      for( unsigned int b = 0; b < BUCKETS; ++b )
+	{
+	  unsigned int c = count[ b ];
+	  count[ b ] = sum;
+	  sum += c;
+	}
+      for( unsigned int i = 0; i < n; ++i )
+	{
+	  unsigned int d = count[ ( ka[ i ] >> shift ) & ( BUCKETS - 1 ) ]++;
+	  kb[ d ] = ka[ i ];
+	  ob[ d ] = oa[ i ];
+	}
+      std::swap( ka, kb );
+      std::swap( oa, ob );
+    }
+  // an odd number of passes leaves the result in the scratch buffer
+  if( oa != order )
+    {
+      std::copy( oa, oa + n, order );
+    }
+}
+
+//
+template< typename T >
+void Ray< T >::sort( unsigned int *order, const Vector3< T > *org, const Vector3< T > *dir, unsigned int n )
+{
+  std::vector< T > buffer( n * 6 + 6 );
+  Vector3SoA< T > o( &buffer[ 0 ], &buffer[ n + 1 ], &buffer[ 2 * n + 2 ] );
+  Vector3SoA< T > d( &buffer[ 3 * n + 3 ], &buffer[ 4 * n + 4 ], &buffer[ 5 * n + 5 ] );
+  Vector3SoA< T >::load( o, org, n );
+  Vector3SoA< T >::load( d, dir, n );
+  sort( order, o, d, n );
+}
+
+//
+template< typename T >
+Vector3SoA< T > &Ray< T >::permute( Vector3SoA< T > &o, const Vector3SoA< T > &v, const unsigned int *order, unsigned int n )
+{
+#ifdef _OPENMP
+#pragma omp parallel for if( n > 65536 )
+#endif
+  for( int i = 0; i < static_cast< int >( n ); ++i )
+    {
+      o.x[ i ] = v.x[ order[ i ] ];
+      o.y[ i ] = v.y[ order[ i ] ];
+      o.z[ i ] = v.z[ order[ i ] ];
+    }
+  return o;
+}
+
+typedef Ray< float > RayF;
+typedef Ray< double > RayD;
@@ -0,0 +1,492 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include "Vector3.h"
+#include "Vector3SoA.h"
+#include "Matrix4.h"
+#include "AABB.h"
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+//! parallel reductions over point sets
+/*!
+  Sums run in double over chunks of REDUCE_CHUNK points, each chunk in
+  REDUCE_LANES independent accumulators so that the loops vectorize without
+  relaxed floating point. Ordered reductions ( the default ) merge chunk sums
+  in chunk order, so results do not depend on thread count. Unordered ones
+  give each thread one contiguous share and merge shares as threads finish :
+  no partial sum buffer, but the last bits may change between runs.
+  Covariance is taken about the centroid in a second pass, which stays
+  accurate where sum of squares minus square of sum does not.
+*/
+template< typename T = double >
+struct Reduce
+{
+  // static function
+  /*!
+    @brief sum points
+  */
+  static Vector3< T > &sum( Vector3< T > &o, const Vector3SoA< T > &v, unsigned int n, bool ordered = true );
+  /*!
+    @brief sum points
+  */
+  static Vector3< T > &sum( Vector3< T > &o, const Vector3< T > *v, unsigned int n, bool ordered = true );
+  /*!
+    @brief calculate mean of points ( 0 for no points )
+  */
+  static Vector3< T > &centroid( Vector3< T > &o, const Vector3SoA< T > &v, unsigned int n, bool ordered = true );
+  /*!
+    @brief calculate mean of points ( 0 for no points )
+  */
+  static Vector3< T > &centroid( Vector3< T > &o, const Vector3< T > *v, unsigned int n, bool ordered = true );
+  /*!
+    @brief calculate bounding box of points ( min and max are exact in any order )
+  */
+  static AABB< T > &extents( AABB< T > &o, const Vector3SoA< T > &v, unsigned int n );
+  /*!
+    @brief calculate bounding box of points ( min and max are exact in any order )
+  */
+  static AABB< T > &extents( AABB< T > &o, const Vector3< T > *v, unsigned int n );
+  /*!
+    @brief calculate covariance of points
+    @param c xx, yy, zz, xy, xz, yz ( as OBB::eigen )
+    @param mean centroid ( may be null )
+  */
+  static void covariance( T *c, Vector3< T > *mean, const Vector3SoA< T > &v, unsigned int n, bool ordered = true );
+  /*!
+    @brief calculate covariance of points
+    @param c xx, yy, zz, xy, xz, yz ( as OBB::eigen )
+    @param mean centroid ( may be null )
+  */
+  static void covariance( T *c, Vector3< T > *mean, const Vector3< T > *v, unsigned int n, bool ordered = true );
+  /*!
+    @brief calculate covariance of points as symmetric upper 3x3 of identity
+  */
+  static Matrix4< T > &covariance( Matrix4< T > &m, const Vector3SoA< T > &v, unsigned int n, bool ordered = true );
+  /*!
+    @brief calculate covariance of points as symmetric upper 3x3 of identity
+  */
+  static Matrix4< T > &covariance( Matrix4< T > &m, const Vector3< T > *v, unsigned int n, bool ordered = true );
+  /*!
+    @brief sum squared distances of points to p
+  */
+  static T squaredDistance( const Vector3< T > &p, const Vector3SoA< T > &v, unsigned int n, bool ordered = true );
+  /*!
+    @brief sum squared distances of points to p
+  */
+  static T squaredDistance( const Vector3< T > &p, const Vector3< T > *v, unsigned int n, bool ordered = true );
+
+  // number of points that a thread sums before merging
+  static const unsigned int REDUCE_CHUNK = 65536;
+  // independent double accumulators per sum, a multiple of the widest vector
+  static const unsigned int REDUCE_LANES = 8;
+
+private:
+  // point access for the kernels, inlined so that both layouts vectorize
+  struct Soa
+  {
+    T x( unsigned int i ) const { return px[ i ]; }
+    T y( unsigned int i ) const { return py[ i ]; }
+    T z( unsigned int i ) const { return pz[ i ]; }
+
+    const T *px, *py, *pz;
+  };
+  struct Aos
+  {
+    T x( unsigned int i ) const { return p[ i ].x; }
+    T y( unsigned int i ) const { return p[ i ].y; }
+    T z( unsigned int i ) const { return p[ i ].z; }
+
+    const Vector3< T > *p;
+  };
+
+  // kernels sum [ begin, end ) into WIDTH doubles
+  template< typename P > struct Sum
+  {
+    enum { WIDTH = 3 };
+    void operator ()( double *s, unsigned int begin, unsigned int end ) const;
+
+    const P *p;
+  };
+  template< typename P > struct Moment
+  {
+    enum { WIDTH = 6 };
+    void operator ()( double *s, unsigned int begin, unsigned int end ) const;
+
+    const P *p;
+    double m[ 3 ];
+  };
+  template< typename P > struct Distance
+  {
+    enum { WIDTH = 1 };
+    void operator ()( double *s, unsigned int begin, unsigned int end ) const;
+
+    const P *p;
+    double c[ 3 ];
+  };
+
+  template< typename K > static void run( double *o, const K &kernel, unsigned int n, bool ordered );
+  template< typename P > static void moments( double *c, double *m, const P &p, unsigned int n, bool ordered );
+  template< typename P > static Vector3< T > &meanOf( Vector3< T > &o, const P &p, unsigned int n, bool ordered );
+  template< typename P > static T distanceOf( const Vector3< T > &c, const P &p, unsigned int n, bool ordered );
+  static Soa soa( const Vector3SoA< T > &v );
+  static Aos aos( const Vector3< T > *v );
+};
+
+//
+template< typename T >
+inline typename Reduce< T >::Soa Reduce< T >::soa( const Vector3SoA< T > &v )
+{
+  Soa s = { v.x, v.y, v.z };
+  return s;
+}
+
+//
+template< typename T >
+inline typename Reduce< T >::Aos Reduce< T >::aos( const Vector3< T > *v )
+{
+  Aos a = { v };
+  return a;
+}
+
+//
+template< typename T >
+template< typename P >
+void Reduce< T >::Sum< P >::operator ()( double *s, unsigned int begin, unsigned int end ) const
+{
+  double x[ REDUCE_LANES ], y[ REDUCE_LANES ], z[ REDUCE_LANES ];
+  std::fill( x, x + REDUCE_LANES, 0.0 );
+  std::fill( y, y + REDUCE_LANES, 0.0 );
+  std::fill( z, z + REDUCE_LANES, 0.0 );
+  unsigned int m = end - ( end - begin ) % REDUCE_LANES;
+  for( unsigned int i = begin; i < m; i += REDUCE_LANES )
+    {
+      for( unsigned int k = 0; k < REDUCE_LANES; ++k )
+	{
+	  x[ k ] += p->x( i + k );
+	  y[ k ] += p->y( i + k );
+	  z[ k ] += p->z( i + k );
+	}
+    }
+  for( unsigned int i = m; i < end; ++i )
+    {
+      x[ i - m ] += p->x( i );
+      y[ i - m ] += p->y( i );
+      z[ i - m ] += p->z( i );
+    }
+  s[ 0 ] = s[ 1 ] = s[ 2 ] = 0;
+  for( unsigned int k = 0; k < REDUCE_LANES; ++k )
+    {
+      s[ 0 ] += x[ k ];
+      s[ 1 ] += y[ k ];
+      s[ 2 ] += z[ k ];
+    }
+}
+
+//
+template< typename T >
+template< typename P >
+void Reduce< T >::Moment< P >::operator ()( double *s, unsigned int begin, unsigned int end ) const
+{
+  double xx[ REDUCE_LANES ], yy[ REDUCE_LANES ], zz[ REDUCE_LANES ];
+  double xy[ REDUCE_LANES ], xz[ REDUCE_LANES ], yz[ REDUCE_LANES ];
+  std::fill( xx, xx + REDUCE_LANES, 0.0 );
+  std::fill( yy, yy + REDUCE_LANES, 0.0 );
+  std::fill( zz, zz + REDUCE_LANES, 0.0 );
+  std::fill( xy, xy + REDUCE_LANES, 0.0 );
+  std::fill( xz, xz + REDUCE_LANES, 0.0 );
+  std::fill( yz, yz + REDUCE_LANES, 0.0 );
+  const double mx = m[ 0 ], my = m[ 1 ], mz = m[ 2 ];
+  unsigned int e = end - ( end - begin ) % REDUCE_LANES;
+  for( unsigned int i = begin; i < e; i += REDUCE_LANES )
+    {
+      for( unsigned int k = 0; k < REDUCE_LANES; ++k )
+	{
+	  double x = p->x( i + k ) - mx, y = p->y( i + k ) - my, z = p->z( i + k ) - mz;
+	  xx[ k ] += x * x;
+	  yy[ k ] += y * y;
+	  zz[ k ] += z * z;
+	  xy[ k ] += x * y;
+	  xz[ k ] += x * z;
+	  yz[ k ] += y * z;
+	}
+    }
+  for( unsigned int i = e; i < end; ++i )
+    {
+      double x = p->x( i ) - mx, y = p->y( i ) - my, z = p->z( i ) - mz;
+      xx[ i - e ] += x * x;
+      yy[ i - e ] += y * y;
+      zz[ i - e ] += z * z;
+      xy[ i - e ] += x * y;
+      xz[ i - e ] += x * z;
+      yz[ i - e ] += y * z;
+    }
+  std::fill( s, s + 6, 0.0 );
+  for( unsigned int k = 0; k < REDUCE_LANES; ++k )
+    {
+      s[ 0 ] += xx[ k ];
+      s[ 1 ] += yy[ k ];
+      s[ 2 ] += zz[ k ];
+      s[ 3 ] += xy[ k ];
+      s[ 4 ] += xz[ k ];
+      s[ 5 ] += yz[ k ];
+    }
+}
+
+//
+template< typename T >
+template< typename P >
+void Reduce< T >::Distance< P >::operator ()( double *s, unsigned int begin, unsigned int end ) const
+{
+  double d[ REDUCE_LANES ];
+  std::fill( d, d + REDUCE_LANES, 0.0 );
+  const double cx = c[ 0 ], cy = c[ 1 ], cz = c[ 2 ];
+  unsigned int m = end - ( end - begin ) % REDUCE_LANES;
+  for( unsigned int i = begin; i < m; i += REDUCE_LANES )
+    {
+      for( unsigned int k = 0; k < REDUCE_LANES; ++k )
+	{
+	  double x = p->x( i + k ) - cx, y = p->y( i + k ) - cy, z = p->z( i + k ) - cz;
+	  d[ k ] += x * x + y * y + z * z;
+	}
+    }
+  for( unsigned int i = m; i < end; ++i )
+    {
+      double x = p->x( i ) - cx, y = p->y( i ) - cy, z = p->z( i ) - cz;
+      d[ i - m ] += x * x + y * y + z * z;
+    }
+  s[ 0 ] = 0;
+  for( unsigned int k = 0; k < REDUCE_LANES; ++k )
+    {
+      s[ 0 ] += d[ k ];
+    }
+}
+
+//
+template< typename T >
+template< typename K >
+void Reduce< T >::run( double *o, const K &kernel, unsigned int n, bool ordered )
+{
+  const unsigned int w = K::WIDTH;
+  int chunks = static_cast< int >( ( n + REDUCE_CHUNK - 1 ) / REDUCE_CHUNK );
+  std::fill( o, o + w, 0.0 );
+
+#ifdef _OPENMP
+  if( !ordered && chunks > 1 )
+    {
+#pragma omp parallel
+      {
+	unsigned long long t = omp_get_thread_num(), threads = omp_get_num_threads();
+	unsigned int begin = static_cast< unsigned int >( n * t / threads );
+	unsigned int end = static_cast< unsigned int >( n * ( t + 1 ) / threads );
+	double s[ K::WIDTH ];
+	kernel( s, begin, end );
+#pragma omp critical
+	for( unsigned int k = 0; k < w; ++k )
+	  {
+	    o[ k ] += s[ k ];
+	  }
+      }
+      return;
+    }
+#else
+  ( void )ordered;
+#endif
+
+  std::vector< double > part( chunks * w + w );
+#ifdef _OPENMP
+#pragma omp parallel for if( chunks > 1 )
+#endif
+  for( int c = 0; c < chunks; ++c )
+    {
+      unsigned int begin = c * REDUCE_CHUNK;
+      unsigned int end = std::min( begin + REDUCE_CHUNK, n );
+      kernel( &part[ c * w ], begin, end );
+    }
+  for( int c = 0; c < chunks; ++c )
+    {
+      for( unsigned int k = 0; k < w; ++k )
+	{
+	  o[ k ] += part[ c * w + k ];
+	}
+    }
+}
+
+//
+template< typename T >
+template< typename P >
+void Reduce< T >::moments( double *c, double *m, const P &p, unsigned int n, bool ordered )
+{
+  Sum< P > s = { &p };
+  run( m, s, n, ordered );
+  for( int k = 0; k < 3; ++k )
+    {
+      m[ k ] /= n ? n : 1;
+    }
+  Moment< P > a = { &p, { m[ 0 ], m[ 1 ], m[ 2 ] } };
+  run( c, a, n, ordered );
+  for( int k = 0; k < 6; ++k )
+    {
+      c[ k ] /= n ? n : 1;
+    }
+}
+
+//
+template< typename T >
+template< typename P >
+Vector3< T > &Reduce< T >::meanOf( Vector3< T > &o, const P &p, unsigned int n, bool ordered )
+{
+  Sum< P > k = { &p };
+  double s[ 3 ];
+  run( s, k, n, ordered );
+  double f = n ? 1.0 / n : 0.0;
+  o = Vector3< T >( static_cast< T >( s[ 0 ] * f ), static_cast< T >( s[ 1 ] * f ), static_cast< T >( s[ 2 ] * f ) );
+  return o;
+}
+
+//
+template< typename T >
+template< typename P >
+T Reduce< T >::distanceOf( const Vector3< T > &c, const P &p, unsigned int n, bool ordered )
+{
+  Distance< P > k = { &p, { c.x, c.y, c.z } };
+  double s;
+  run( &s, k, n, ordered );
+  return static_cast< T >( s );
+}
+
+//
+template< typename T >
+Vector3< T > &Reduce< T >::sum( Vector3< T > &o, const Vector3SoA< T > &v, unsigned int n, bool ordered )
+{
+  Soa p = soa( v );
+  Sum< Soa > k = { &p };
+  double s[ 3 ];
+  run( s, k, n, ordered );
+  o = Vector3< T >( static_cast< T >( s[ 0 ] ), static_cast< T >( s[ 1 ] ), static_cast< T >( s[ 2 ] ) );
+  return o;
+}
+
+//
+template< typename T >
+Vector3< T > &Reduce< T >::sum( Vector3< T > &o, const Vector3< T > *v, unsigned int n, bool ordered )
+{
+  Aos p = aos( v );
+  Sum< Aos > k = { &p };
+  double s[ 3 ];
+  run( s, k, n, ordered );
+  o = Vector3< T >( static_cast< T >( s[ 0 ] ), static_cast< T >( s[ 1 ] ), static_cast< T >( s[ 2 ] ) );
+  return o;
+}
+
+//
+template< typename T >
+Vector3< T > &Reduce< T >::centroid( Vector3< T > &o, const Vector3SoA< T > &v, unsigned int n, bool ordered )
+{
+  return meanOf( o, soa( v ), n, ordered );
+}
+
+//
+template< typename T >
+Vector3< T > &Reduce< T >::centroid( Vector3< T > &o, const Vector3< T > *v, unsigned int n, bool ordered )
+{
+  return meanOf( o, aos( v ), n, ordered );
+}
+
+//
+template< typename T >
+AABB< T > &Reduce< T >::extents( AABB< T > &o, const Vector3SoA< T > &v, unsigned int n )
+{
+  return AABB< T >::fromPoints( o, v, n );
+}
+
+//
+template< typename T >
+AABB< T > &Reduce< T >::extents( AABB< T > &o, const Vector3< T > *v, unsigned int n )
+{
+  return AABB< T >::fromPoints( o, v, n );
+}
+
+//
+template< typename T >
+void Reduce< T >::covariance( T *c, Vector3< T > *mean, const Vector3SoA< T > &v, unsigned int n, bool ordered )
+{
+  double m[ 3 ], s[ 6 ];
+  moments( s, m, soa( v ), n, ordered );
+  for( int k = 0; k < 6; ++k )
+    {
+      c[ k ] = static_cast< T >( s[ k ] );
+    }
+  if( mean )
+    {
+      *mean = Vector3< T >( static_cast< T >( m[ 0 ] ), static_cast< T >( m[ 1 ] ), static_cast< T >( m[ 2 ] ) );
+    }
+}
+
+//
+template< typename T >
+void Reduce< T >::covariance( T *c, Vector3< T > *mean, const Vector3< T > *v, unsigned int n, bool ordered )
+{
+  double m[ 3 ], s[ 6 ];
+  moments( s, m, aos( v ), n, ordered );
+  for( int k = 0; k < 6; ++k )
+    {
+      c[ k ] = static_cast< T >( s[ k ] );
+    }
+  if( mean )
+    {
+      *mean = Vector3< T >( static_cast< T >( m[ 0 ] ), static_cast< T >( m[ 1 ] ), static_cast< T >( m[ 2 ] ) );
+    }
+}
+
+//
+template< typename T >
+Matrix4< T > &Reduce< T >::covariance( Matrix4< T > &m, const Vector3SoA< T > &v, unsigned int n, bool ordered )
+{
+  T c[ 6 ];
+  covariance( c, 0, v, n, ordered );
+  Matrix4< T >::identity( m );
+  m._11 = c[ 0 ];
+  m._22 = c[ 1 ];
+  m._33 = c[ 2 ];
+  m._12 = m._21 = c[ 3 ];
+  m._13 = m._31 = c[ 4 ];
+  m._23 = m._32 = c[ 5 ];
+  return m;
+}
+
+//
+template< typename T >
+Matrix4< T > &Reduce< T >::covariance( Matrix4< T > &m, const Vector3< T > *v, unsigned int n, bool ordered )
+{
+  T c[ 6 ];
+  covariance( c, 0, v, n, ordered );
+  Matrix4< T >::identity( m );
+  m._11 = c[ 0 ];
+  m._22 = c[ 1 ];
+  m._33 = c[ 2 ];
+  m._12 = m._21 = c[ 3 ];
+  m._13 = m._31 = c[ 4 ];
+  m._23 = m._32 = c[ 5 ];
+  return m;
+}
+
+//
+template< typename T >
+T Reduce< T >::squaredDistance( const Vector3< T > &p, const Vector3SoA< T > &v, unsigned int n, bool ordered )
+{
+  return distanceOf( p, soa( v ), n, ordered );
+}
+
+//
+template< typename T >
+T Reduce< T >::squaredDistance( const Vector3< T > &p, const Vector3< T > *v, unsigned int n, bool ordered )
+{
+  return distanceOf( p, aos( v ), n, ordered );
+}
+
+typedef Reduce< float > ReduceF;
+typedef Reduce< double > ReduceD;
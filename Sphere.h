@@ -0,0 +1,408 @@
+#pragma once
+
+#include <cmath>
+#include <limits>
+#include <vector>
+#include <algorithm>
+#include "Vector3.h"
+#include "Vector3SoA.h"
+
+//! bounding sphere
+/*!
+  Fits run over soa points. Passes over the points are split into
+  chunks of FIT_CHUNK that run in parallel and are merged in chunk order,
+  so results do not depend on thread count.
+*/
+template< typename T = double >
+struct Sphere
+{
+  Sphere< T >();
+  Sphere< T >( const Sphere< T > & );
+  Sphere< T >( const Vector3< T > &center, T radius );
+
+  Sphere< T > &operator = ( const Sphere< T > & );
+
+  bool contains( const Vector3< T > &p ) const;
+  bool intersects( const Sphere< T > &s ) const;
+
+  // static function
+  /*!
+    @brief fit sphere by Ritter's method
+    Starts from the farthest pair of a two-pass search and grows towards the
+    farthest outside point until all points are inside. Typically within a
+    few percent of the minimal sphere.
+  */
+  static Sphere< T > &ritter( Sphere< T > &o, const Vector3SoA< T > &v, unsigned int n );
+  /*!
+    @brief fit minimal sphere by Welzl's algorithm
+    Welzl runs on a small support set that grows by the farthest outside
+    point of each chunk until the sphere of the set covers all points.
+  */
+  static Sphere< T > &welzl( Sphere< T > &o, const Vector3SoA< T > &v, unsigned int n );
+  /*!
+    @brief fit minimal sphere of points by Welzl's algorithm ( serial, expected linear time )
+  */
+  static Sphere< T > &welzl( Sphere< T > &o, const Vector3< T > *v, unsigned int n );
+  /*!
+    @brief find point farthest from p ( lowest index on ties )
+    @return squared distance
+  */
+  static T farthest( unsigned int &index, const Vector3SoA< T > &v, unsigned int n, const Vector3< T > &p );
+
+  // number of points that a thread scans before merging
+  static const unsigned int FIT_CHUNK = 65536;
+  // growth steps of ritter before the radius is set to cover all points
+  static const unsigned int RITTER_ITERATIONS = 32;
+
+  Vector3< T > center;
+  T radius;
+
+private:
+  static bool inside( const Sphere< T > &s, const Vector3< T > &p );
+  static Sphere< T > &circumscribe( Sphere< T > &o, const Vector3< T > &a, const Vector3< T > &b );
+  static Sphere< T > &circumscribe( Sphere< T > &o, const Vector3< T > &a, const Vector3< T > &b, const Vector3< T > &c );
+  static Sphere< T > &circumscribe( Sphere< T > &o, const Vector3< T > &a, const Vector3< T > &b, const Vector3< T > &c, const Vector3< T > &d );
+};
+
+//
+template< typename T >
+inline Sphere< T >::Sphere() : center( 0, 0, 0 ), radius( 0 )
+{
+}
+
+//
+template< typename T >
+inline Sphere< T >::Sphere( const Sphere< T > &s ) : center( s.center ), radius( s.radius )
+{
+}
+
+//
+template< typename T >
+inline Sphere< T >::Sphere( const Vector3< T > &c, T r ) : center( c ), radius( r )
+{
+}
+
+//
+template< typename T >
+inline Sphere< T > &Sphere< T >::operator = ( const Sphere< T > &s )
+{
+  center = s.center;
+  radius = s.radius;
+  return *this;
+}
+
+//
+template< typename T >
+inline bool Sphere< T >::contains( const Vector3< T > &p ) const
+{
+  return Vector3< T >::norm( p - center ) <= radius * radius;
+}
+
+//
+template< typename T >
+inline bool Sphere< T >::intersects( const Sphere< T > &s ) const
+{
+  T r = radius + s.radius;
+  return Vector3< T >::norm( s.center - center ) <= r * r;
+}
+
+//
+template< typename T >
+inline bool Sphere< T >::inside( const Sphere< T > &s, const Vector3< T > &p )
+{
+  // relative slack absorbs rounding of circumscribed spheres
+  T r2 = s.radius * s.radius;
+  return Vector3< T >::norm( p - s.center ) <= r2 + r2 * std::numeric_limits< T >::epsilon() * 64;
+}
+
+//
+template< typename T >
+T Sphere< T >::farthest( unsigned int &index, const Vector3SoA< T > &v, unsigned int n, const Vector3< T > &p )
+{
+  const unsigned int BLOCK = 256;
+  int chunks = static_cast< int >( ( n + FIT_CHUNK - 1 ) / FIT_CHUNK );
+  std::vector< T > best( chunks, -1 );
+  std::vector< unsigned int > at( chunks, 0 );
+
+#ifdef _OPENMP
+#pragma omp parallel for if( chunks > 1 )
+#endif
+  for( int c = 0; c < chunks; ++c )
+    {
+      unsigned int begin = c * FIT_CHUNK;
+      unsigned int end = std::min( begin + FIT_CHUNK, n );
+      T d[ BLOCK ];
+      for( unsigned int i = begin; i < end; i += BLOCK )
+	{
+	  unsigned int k = std::min( BLOCK, end - i );
+	  const T *x = v.x + i, *y = v.y + i, *z = v.z + i;
+	  for( unsigned int j = 0; j < k; ++j )
+	    {
+	      T dx = x[ j ] - p.x, dy = y[ j ] - p.y, dz = z[ j ] - p.z;
+	      d[ j ] = dx * dx + dy * dy + dz * dz;
+	    }
+	  for( unsigned int j = 0; j < k; ++j )
+	    {
+	      if( d[ j ] > best[ c ] )
+		{
+		  best[ c ] = d[ j ];
+		  at[ c ] = i + j;
+		}
+	    }
+	}
+    }
+
+  T d = -1;
+  index = 0;
+  for( int c = 0; c < chunks; ++c )
+    {
+      if( best[ c ] > d )
+	{
+	  d = best[ c ];
+	  index = at[ c ];
+	}
+    }
+  return d;
+}
+
+//
+template< typename T >
+Sphere< T > &Sphere< T >::ritter( Sphere< T > &o, const Vector3SoA< T > &v, unsigned int n )
+{
+  if( n == 0 )
+    {
+      o = Sphere< T >();
+      return o;
+    }
+  unsigned int a, b;
+  farthest( a, v, n, v[ 0 ] );
+  farthest( b, v, n, v[ a ] );
+  Vector3< T > pa = v[ a ], pb = v[ b ];
+  o.center = ( pa + pb ) * static_cast< T >( 0.5 );
+  o.radius = Vector3< T >::distance( pa, pb ) / 2;
+
+  for( unsigned int k = 0; k < RITTER_ITERATIONS; ++k )
+    {
+      unsigned int i;
+      T d2 = farthest( i, v, n, o.center );
+      if( d2 <= o.radius * o.radius )
+	{
+	  return o;
+	}
+      // move the near side of the sphere to the far point
+      T d = static_cast< T >( sqrt( static_cast< double >( d2 ) ) );
+      T r = ( o.radius + d ) / 2;
+      o.center += ( v[ i ] - o.center ) * ( ( r - o.radius ) / d );
+      o.radius = r;
+    }
+  unsigned int i;
+  T d2 = farthest( i, v, n, o.center );
+  o.radius = std::max( o.radius, static_cast< T >( sqrt( static_cast< double >( d2 ) ) ) );
+  return o;
+}
+
+//
+template< typename T >
+Sphere< T > &Sphere< T >::welzl( Sphere< T > &o, const Vector3SoA< T > &v, unsigned int n )
+{
+  if( n == 0 )
+    {
+      o = Sphere< T >();
+      return o;
+    }
+  // seed with the farthest pair of a two-pass search
+  std::vector< unsigned int > support( 2 );
+  farthest( support[ 0 ], v, n, v[ 0 ] );
+  farthest( support[ 1 ], v, n, v[ support[ 0 ] ] );
+
+  int chunks = static_cast< int >( ( n + FIT_CHUNK - 1 ) / FIT_CHUNK );
+  std::vector< unsigned int > outside( chunks );
+  std::vector< Vector3< T > > p;
+  for( ;; )
+    {
+      std::sort( support.begin(), support.end() );
+      support.erase( std::unique( support.begin(), support.end() ), support.end() );
+      p.resize( support.size() );
+      for( unsigned int i = 0; i < support.size(); ++i )
+	{
+	  p[ i ] = v[ support[ i ] ];
+	}
+      welzl( o, &p[ 0 ], static_cast< unsigned int >( p.size() ) );
+
+      // farthest outside point of each chunk joins the support set
+      T r2 = o.radius * o.radius;
+      T limit = r2 + r2 * std::numeric_limits< T >::epsilon() * 64;
+      const Vector3< T > c = o.center;
+#ifdef _OPENMP
+#pragma omp parallel for if( chunks > 1 )
+#endif
+      for( int k = 0; k < chunks; ++k )
+	{
+	  unsigned int begin = k * FIT_CHUNK;
+	  unsigned int end = std::min( begin + FIT_CHUNK, n );
+	  T best = limit;
+	  outside[ k ] = ~0u;
+	  for( unsigned int i = begin; i < end; ++i )
+	    {
+	      T dx = v.x[ i ] - c.x, dy = v.y[ i ] - c.y, dz = v.z[ i ] - c.z;
+	      T d = dx * dx + dy * dy + dz * dz;
+	      if( d > best )
+		{
+		  best = d;
+		  outside[ k ] = i;
+		}
+	    }
+	}
+      unsigned int size = static_cast< unsigned int >( support.size() );
+      for( int k = 0; k < chunks; ++k )
+	{
+	  if( outside[ k ] != ~0u )
+	    {
+	      support.push_back( outside[ k ] );
+	    }
+	}
+      if( support.size() == size )
+	{
+	  return o;
+	}
+    }
+}
+
+//
+template< typename T >
+Sphere< T > &Sphere< T >::welzl( Sphere< T > &o, const Vector3< T > *v, unsigned int n )
+{
+  if( n == 0 )
+    {
+      o = Sphere< T >();
+      return o;
+    }
+  // expected linear time needs random order : shuffle with a fixed seed
+  std::vector< Vector3< T > > p( v, v + n );
+  unsigned int seed = 12345;
+  for( unsigned int i = n - 1; i > 0; --i )
+    {
+      seed = seed * 1664525u + 1013904223u;
+      std::swap( p[ i ], p[ ( seed >> 8 ) % ( i + 1 ) ] );
+    }
+
+  // iterative form of the recursion : each loop fixes one more boundary point
+  o = Sphere< T >( p[ 0 ], 0 );
+  for( unsigned int i = 1; i < n; ++i )
+    {
+      if( inside( o, p[ i ] ) )
+	{
+	  continue;
+	}
+      o = Sphere< T >( p[ i ], 0 );
+      for( unsigned int j = 0; j < i; ++j )
+	{
+	  if( inside( o, p[ j ] ) )
+	    {
+	      continue;
+	    }
+	  circumscribe( o, p[ i ], p[ j ] );
+	  for( unsigned int k = 0; k < j; ++k )
+	    {
+	      if( inside( o, p[ k ] ) )
+		{
+		  continue;
+		}
+	      circumscribe( o, p[ i ], p[ j ], p[ k ] );
+	      for( unsigned int l = 0; l < k; ++l )
+		{
+		  if( !inside( o, p[ l ] ) )
+		    {
+		      circumscribe( o, p[ i ], p[ j ], p[ k ], p[ l ] );
+		    }
+		}
+	    }
+	}
+    }
+  return o;
+}
+
+//
+template< typename T >
+inline Sphere< T > &Sphere< T >::circumscribe( Sphere< T > &o, const Vector3< T > &a, const Vector3< T > &b )
+{
+  o.center = ( a + b ) * static_cast< T >( 0.5 );
+  o.radius = Vector3< T >::distance( a, b ) / 2;
+  return o;
+}
+
+//
+template< typename T >
+Sphere< T > &Sphere< T >::circumscribe( Sphere< T > &o, const Vector3< T > &a, const Vector3< T > &b, const Vector3< T > &c )
+{
+  Vector3< T > e1 = b - a, e2 = c - a, n, t1, t2;
+  Vector3< T >::cross( n, e1, e2 );
+  T d = 2 * Vector3< T >::norm( n );
+  if( d <= std::numeric_limits< T >::epsilon() * Vector3< T >::norm( e1 ) * Vector3< T >::norm( e2 ) )
+    {
+      // collinear : the farthest pair spans the sphere
+      T ab = Vector3< T >::norm( e1 ), ac = Vector3< T >::norm( e2 ), bc = Vector3< T >::norm( c - b );
+      if( ab >= ac && ab >= bc )
+	{
+	  return circumscribe( o, a, b );
+	}
+      return ac >= bc ? circumscribe( o, a, c ) : circumscribe( o, b, c );
+    }
+  // center in the plane of the triangle, equidistant from its corners
+  Vector3< T >::cross( t1, n, e1 );
+  Vector3< T >::cross( t2, e2, n );
+  Vector3< T > r = ( t1 * Vector3< T >::norm( e2 ) + t2 * Vector3< T >::norm( e1 ) ) / d;
+  o.center = a + r;
+  o.radius = Vector3< T >::length( r );
+  return o;
+}
+
+//
+template< typename T >
+Sphere< T > &Sphere< T >::circumscribe( Sphere< T > &o, const Vector3< T > &a, const Vector3< T > &b, const Vector3< T > &c, const Vector3< T > &d )
+{
+  Vector3< T > e1 = b - a, e2 = c - a, e3 = d - a, c23, c31, c12;
+  Vector3< T >::cross( c23, e2, e3 );
+  Vector3< T >::cross( c31, e3, e1 );
+  Vector3< T >::cross( c12, e1, e2 );
+  T det = 2 * Vector3< T >::dot( e1, c23 );
+  T scale = Vector3< T >::length( e1 ) * Vector3< T >::length( e2 ) * Vector3< T >::length( e3 );
+  if( fabs( static_cast< double >( det ) ) <= std::numeric_limits< T >::epsilon() * 64 * scale )
+    {
+      // coplanar : the smallest sphere through three of the points that covers the fourth
+      const Vector3< T > *p[ 4 ] = { &a, &b, &c, &d };
+      Sphere< T > best( a, -1 ), s;
+      for( int k = 0; k < 4; ++k )
+	{
+	  circumscribe( s, *p[ ( k + 1 ) % 4 ], *p[ ( k + 2 ) % 4 ], *p[ ( k + 3 ) % 4 ] );
+	  if( inside( s, *p[ k ] ) && ( best.radius < 0 || s.radius < best.radius ) )
+	    {
+	      best = s;
+	    }
+	}
+      if( best.radius < 0 )
+	{
+	  circumscribe( best, a, b, c );
+	  best.radius = std::max( best.radius, Vector3< T >::distance( best.center, d ) );
+	}
+      o = best;
+      return o;
+    }
+  Vector3< T > r = ( c23 * Vector3< T >::norm( e1 ) + c31 * Vector3< T >::norm( e2 ) + c12 * Vector3< T >::norm( e3 ) ) / det;
+  o.center = a + r;
+  o.radius = Vector3< T >::length( r );
+  return o;
+}
+
+/*!
+  output stream
+*/
+template< typename T >
+std::ostream &operator<<( std::ostream &os, const Sphere< T > &s )
+{
+  os << s.center << ", " << s.radius;
+  return os;
+}
+
+typedef Sphere< float > SphereF;
+typedef Sphere< double > SphereD;
@@ -0,0 +1,336 @@
+#pragma once
+
+#include <cstdio>
+#include <vector>
+#include <algorithm>
+#include "Vector3.h"
+#include "Vector3SoA.h"
+#include "Matrix4.h"
+#include "Plane.h"
+#include "Color.h"
+#include "Dispatch.h"
+
+//! streaming pipeline over point records in files
+/*!
+  Records are x, y, z, r, g, b, a as T in native byte order ( a Vector3
+  followed by a Color ). They are read in chunks of a fixed record count and
+  passed through the stages in the order they were added.
+  Each step of run reads chunk k + 1, processes chunk k and writes chunk k - 1
+  at the same time. Under OpenMP one thread reads, one writes, and all
+  threads share the blocks of chunk k once their I/O is done. Memory stays at
+  two input and two output chunks plus one working chunk, whatever the size
+  of the file. Without OpenMP the steps run one after another.
+*/
+template< typename T = float >
+struct Stream
+{
+  //! records of a block in soa layout, passed to stage functions
+  struct Chunk
+  {
+    Vector3SoA< T > position;
+    //! r, g, b, a
+    T *color[ 4 ];
+    //! clear to drop a record
+    unsigned char *keep;
+    unsigned int n;
+  };
+
+  typedef void ( *Function )( Chunk &c, void *user );
+
+  Stream< T >( unsigned int chunk = STREAM_CHUNK );
+
+  /*!
+    @brief add stage transforming positions ( last column of m is ignored )
+  */
+  Stream< T > &transform( const Matrix4< T > &m );
+  /*!
+    @brief add stage keeping records in front of plane ( Plane::dot >= 0, as Clip )
+  */
+  Stream< T > &clip( const Plane< T > &plane );
+  /*!
+    @brief add stage mapping colors as row vectors ( r, g, b, a ) * m
+  */
+  Stream< T > &remap( const Matrix4< T > &m );
+  /*!
+    @brief add stage calling f on each block
+  */
+  Stream< T > &stage( Function f, void *user );
+  /*!
+    @brief stream records from in through the stages to out
+    @param written number of records written ( may be null )
+    @return false on read or write error ; a trailing partial record is ignored
+  */
+  bool run( FILE *out, FILE *in, unsigned long long *written = 0 ) const;
+  /*!
+    @brief stream records between files
+  */
+  bool run( const char *out, const char *in, unsigned long long *written = 0 ) const;
+
+  // scalars per record
+  static const unsigned int RECORD = 7;
+  // default records per chunk
+  static const unsigned int STREAM_CHUNK = 1 << 20;
+  // records per block shared out to worker threads
+  static const unsigned int STREAM_BLOCK = 8192;
+
+private:
+  enum Kind
+    {
+      TRANSFORM,
+      CLIP,
+      REMAP,
+      FUNCTION
+    };
+  struct Stage
+  {
+    Kind kind;
+    Matrix4< T > m;
+    Plane< T > plane;
+    Function f;
+    void *user;
+  };
+
+  void process( T *out, unsigned int &kept, const T *in, T *work, unsigned char *keep, unsigned int n ) const;
+  static void remapColors( T *const *c, unsigned int n, const Matrix4< T > &m );
+
+  std::vector< Stage > stages;
+  unsigned int chunk;
+};
+
+//
+template< typename T >
+inline Stream< T >::Stream( unsigned int c ) : chunk( std::max( c, 1u ) )
+{
+}
+
+//
+template< typename T >
+Stream< T > &Stream< T >::transform( const Matrix4< T > &m )
+{
+  Stage s;
+  s.kind = TRANSFORM;
+  s.m = m;
+  s.f = 0;
+  s.user = 0;
+  stages.push_back( s );
+  return *this;
+}
+
+//
+template< typename T >
+Stream< T > &Stream< T >::clip( const Plane< T > &plane )
+{
+  Stage s;
+  s.kind = CLIP;
+  s.plane = plane;
+  s.f = 0;
+  s.user = 0;
+  stages.push_back( s );
+  return *this;
+}
+
+//
+template< typename T >
+Stream< T > &Stream< T >::remap( const Matrix4< T > &m )
+{
+  Stage s;
+  s.kind = REMAP;
+  s.m = m;
+  s.f = 0;
+  s.user = 0;
+  stages.push_back( s );
+  return *this;
+}
+
+//
+template< typename T >
+Stream< T > &Stream< T >::stage( Function f, void *user )
+{
+  Stage s;
+  s.kind = FUNCTION;
+  s.f = f;
+  s.user = user;
+  stages.push_back( s );
+  return *this;
+}
+
+//
+template< typename T >
+void Stream< T >::remapColors( T *const *c, unsigned int n, const Matrix4< T > &m )
+{
+  T *r = c[ 0 ], *g = c[ 1 ], *b = c[ 2 ], *a = c[ 3 ];
+  for( unsigned int i = 0; i < n; ++i )
+    {
+      T x = r[ i ], y = g[ i ], z = b[ i ], w = a[ i ];
+      r[ i ] = x * m._11 + y * m._21 + z * m._31 + w * m._41;
+      g[ i ] = x * m._12 + y * m._22 + z * m._32 + w * m._42;
+      b[ i ] = x * m._13 + y * m._23 + z * m._33 + w * m._43;
+      a[ i ] = x * m._14 + y * m._24 + z * m._34 + w * m._44;
+    }
+}
+
+//
+template< typename T >
+void Stream< T >::process( T *out, unsigned int &kept, const T *in, T *work, unsigned char *keep, unsigned int n ) const
+{
+  // work holds n scalars per component, x y z r g b a
+  Chunk c;
+  c.position = Vector3SoA< T >( work, work + n, work + 2 * n );
+  for( unsigned int k = 0; k < 4; ++k )
+    {
+      c.color[ k ] = work + ( 3 + k ) * n;
+    }
+  c.keep = keep;
+  c.n = n;
+  for( unsigned int i = 0; i < n; ++i )
+    {
+      for( unsigned int k = 0; k < RECORD; ++k )
+	{
+	  work[ k * n + i ] = in[ i * RECORD + k ];
+	}
+      keep[ i ] = 1;
+    }
+
+  for( typename std::vector< Stage >::const_iterator s = stages.begin(); s != stages.end(); ++s )
+    {
+      switch( s->kind )
+	{
+	case TRANSFORM:
+	  Dispatch< T >::table().transformAffineSoA( c.position.x, c.position.y, c.position.z, c.position.x, c.position.y, c.position.z, n, s->m );
+	  break;
+	case CLIP:
+	  {
+	    const T pa = s->plane.a, pb = s->plane.b, pc = s->plane.c, pd = s->plane.d;
+	    const T *x = c.position.x, *y = c.position.y, *z = c.position.z;
+	    for( unsigned int i = 0; i < n; ++i )
+	      {
+		keep[ i ] &= pa * x[ i ] + pb * y[ i ] + pc * z[ i ] + pd >= 0;
+	      }
+	  }
+	  break;
+	case REMAP:
+	  remapColors( c.color, n, s->m );
+	  break;
+	case FUNCTION:
+	  s->f( c, s->user );
+	  break;
+	}
+    }
+
+  // kept records go back to the front of the block's output range
+  unsigned int j = 0;
+  for( unsigned int i = 0; i < n; ++i )
+    {
+      for( unsigned int k = 0; k < RECORD; ++k )
+	{
+	  out[ j * RECORD + k ] = work[ k * n + i ];
+	}
+      j += keep[ i ] ? 1 : 0;
+    }
+  kept = j;
+}
+
+//
+template< typename T >
+bool Stream< T >::run( FILE *out, FILE *in, unsigned long long *written ) const
+{
+  const size_t size = RECORD * sizeof( T );
+  const unsigned int blocks = ( chunk + STREAM_BLOCK - 1 ) / STREAM_BLOCK;
+  // two input and two output chunks so that I/O of neighbours overlaps compute
+  std::vector< T > input( 2 * static_cast< size_t >( chunk ) * RECORD ), output( 2 * static_cast< size_t >( chunk ) * RECORD ), work( static_cast< size_t >( chunk ) * RECORD );
+  std::vector< unsigned char > keep( chunk );
+  std::vector< unsigned int > kept( 2 * blocks );
+  unsigned int count[ 2 ];
+  unsigned long long total = 0;
+  bool ok = true;
+
+  count[ 0 ] = static_cast< unsigned int >( fread( &input[ 0 ], size, chunk, in ) );
+  ok = !ferror( in );
+  bool pending = false;
+  for( unsigned int k = 0; count[ k & 1 ] > 0 || pending; ++k )
+    {
+      const unsigned int cur = k & 1, prev = cur ^ 1;
+      // a short chunk is the last one
+      const bool more = ok && count[ cur ] == chunk;
+      const int n = static_cast< int >( ( count[ cur ] + STREAM_BLOCK - 1 ) / STREAM_BLOCK );
+      bool readOk = true, writeOk = true;
+      unsigned long long step = 0;
+
+#ifdef _OPENMP
+#pragma omp parallel
+#endif
+      {
+#ifdef _OPENMP
+#pragma omp single nowait
+#endif
+	{
+	  count[ prev ] = more ? static_cast< unsigned int >( fread( &input[ static_cast< size_t >( prev ) * chunk * RECORD ], size, chunk, in ) ) : 0;
+	  readOk = !ferror( in );
+	}
+#ifdef _OPENMP
+#pragma omp single nowait
+#endif
+	{
+	  // blocks of the previous chunk are written back to back
+	  for( unsigned int b = 0; pending && writeOk && b < blocks; ++b )
+	    {
+	      unsigned int m = kept[ prev * blocks + b ];
+	      writeOk = fwrite( &output[ ( static_cast< size_t >( prev ) * chunk + b * STREAM_BLOCK ) * RECORD ], size, m, out ) == m;
+	      step += m;
+	    }
+	}
+#ifdef _OPENMP
+#pragma omp for schedule( dynamic )
+#endif
+	for( int b = 0; b < n; ++b )
+	  {
+	    unsigned int begin = b * STREAM_BLOCK;
+	    unsigned int m = std::min( begin + STREAM_BLOCK, count[ cur ] ) - begin;
+	    size_t offset = ( static_cast< size_t >( cur ) * chunk + begin ) * RECORD;
+	    process( &output[ offset ], kept[ cur * blocks + b ], &input[ offset ], &work[ begin * RECORD ], &keep[ begin ], m );
+	  }
+      }
+
+      for( int b = n; b < static_cast< int >( blocks ); ++b )
+	{
+	  kept[ cur * blocks + b ] = 0;
+	}
+      total += step;
+      ok = ok && readOk && writeOk;
+      pending = count[ cur ] > 0 && writeOk;
+      if( !writeOk )
+	{
+	  break;
+	}
+    }
+
+  if( written )
+    {
+      *written = total;
+    }
+  return ok;
+}
+
+//
+template< typename T >
+bool Stream< T >::run( const char *out, const char *in, unsigned long long *written ) const
+{
+  FILE *fi = fopen( in, "rb" );
+  if( !fi )
+    {
+      return false;
+    }
+  FILE *fo = fopen( out, "wb" );
+  if( !fo )
+    {
+      fclose( fi );
+      return false;
+    }
+  bool ok = run( fo, fi, written );
+  ok = fclose( fo ) == 0 && ok;
+  fclose( fi );
+  return ok;
+}
+
+typedef Stream< float > StreamF;
+typedef Stream< double > StreamD;
@@ -0,0 +1,526 @@
+#pragma once
+
+#include <cmath>
+#include "Vector3.h"
+#include "Matrix4.h"
+#include "Quaternion.h"
+
+//! Matrix4 tagged with its structure
+/*!
+  Builders set the kind and multiplication propagates it, so multiply,
+  inverse and point transform only do the arithmetic the structure needs.
+  A plain Matrix4 converts as PROJECTIVE unless a kind is given or
+  detected by classify. Writing to m directly must keep kind valid.
+*/
+template< typename T = double >
+struct TaggedMatrix4
+{
+  enum Kind
+    {
+      IDENTITY,
+      TRANSLATION,
+      SCALE,
+      RIGID,
+      AFFINE,
+      PROJECTIVE
+    };
+
+  TaggedMatrix4< T >();
+  TaggedMatrix4< T >( const Matrix4< T > &m, Kind kind = PROJECTIVE );
+
+  operator const Matrix4< T > &() const;
+
+  TaggedMatrix4< T > operator *( const TaggedMatrix4< T > &m ) const;
+  TaggedMatrix4< T > &operator *=( const TaggedMatrix4< T > &m );
+
+  // static function
+  /*!
+    @brief create identity matrix
+  */
+  static TaggedMatrix4< T > &identity( TaggedMatrix4< T > &m );
+  /*!
+    @brief create translation matrix
+  */
+  static TaggedMatrix4< T > &translation( TaggedMatrix4< T > &m, const Vector3< T > &v );
+  /*!
+    @brief create scaling matrix
+  */
+  static TaggedMatrix4< T > &scaling( TaggedMatrix4< T > &m, const Vector3< T > &sv );
+  /*!
+    @brief create rotation matrix around x axis
+  */
+  static TaggedMatrix4< T > &rotationX( TaggedMatrix4< T > &m, T rad );
+  /*!
+    @brief create rotation matrix around y axis
+  */
+  static TaggedMatrix4< T > &rotationY( TaggedMatrix4< T > &m, T rad );
+  /*!
+    @brief create rotation matrix around z axis
+  */
+  static TaggedMatrix4< T > &rotationZ( TaggedMatrix4< T > &m, T rad );
+  /*!
+    @brief create rotation matrix from axis and angle
+  */
+  static TaggedMatrix4< T > &rotationAxis( TaggedMatrix4< T > &m, const Vector3< T > &axis, T rad );
+  /*!
+    @brief create rotation matrix from quaternion
+  */
+  static TaggedMatrix4< T > &rotationQuaternion( TaggedMatrix4< T > &m, const Quaternion< T > &q );
+  /*!
+    @brief create view matrix ( left handed )
+  */
+  static TaggedMatrix4< T > &viewLH( TaggedMatrix4< T > &m, const Vector3< T > &eyePos, const Vector3< T > &lookAt, const Vector3< T > &up );
+  /*!
+    @brief create view matrix ( right handed )
+  */
+  static TaggedMatrix4< T > &viewRH( TaggedMatrix4< T > &m, const Vector3< T > &eyePos, const Vector3< T > &lookAt, const Vector3< T > &up );
+  /*!
+    @brief create perspective matrix ( left handed )
+  */
+  static TaggedMatrix4< T > &perspectiveLH( TaggedMatrix4< T > &m, T fovy, T aspect, T zn, T zf );
+  /*!
+    @brief create orthographic matrix ( left handed )
+  */
+  static TaggedMatrix4< T > &orthoLH( TaggedMatrix4< T > &m, T w, T h, T zn, T zf );
+  /*!
+    @brief detect kind of matrix
+    @param epsilon tolerance of zero, one and orthonormality tests
+  */
+  static Kind classify( const Matrix4< T > &m, T epsilon = 0 );
+  /*!
+    @brief kind of product of a and b
+  */
+  static Kind combine( Kind a, Kind b );
+  /*!
+    @brief multiply matrices using their kinds
+  */
+  static TaggedMatrix4< T > &multiply( TaggedMatrix4< T > &m, const TaggedMatrix4< T > &m1, const TaggedMatrix4< T > &m2 );
+  /*!
+    @brief calculate inverse matrix using its kind
+  */
+  static TaggedMatrix4< T > &inverse( TaggedMatrix4< T > &m, const TaggedMatrix4< T > &m0 );
+  /*!
+    @brief transform point ( homogeneous only when PROJECTIVE )
+  */
+  static Vector3< T > &transform( Vector3< T > &v, const Vector3< T > &v0, const TaggedMatrix4< T > &m );
+  /*!
+    @brief transform points, dispatching once per array
+  */
+  static void transform( Vector3< T > *v, const Vector3< T > *v0, unsigned int n, const TaggedMatrix4< T > &m );
+
+  Matrix4< T > m;
+  Kind kind;
+};
+
+//
+template< typename T >
+inline TaggedMatrix4< T >::TaggedMatrix4() : kind( IDENTITY )
+{
+  Matrix4< T >::identity( m );
+}
+
+//
+template< typename T >
+inline TaggedMatrix4< T >::TaggedMatrix4( const Matrix4< T > &m, Kind kind ) : m( m ), kind( kind )
+{
+}
+
+//
+template< typename T >
+inline TaggedMatrix4< T >::operator const Matrix4< T > &() const
+{
+  return m;
+}
+
+//
+template< typename T >
+inline TaggedMatrix4< T > TaggedMatrix4< T >::operator *( const TaggedMatrix4< T > &m ) const
+{
+  TaggedMatrix4< T > r;
+  return multiply( r, *this, m );
+}
+
+//
+template< typename T >
+inline TaggedMatrix4< T > &TaggedMatrix4< T >::operator *=( const TaggedMatrix4< T > &m )
+{
+  TaggedMatrix4< T > r;
+  *this = multiply( r, *this, m );
+  return *this;
+}
+
+//
+template< typename T >
+inline TaggedMatrix4< T > &TaggedMatrix4< T >::identity( TaggedMatrix4< T > &m )
+{
+  Matrix4< T >::identity( m.m );
+  m.kind = IDENTITY;
+  return m;
+}
+
+//
+template< typename T >
+inline TaggedMatrix4< T > &TaggedMatrix4< T >::translation( TaggedMatrix4< T > &m, const Vector3< T > &v )
+{
+  Matrix4< T >::translation( m.m, v );
+  m.kind = TRANSLATION;
+  return m;
+}
+
+//
+template< typename T >
+inline TaggedMatrix4< T > &TaggedMatrix4< T >::scaling( TaggedMatrix4< T > &m, const Vector3< T > &sv )
+{
+  Matrix4< T >::scaling( m.m, sv );
+  m.kind = SCALE;
+  return m;
+}
+
+//
+template< typename T >
+inline TaggedMatrix4< T > &TaggedMatrix4< T >::rotationX( TaggedMatrix4< T > &m, T rad )
+{
+  Matrix4< T >::rotationX( m.m, rad );
+  m.kind = RIGID;
+  return m;
+}
+
+//
+template< typename T >
+inline TaggedMatrix4< T > &TaggedMatrix4< T >::rotationY( TaggedMatrix4< T > &m, T rad )
+{
+  Matrix4< T >::rotationY( m.m, rad );
+  m.kind = RIGID;
+  return m;
+}
+
+//
+template< typename T >
+inline TaggedMatrix4< T > &TaggedMatrix4< T >::rotationZ( TaggedMatrix4< T > &m, T rad )
+{
+  Matrix4< T >::rotationZ( m.m, rad );
+  m.kind = RIGID;
+  return m;
+}
+
+//
+template< typename T >
+inline TaggedMatrix4< T > &TaggedMatrix4< T >::rotationAxis( TaggedMatrix4< T > &m, const Vector3< T > &axis, T rad )
+{
+  Matrix4< T >::rotationAxis( m.m, axis, rad );
+  m.kind = RIGID;
+  return m;
+}
+
+//
+template< typename T >
+inline TaggedMatrix4< T > &TaggedMatrix4< T >::rotationQuaternion( TaggedMatrix4< T > &m, const Quaternion< T > &q )
+{
+  Matrix4< T >::rotationQuaternion( m.m, q );
+  m.kind = RIGID;
+  return m;
+}
+
+//
+template< typename T >
+inline TaggedMatrix4< T > &TaggedMatrix4< T >::viewLH( TaggedMatrix4< T > &m, const Vector3< T > &eyePos, const Vector3< T > &lookAt, const Vector3< T > &up )
+{
+  Matrix4< T >::viewLH( m.m, eyePos, lookAt, up );
+  m.kind = RIGID;
+  return m;
+}
+
+//
+template< typename T >
+inline TaggedMatrix4< T > &TaggedMatrix4< T >::viewRH( TaggedMatrix4< T > &m, const Vector3< T > &eyePos, const Vector3< T > &lookAt, const Vector3< T > &up )
+{
+  Matrix4< T >::viewRH( m.m, eyePos, lookAt, up );
+  m.kind = RIGID;
+  return m;
+}
+
+//
+template< typename T >
+inline TaggedMatrix4< T > &TaggedMatrix4< T >::perspectiveLH( TaggedMatrix4< T > &m, T fovy, T aspect, T zn, T zf )
+{
+  Matrix4< T >::perspectiveLH( m.m, fovy, aspect, zn, zf );
+  m.kind = PROJECTIVE;
+  return m;
+}
+
+//
+template< typename T >
+inline TaggedMatrix4< T > &TaggedMatrix4< T >::orthoLH( TaggedMatrix4< T > &m, T w, T h, T zn, T zf )
+{
+  Matrix4< T >::orthoLH( m.m, w, h, zn, zf );
+  m.kind = AFFINE;
+  return m;
+}
+
+//
+template< typename T >
+typename TaggedMatrix4< T >::Kind TaggedMatrix4< T >::classify( const Matrix4< T > &m, T epsilon )
+{
+  if( fabs( m._14 ) > epsilon || fabs( m._24 ) > epsilon || fabs( m._34 ) > epsilon || fabs( m._44 - 1 ) > epsilon )
+    {
+      return PROJECTIVE;
+    }
+
+  bool diagonal = fabs( m._12 ) <= epsilon && fabs( m._13 ) <= epsilon && fabs( m._21 ) <= epsilon &&
+    fabs( m._23 ) <= epsilon && fabs( m._31 ) <= epsilon && fabs( m._32 ) <= epsilon;
+  bool translated = fabs( m._41 ) > epsilon || fabs( m._42 ) > epsilon || fabs( m._43 ) > epsilon;
+  bool unit = fabs( m._11 - 1 ) <= epsilon && fabs( m._22 - 1 ) <= epsilon && fabs( m._33 - 1 ) <= epsilon;
+
+  if( diagonal && unit )
+    {
+      return translated ? TRANSLATION : IDENTITY;
+    }
+  if( diagonal && !translated )
+    {
+      return SCALE;
+    }
+
+  // orthonormal rows with positive determinant
+  T e = epsilon > 0 ? epsilon : static_cast< T >( 1e-6 );
+  T r11 = m._11 * m._11 + m._12 * m._12 + m._13 * m._13;
+  T r22 = m._21 * m._21 + m._22 * m._22 + m._23 * m._23;
+  T r33 = m._31 * m._31 + m._32 * m._32 + m._33 * m._33;
+  T r12 = m._11 * m._21 + m._12 * m._22 + m._13 * m._23;
+  T r13 = m._11 * m._31 + m._12 * m._32 + m._13 * m._33;
+  T r23 = m._21 * m._31 + m._22 * m._32 + m._23 * m._33;
+  T det = m._11 * ( m._22 * m._33 - m._23 * m._32 ) - m._12 * ( m._21 * m._33 - m._23 * m._31 ) + m._13 * ( m._21 * m._32 - m._22 * m._31 );
+  if( fabs( r11 - 1 ) <= e && fabs( r22 - 1 ) <= e && fabs( r33 - 1 ) <= e &&
+      fabs( r12 ) <= e && fabs( r13 ) <= e && fabs( r23 ) <= e && det > 0 )
+    {
+      return RIGID;
+    }
+  return AFFINE;
+}
+
+//
+template< typename T >
+inline typename TaggedMatrix4< T >::Kind TaggedMatrix4< T >::combine( Kind a, Kind b )
+{
+  if( a == IDENTITY )
+    return b;
+  if( b == IDENTITY || a == b )
+    return a;
+  if( a == PROJECTIVE || b == PROJECTIVE )
+    return PROJECTIVE;
+  if( ( a == TRANSLATION && b == RIGID ) || ( a == RIGID && b == TRANSLATION ) )
+    return RIGID;
+  return AFFINE;
+}
+
+//
+template< typename T >
+TaggedMatrix4< T > &TaggedMatrix4< T >::multiply( TaggedMatrix4< T > &r, const TaggedMatrix4< T > &m1, const TaggedMatrix4< T > &m2 )
+{
+  const Matrix4< T > &a = m1.m;
+  const Matrix4< T > &b = m2.m;
+  Kind kind = combine( m1.kind, m2.kind );
+
+  if( m1.kind == IDENTITY )
+    {
+      r.m = b;
+    }
+  else if( m2.kind == IDENTITY )
+    {
+      r.m = a;
+    }
+  else if( m1.kind == TRANSLATION && m2.kind == TRANSLATION )
+    {
+      Matrix4< T > t = a;
+      t._41 += b._41;
+      t._42 += b._42;
+      t._43 += b._43;
+      r.m = t;
+    }
+  else if( m1.kind == SCALE && m2.kind == SCALE )
+    {
+      Matrix4< T > t = a;
+      t._11 *= b._11;
+      t._22 *= b._22;
+      t._33 *= b._33;
+      r.m = t;
+    }
+  else if( kind != PROJECTIVE )
+    {
+      // 3x3 block and translation row, last column stays ( 0, 0, 0, 1 )
+      r.m = Matrix4< T >(
+			 a._11 * b._11 + a._12 * b._21 + a._13 * b._31,
+			 a._11 * b._12 + a._12 * b._22 + a._13 * b._32,
+			 a._11 * b._13 + a._12 * b._23 + a._13 * b._33, 0,
+			 a._21 * b._11 + a._22 * b._21 + a._23 * b._31,
+			 a._21 * b._12 + a._22 * b._22 + a._23 * b._32,
+			 a._21 * b._13 + a._22 * b._23 + a._23 * b._33, 0,
+			 a._31 * b._11 + a._32 * b._21 + a._33 * b._31,
+			 a._31 * b._12 + a._32 * b._22 + a._33 * b._32,
+			 a._31 * b._13 + a._32 * b._23 + a._33 * b._33, 0,
+			 a._41 * b._11 + a._42 * b._21 + a._43 * b._31 + b._41,
+			 a._41 * b._12 + a._42 * b._22 + a._43 * b._32 + b._42,
+			 a._41 * b._13 + a._42 * b._23 + a._43 * b._33 + b._43, 1 );
+    }
+  else
+    {
+      r.m = a * b;
+    }
+  r.kind = kind;
+  return r;
+}
+
+//
+template< typename T >
+TaggedMatrix4< T > &TaggedMatrix4< T >::inverse( TaggedMatrix4< T > &r, const TaggedMatrix4< T > &m0 )
+{
+  const Matrix4< T > &a = m0.m;
+  switch( m0.kind )
+    {
+    case IDENTITY:
+      Matrix4< T >::identity( r.m );
+      break;
+    case TRANSLATION:
+      Matrix4< T >::translation( r.m, -a._41, -a._42, -a._43 );
+      break;
+    case SCALE:
+      Matrix4< T >::scaling( r.m, 1 / a._11, 1 / a._22, 1 / a._33 );
+      break;
+    case RIGID:
+      {
+	// transpose rotation, rotate negated translation
+	T x = a._41, y = a._42, z = a._43;
+	r.m = Matrix4< T >(
+			   a._11, a._21, a._31, 0,
+			   a._12, a._22, a._32, 0,
+			   a._13, a._23, a._33, 0,
+			   -( x * a._11 + y * a._12 + z * a._13 ),
+			   -( x * a._21 + y * a._22 + z * a._23 ),
+			   -( x * a._31 + y * a._32 + z * a._33 ), 1 );
+      }
+      break;
+    case AFFINE:
+      {
+	// adjugate of 3x3 block
+	T c11 = a._22 * a._33 - a._23 * a._32;
+	T c12 = a._13 * a._32 - a._12 * a._33;
+	T c13 = a._12 * a._23 - a._13 * a._22;
+	T c21 = a._23 * a._31 - a._21 * a._33;
+	T c22 = a._11 * a._33 - a._13 * a._31;
+	T c23 = a._13 * a._21 - a._11 * a._23;
+	T c31 = a._21 * a._32 - a._22 * a._31;
+	T c32 = a._12 * a._31 - a._11 * a._32;
+	T c33 = a._11 * a._22 - a._12 * a._21;
+	T d = 1 / ( a._11 * c11 + a._12 * c21 + a._13 * c31 );
+	c11 *= d; c12 *= d; c13 *= d;
+	c21 *= d; c22 *= d; c23 *= d;
+	c31 *= d; c32 *= d; c33 *= d;
+	T x = a._41, y = a._42, z = a._43;
+	r.m = Matrix4< T >(
+			   c11, c12, c13, 0,
+			   c21, c22, c23, 0,
+			   c31, c32, c33, 0,
+			   -( x * c11 + y * c21 + z * c31 ),
+			   -( x * c12 + y * c22 + z * c32 ),
+			   -( x * c13 + y * c23 + z * c33 ), 1 );
+      }
+      break;
+    case PROJECTIVE:
+      {
+	Matrix4< T > t;
+	Matrix4< T >::inverse( t, a );
+	r.m = t;
+      }
+      break;
+    }
+  r.kind = m0.kind;
+  return r;
+}
+
+//
+template< typename T >
+inline Vector3< T > &TaggedMatrix4< T >::transform( Vector3< T > &v, const Vector3< T > &v0, const TaggedMatrix4< T > &m )
+{
+  const Matrix4< T > &a = m.m;
+  T x = v0.x, y = v0.y, z = v0.z;
+  switch( m.kind )
+    {
+    case IDENTITY:
+      v = v0;
+      break;
+    case TRANSLATION:
+      v = Vector3< T >( x + a._41, y + a._42, z + a._43 );
+      break;
+    case SCALE:
+      v = Vector3< T >( x * a._11, y * a._22, z * a._33 );
+      break;
+    case RIGID:
+    case AFFINE:
+      v = Vector3< T >( x * a._11 + y * a._21 + z * a._31 + a._41,
+			x * a._12 + y * a._22 + z * a._32 + a._42,
+			x * a._13 + y * a._23 + z * a._33 + a._43 );
+      break;
+    case PROJECTIVE:
+      Vector3< T >::transform( v, v0, a );
+      break;
+    }
+  return v;
+}
+
+//
+template< typename T >
+void TaggedMatrix4< T >::transform( Vector3< T > *v, const Vector3< T > *v0, unsigned int n, const TaggedMatrix4< T > &m )
+{
+  const Matrix4< T > &a = m.m;
+  switch( m.kind )
+    {
+    case IDENTITY:
+      for( unsigned int i = 0; i < n; ++i )
+	{
+	  v[ i ] = v0[ i ];
+	}
+      break;
+    case TRANSLATION:
+#ifdef _OPENMP
+#pragma omp parallel for if( n > 65536 )
+#endif
+      for( int i = 0; i < static_cast< int >( n ); ++i )
+	{
+	  v[ i ] = Vector3< T >( v0[ i ].x + a._41, v0[ i ].y + a._42, v0[ i ].z + a._43 );
+	}
+      break;
+    case SCALE:
+#ifdef _OPENMP
+#pragma omp parallel for if( n > 65536 )
+#endif
+      for( int i = 0; i < static_cast< int >( n ); ++i )
+	{
+	  v[ i ] = Vector3< T >( v0[ i ].x * a._11, v0[ i ].y * a._22, v0[ i ].z * a._33 );
+	}
+      break;
+    case RIGID:
+    case AFFINE:
+#ifdef _OPENMP
+#pragma omp parallel for if( n > 65536 )
+#endif
+      for( int i = 0; i < static_cast< int >( n ); ++i )
+	{
+	  T x = v0[ i ].x, y = v0[ i ].y, z = v0[ i ].z;
+	  v[ i ] = Vector3< T >( x * a._11 + y * a._21 + z * a._31 + a._41,
+				 x * a._12 + y * a._22 + z * a._32 + a._42,
+				 x * a._13 + y * a._23 + z * a._33 + a._43 );
+	}
+      break;
+    case PROJECTIVE:
+#ifdef _OPENMP
+#pragma omp parallel for if( n > 65536 )
+#endif
+      for( int i = 0; i < static_cast< int >( n ); ++i )
+	{
+	  Vector3< T >::transform( v[ i ], v0[ i ], a );
+	}
+      break;
+    }
+}
+
+typedef TaggedMatrix4< float > TaggedMatrix4F;
+typedef TaggedMatrix4< double > TaggedMatrix4D;
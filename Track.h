@@ -0,0 +1,526 @@
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include "Vector3.h"
+#include "Quaternion.h"
+
+//! interpolation of keyframe values
+template< typename V >
+struct TrackInterpolator;
+
+//! Catmull-Rom weights of keys i - 1, i, i + 1, i + 2 at s
+template< typename T >
+inline void trackCatmullRom( T w[ 4 ], T s )
+{
+  T s2 = s * s;
+  T s3 = s2 * s;
+  w[ 0 ] = ( -s + s2 * 2 - s3 ) * static_cast< T >( 0.5 );
+  w[ 1 ] = ( 2 - s2 * 5 + s3 * 3 ) * static_cast< T >( 0.5 );
+  w[ 2 ] = ( s + s2 * 4 - s3 * 3 ) * static_cast< T >( 0.5 );
+  w[ 3 ] = ( s3 - s2 ) * static_cast< T >( 0.5 );
+}
+
+//! Vector3 keys : linear and Catmull-Rom
+template< typename T >
+struct TrackInterpolator< Vector3< T > >
+{
+  static Vector3< T > &linear( Vector3< T > &v, const Vector3< T > &v1, const Vector3< T > &v2, T s );
+  static Vector3< T > &cubic( Vector3< T > &v, const Vector3< T > &v0, const Vector3< T > &v1, const Vector3< T > &v2, const Vector3< T > &v3, T s );
+  /*!
+    @brief weights w of the keys c[ * ][ k[ 0 .. 3 ] ] so that the value is their weighted sum
+    @param c key values, one array per component
+  */
+  static void linear( T w[ 4 ], const T *const *c, const unsigned int k[ 4 ], T s );
+  static void cubic( T w[ 4 ], const T *const *c, const unsigned int k[ 4 ], T s );
+  /*!
+    @brief finish a cubic weighted sum in v[ * ][ i ]
+  */
+  static void finish( T *const *v, unsigned int i );
+
+  // number of scalar components
+  static const unsigned int COMPONENTS = 3;
+};
+
+//
+template< typename T >
+inline Vector3< T > &TrackInterpolator< Vector3< T > >::linear( Vector3< T > &v, const Vector3< T > &v1, const Vector3< T > &v2, T s )
+{
+  v = v1 + ( v2 - v1 ) * s;
+  return v;
+}
+
+//
+template< typename T >
+inline Vector3< T > &TrackInterpolator< Vector3< T > >::cubic( Vector3< T > &v, const Vector3< T > &v0, const Vector3< T > &v1, const Vector3< T > &v2, const Vector3< T > &v3, T s )
+{
+  T s2 = s * s;
+  T s3 = s2 * s;
+  v = ( v1 * 2 + ( v2 - v0 ) * s + ( v0 * 2 - v1 * 5 + v2 * 4 - v3 ) * s2 + ( v1 * 3 - v0 - v2 * 3 + v3 ) * s3 ) * static_cast< T >( 0.5 );
+  return v;
+}
+
+//
+template< typename T >
+inline void TrackInterpolator< Vector3< T > >::linear( T w[ 4 ], const T *const *, const unsigned int *, T s )
+{
+  w[ 0 ] = w[ 3 ] = 0;
+  w[ 1 ] = 1 - s;
+  w[ 2 ] = s;
+}
+
+//
+template< typename T >
+inline void TrackInterpolator< Vector3< T > >::cubic( T w[ 4 ], const T *const *, const unsigned int *, T s )
+{
+  trackCatmullRom( w, s );
+}
+
+//
+template< typename T >
+inline void TrackInterpolator< Vector3< T > >::finish( T *const *, unsigned int )
+{
+}
+
+//! Quaternion keys : slerp and normalized Catmull-Rom along the shortest arc
+template< typename T >
+struct TrackInterpolator< Quaternion< T > >
+{
+  static Quaternion< T > &linear( Quaternion< T > &q, const Quaternion< T > &q1, const Quaternion< T > &q2, T s );
+  static Quaternion< T > &cubic( Quaternion< T > &q, const Quaternion< T > &q0, const Quaternion< T > &q1, const Quaternion< T > &q2, const Quaternion< T > &q3, T s );
+  /*!
+    @brief weights w of the keys c[ * ][ k[ 0 .. 3 ] ] so that the value is their weighted sum ( signs included )
+    @param c key values, one array per component
+  */
+  static void linear( T w[ 4 ], const T *const *c, const unsigned int k[ 4 ], T s );
+  static void cubic( T w[ 4 ], const T *const *c, const unsigned int k[ 4 ], T s );
+  /*!
+    @brief finish a cubic weighted sum in v[ * ][ i ] ( normalize )
+  */
+  static void finish( T *const *v, unsigned int i );
+
+  // number of scalar components
+  static const unsigned int COMPONENTS = 4;
+
+private:
+  static Quaternion< T > align( const Quaternion< T > &q, const Quaternion< T > &ref );
+  static T dot( const T *const *c, unsigned int i, unsigned int j );
+};
+
+//
+template< typename T >
+inline Quaternion< T > TrackInterpolator< Quaternion< T > >::align( const Quaternion< T > &q, const Quaternion< T > &ref )
+{
+  return ( q.x * ref.x + q.y * ref.y + q.z * ref.z + q.w * ref.w < 0 ) ? -q : q;
+}
+
+//
+template< typename T >
+inline Quaternion< T > &TrackInterpolator< Quaternion< T > >::linear( Quaternion< T > &q, const Quaternion< T > &q1, const Quaternion< T > &q2, T s )
+{
+  Quaternion< T >::slerp( q, q1, align( q2, q1 ), s );
+  return q;
+}
+
+//
+template< typename T >
+Quaternion< T > &TrackInterpolator< Quaternion< T > >::cubic( Quaternion< T > &q, const Quaternion< T > &q0, const Quaternion< T > &q1, const Quaternion< T > &q2, const Quaternion< T > &q3, T s )
+{
+  Quaternion< T > a = align( q0, q1 );
+  Quaternion< T > b = align( q2, q1 );
+  Quaternion< T > c = align( q3, b );
+  T s2 = s * s;
+  T s3 = s2 * s;
+  q = ( q1 * 2 + ( b - a ) * s + ( a * 2 - q1 * 5 + b * 4 - c ) * s2 + ( q1 * 3 - a - b * 3 + c ) * s3 ) * static_cast< T >( 0.5 );
+  Quaternion< T >::normalize( q, q );
+  return q;
+}
+
+//
+template< typename T >
+inline T TrackInterpolator< Quaternion< T > >::dot( const T *const *c, unsigned int i, unsigned int j )
+{
+  return c[ 0 ][ i ] * c[ 0 ][ j ] + c[ 1 ][ i ] * c[ 1 ][ j ] + c[ 2 ][ i ] * c[ 2 ][ j ] + c[ 3 ][ i ] * c[ 3 ][ j ];
+}
+
+//
+template< typename T >
+void TrackInterpolator< Quaternion< T > >::linear( T w[ 4 ], const T *const *c, const unsigned int k[ 4 ], T s )
+{
+  // slerp towards the aligned second key, as Quaternion::slerp
+  T sign = dot( c, k[ 2 ], k[ 1 ] ) < 0 ? -1 : 1;
+  double a = static_cast< double >( dot( c, k[ 1 ], k[ 2 ] ) * sign );
+  double b = 1.0 - a * a;
+  w[ 0 ] = w[ 3 ] = 0;
+  if( b <= 0.0 )
+    {
+      w[ 1 ] = 1;
+      w[ 2 ] = 0;
+      return;
+    }
+
+  double a2 = acos( a );
+  double b2 = sqrt( b );
+  double d = a2 * s;
+  w[ 1 ] = static_cast< T >( sin( a2 - d ) / b2 );
+  w[ 2 ] = static_cast< T >( sin( d ) / b2 ) * sign;
+}
+
+//
+template< typename T >
+void TrackInterpolator< Quaternion< T > >::cubic( T w[ 4 ], const T *const *c, const unsigned int k[ 4 ], T s )
+{
+  // the same alignment as the Quaternion version : keys 0 and 2 to key 1, key 3 to aligned key 2
+  T s0 = dot( c, k[ 0 ], k[ 1 ] ) < 0 ? -1 : 1;
+  T s2 = dot( c, k[ 2 ], k[ 1 ] ) < 0 ? -1 : 1;
+  T s3 = dot( c, k[ 3 ], k[ 2 ] ) * s2 < 0 ? -1 : 1;
+  trackCatmullRom( w, s );
+  w[ 0 ] *= s0;
+  w[ 2 ] *= s2;
+  w[ 3 ] *= s3;
+}
+
+//
+template< typename T >
+inline void TrackInterpolator< Quaternion< T > >::finish( T *const *v, unsigned int i )
+{
+  Quaternion< T > q;
+  q.x = v[ 0 ][ i ];
+  q.y = v[ 1 ][ i ];
+  q.z = v[ 2 ][ i ];
+  q.w = v[ 3 ][ i ];
+  Quaternion< T >::normalize( q, q );
+  v[ 0 ][ i ] = q.x;
+  v[ 1 ][ i ] = q.y;
+  v[ 2 ][ i ] = q.z;
+  v[ 3 ][ i ] = q.w;
+}
+
+//! keyframe track of Vector3 or Quaternion values
+/*!
+  times must be increasing. Sampling is clamped to the first and last key.
+  A segment cache ( index of the key before the sampled time ) makes
+  monotone playback O(1) instead of a binary search per sample.
+*/
+template< typename V, typename T = float >
+struct Track
+{
+  enum Interpolation
+    {
+      STEP,
+      LINEAR,
+      CUBIC
+    };
+
+  Track();
+
+  // static function
+  /*!
+    @brief find segment containing time
+    @param hint segment to test first ( cached result of a previous call )
+  */
+  static unsigned int find( const Track &track, T time, unsigned int hint = 0 );
+  /*!
+    @brief find segment containing time in n increasing key times
+
+    A NaN time gives segment 0, any hint is safe.
+  */
+  static unsigned int find( const T *times, unsigned int n, T time, unsigned int hint = 0 );
+  /*!
+    @brief sample track
+    @param cache if not null, segment hint that is updated by the call
+  */
+  static V &sample( V &v, const Track &track, T time, unsigned int *cache = 0 );
+  /*!
+    @brief sample tracks at the same time ( see TrackSet for the soa layout )
+    @param cache segment hint per track
+  */
+  static void sample( V *v, unsigned int *cache, const Track *tracks, unsigned int n, T time );
+
+  std::vector< T > times;
+  std::vector< V > values;
+  Interpolation interpolation;
+};
+
+//
+template< typename V, typename T >
+inline Track< V, T >::Track() : interpolation( LINEAR )
+{
+}
+
+//
+template< typename V, typename T >
+inline unsigned int Track< V, T >::find( const Track &track, T time, unsigned int hint )
+{
+  return find( track.times.empty() ? 0 : &track.times[ 0 ], static_cast< unsigned int >( track.times.size() ), time, hint );
+}
+
+//
+template< typename V, typename T >
+inline unsigned int Track< V, T >::find( const T *k, unsigned int n, T time, unsigned int hint )
+{
+  // the tests are written so that a NaN time or end key fails them, and the
+  // search below always finds a key after time ; upper_bound would return n
+  if( n < 2 || !( time > k[ 0 ] ) )
+    {
+      return 0;
+    }
+  if( !( time < k[ n - 1 ] ) )
+    {
+      return n - 2;
+    }
+
+  // cached segment, then the next one ( hint may be stale, so no hint + 1 overflow )
+  if( hint < n - 1 && k[ hint ] <= time )
+    {
+      if( time < k[ hint + 1 ] )
+	{
+	  return hint;
+	}
+      if( hint < n - 2 && time < k[ hint + 2 ] )
+	{
+	  return hint + 1;
+	}
+    }
+
+  return static_cast< unsigned int >( std::upper_bound( k, k + n, time ) - k ) - 1;
+}
+
+//
+template< typename V, typename T >
+V &Track< V, T >::sample( V &v, const Track &track, T time, unsigned int *cache )
+{
+  unsigned int n = static_cast< unsigned int >( track.times.size() );
+  if( n == 0 )
+    {
+      v = V();
+      return v;
+    }
+  if( n == 1 )
+    {
+      v = track.values[ 0 ];
+      return v;
+    }
+
+  unsigned int i = find( track, time, cache ? *cache : 0 );
+  if( cache )
+    {
+      *cache = i;
+    }
+
+  T t0 = track.times[ i ];
+  T t1 = track.times[ i + 1 ];
+  T s = ( time - t0 ) / ( t1 - t0 );
+  s = s < 0 ? 0 : ( s > 1 ? 1 : s );
+
+  switch( track.interpolation )
+    {
+    case STEP:
+      v = track.values[ s < 1 ? i : i + 1 ];
+      break;
+    case LINEAR:
+      TrackInterpolator< V >::linear( v, track.values[ i ], track.values[ i + 1 ], s );
+      break;
+    case CUBIC:
+      TrackInterpolator< V >::cubic( v, track.values[ i > 0 ? i - 1 : 0 ], track.values[ i ], track.values[ i + 1 ], track.values[ i + 2 < n ? i + 2 : n - 1 ], s );
+      break;
+    }
+  return v;
+}
+
+//
+template< typename V, typename T >
+void Track< V, T >::sample( V *v, unsigned int *cache, const Track *tracks, unsigned int n, T time )
+{
+#ifdef _OPENMP
+#pragma omp parallel for if( n > 1024 )
+#endif
+  for( int i = 0; i < static_cast< int >( n ); ++i )
+    {
+      sample( v[ i ], tracks[ i ], time, &cache[ i ] );
+    }
+}
+
+//! many keyframe tracks in soa layout for batch sampling
+/*!
+  Keys of all tracks are stored back to back : times in one array and each
+  value component in an array of its own, with the first key and key count
+  per track. A batch sample first finds the segment of every track ( with
+  the cached segment per track ) and turns the interpolation into weights of
+  four keys, then sums the weighted keys one component at a time across
+  tracks, so the inner loops run over flat arrays and vectorize.
+*/
+template< typename V, typename T = float >
+struct TrackSet
+{
+  typedef typename Track< V, T >::Interpolation Interpolation;
+
+  /*!
+    @brief append copy of track
+    @return index of the track
+  */
+  unsigned int add( const Track< V, T > &track );
+  /*!
+    @brief number of tracks
+  */
+  unsigned int size() const;
+  /*!
+    @brief sample all tracks at the same time
+    @param v output, one array per component ( x, y, z [, w] ) of size() elements
+    @param cache segment hint per track, updated by the call
+  */
+  void sample( T *const *v, unsigned int *cache, T time ) const;
+
+  std::vector< T > times;
+  std::vector< T > values[ TrackInterpolator< V >::COMPONENTS ];
+  std::vector< unsigned int > first, count;
+  std::vector< Interpolation > interpolation;
+
+  // number of tracks whose weights are computed before the weighted sums
+  static const unsigned int TRACK_BLOCK = 256;
+};
+
+//
+template< typename V, typename T >
+unsigned int TrackSet< V, T >::add( const Track< V, T > &track )
+{
+  unsigned int n = static_cast< unsigned int >( std::min( track.times.size(), track.values.size() ) );
+  first.push_back( static_cast< unsigned int >( times.size() ) );
+  count.push_back( n );
+  interpolation.push_back( track.interpolation );
+  times.insert( times.end(), track.times.begin(), track.times.begin() + n );
+  for( unsigned int c = 0; c < TrackInterpolator< V >::COMPONENTS; ++c )
+    {
+      for( unsigned int i = 0; i < n; ++i )
+	{
+	  values[ c ].push_back( track.values[ i ].v[ c ] );
+	}
+    }
+  return size() - 1;
+}
+
+//
+template< typename V, typename T >
+inline unsigned int TrackSet< V, T >::size() const
+{
+  return static_cast< unsigned int >( first.size() );
+}
+
+//
+template< typename V, typename T >
+void TrackSet< V, T >::sample( T *const *v, unsigned int *cache, T time ) const
+{
+  typedef TrackInterpolator< V > Interpolator;
+  const unsigned int COMPONENTS = Interpolator::COMPONENTS;
+  const unsigned int n = size();
+  const V empty;
+  if( times.empty() )
+    {
+      for( unsigned int c = 0; c < COMPONENTS; ++c )
+	{
+	  std::fill( v[ c ], v[ c ] + n, empty.v[ c ] );
+	}
+      return;
+    }
+
+  const T *c[ COMPONENTS ];
+  for( unsigned int j = 0; j < COMPONENTS; ++j )
+    {
+      c[ j ] = &values[ j ][ 0 ];
+    }
+
+  int blocks = static_cast< int >( ( n + TRACK_BLOCK - 1 ) / TRACK_BLOCK );
+#ifdef _OPENMP
+#pragma omp parallel for if( n > 1024 )
+#endif
+  for( int b = 0; b < blocks; ++b )
+    {
+      unsigned int begin = b * TRACK_BLOCK;
+      unsigned int m = ( begin + TRACK_BLOCK < n ? begin + TRACK_BLOCK : n ) - begin;
+      // keys i - 1, i, i + 1, i + 2 of each track and their weights
+      unsigned int k[ 4 ][ TRACK_BLOCK ];
+      T w[ 4 ][ TRACK_BLOCK ];
+
+      for( unsigned int i = 0; i < m; ++i )
+	{
+	  unsigned int t = begin + i;
+	  unsigned int f = first[ t ], l = count[ t ];
+	  unsigned int key[ 4 ];
+	  T weight[ 4 ];
+	  if( l < 2 )
+	    {
+	      // a single key, or none ( filled in after the sums )
+	      key[ 0 ] = key[ 1 ] = key[ 2 ] = key[ 3 ] = l ? f : 0;
+	      weight[ 0 ] = l ? 1 : 0;
+	      weight[ 1 ] = weight[ 2 ] = weight[ 3 ] = 0;
+	    }
+	  else
+	    {
+	      unsigned int s = Track< V, T >::find( &times[ f ], l, time, cache[ t ] );
+	      cache[ t ] = s;
+	      T t0 = times[ f + s ];
+	      T t1 = times[ f + s + 1 ];
+	      T u = ( time - t0 ) / ( t1 - t0 );
+	      u = u < 0 ? 0 : ( u > 1 ? 1 : u );
+	      key[ 0 ] = f + ( s > 0 ? s - 1 : 0 );
+	      key[ 1 ] = f + s;
+	      key[ 2 ] = f + s + 1;
+	      key[ 3 ] = f + ( s + 2 < l ? s + 2 : l - 1 );
+	      switch( interpolation[ t ] )
+		{
+		case Track< V, T >::STEP:
+		  weight[ 0 ] = weight[ 3 ] = 0;
+		  weight[ 1 ] = u < 1 ? 1 : 0;
+		  weight[ 2 ] = u < 1 ? 0 : 1;
+		  break;
+		case Track< V, T >::LINEAR:
+		  Interpolator::linear( weight, c, key, u );
+		  break;
+		case Track< V, T >::CUBIC:
+		  Interpolator::cubic( weight, c, key, u );
+		  break;
+		}
+	    }
+	  for( unsigned int j = 0; j < 4; ++j )
+	    {
+	      k[ j ][ i ] = key[ j ];
+	      w[ j ][ i ] = weight[ j ];
+	    }
+	}
+
+      for( unsigned int j = 0; j < COMPONENTS; ++j )
+	{
+	  const T *a = c[ j ];
+	  T *o = v[ j ] + begin;
+	  for( unsigned int i = 0; i < m; ++i )
+	    {
+	      o[ i ] = w[ 0 ][ i ] * a[ k[ 0 ][ i ] ] + w[ 1 ][ i ] * a[ k[ 1 ][ i ] ] + w[ 2 ][ i ] * a[ k[ 2 ][ i ] ] + w[ 3 ][ i ] * a[ k[ 3 ][ i ] ];
+	    }
+	}
+
+      for( unsigned int i = 0; i < m; ++i )
+	{
+	  unsigned int t = begin + i;
+	  if( count[ t ] == 0 )
+	    {
+	      for( unsigned int j = 0; j < COMPONENTS; ++j )
+		{
+		  v[ j ][ t ] = empty.v[ j ];
+		}
+	    }
+	  else if( count[ t ] > 1 && interpolation[ t ] == Track< V, T >::CUBIC )
+	    {
+	      Interpolator::finish( v, t );
+	    }
+	}
+    }
+}
+
+typedef Track< Vector3< float >, float > Vector3TrackF;
+typedef Track< Vector3< double >, double > Vector3TrackD;
+typedef Track< Quaternion< float >, float > QuaternionTrackF;
+typedef Track< Quaternion< double >, double > QuaternionTrackD;
+typedef TrackSet< Vector3< float >, float > Vector3TrackSetF;
+typedef TrackSet< Vector3< double >, double > Vector3TrackSetD;
+typedef TrackSet< Quaternion< float >, float > QuaternionTrackSetF;
+typedef TrackSet< Quaternion< double >, double > QuaternionTrackSetD;
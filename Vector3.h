@@ -1,6 +1,7 @@
 #pragma once
 
 #include <cmath>
+#include "Instrument.h"
 
 template< typename T > struct Matrix4;
 
@@ -213,6 +214,7 @@ inline Vector3< T > operator * ( T2 s, const Vector3< T > &v )
 template< typename T >
 inline Vector3< T > &Vector3< T >::normalize( Vector3< T > &v, const Vector3 &v0 )
 {
+  MATH_INSTRUMENT_SCOPE( Instrument::VECTOR3_NORMALIZE, 1 );
   T l = length(v0);
   if(l == 0)
     {
@@ -250,6 +252,7 @@ inline T Vector3< T >::distance( const Vector3 &v1, const Vector3 &v2 )
 template< typename T >
 bool Vector3< T >::intersectTri( const Vector3< T > &v0, const Vector3< T > &v1, const Vector3< T > &v2, const Vector3< T > &org, const Vector3< T > &dir, T *u, T *v, T *dist )
 {
+  MATH_INSTRUMENT_SCOPE( Instrument::VECTOR3_INTERSECT_TRI, 1 );
   // 面の法線を求める
   Vector3< T > t1 = v1 - v0;
   Vector3< T > t2 = v2 - v0;
@@ -0,0 +1,83 @@
+#pragma once
+
+#include "Vector3.h"
+
+//! 3D vectors in structure-of-arrays layout
+/*!
+  Does not own the arrays. Batch kernels take this layout so that
+  each component is contiguous and loops vectorize across elements.
+*/
+template< typename T = double >
+struct Vector3SoA
+{
+  Vector3SoA< T >();
+  Vector3SoA< T >( T *x, T *y, T *z );
+
+  /*!
+    @brief get i-th element
+  */
+  Vector3< T > operator []( unsigned int i ) const;
+
+  // static function
+  /*!
+    @brief copy array of vectors into soa
+  */
+  static Vector3SoA< T > &load( Vector3SoA< T > &o, const Vector3< T > *v, unsigned int n );
+  /*!
+    @brief copy soa into array of vectors
+  */
+  static void store( Vector3< T > *v, const Vector3SoA< T > &a, unsigned int n );
+
+  T *x, *y, *z;
+};
+
+//
+template< typename T >
+inline Vector3SoA< T >::Vector3SoA()
+{
+  x = y = z = 0;
+}
+
+//
+template< typename T >
+inline Vector3SoA< T >::Vector3SoA( T *x, T *y, T *z )
+{
+  this->x = x;
+  this->y = y;
+  this->z = z;
+}
+
+//
+template< typename T >
+inline Vector3< T > Vector3SoA< T >::operator []( unsigned int i ) const
+{
+  return Vector3< T >( x[ i ], y[ i ], z[ i ] );
+}
+
+//
+template< typename T >
+Vector3SoA< T > &Vector3SoA< T >::load( Vector3SoA< T > &o, const Vector3< T > *v, unsigned int n )
+{
+  for( unsigned int i = 0; i < n; ++i )
+    {
+      o.x[ i ] = v[ i ].x;
+      o.y[ i ] = v[ i ].y;
+      o.z[ i ] = v[ i ].z;
+    }
+  return o;
+}
+
+//
+template< typename T >
+void Vector3SoA< T >::store( Vector3< T > *v, const Vector3SoA< T > &a, unsigned int n )
+{
+  for( unsigned int i = 0; i < n; ++i )
+    {
+      v[ i ].x = a.x[ i ];
+      v[ i ].y = a.y[ i ];
+      v[ i ].z = a.z[ i ];
+    }
+}
+
+typedef Vector3SoA< float > Vector3SoAF;
+typedef Vector3SoA< double > Vector3SoAD;